@@ -0,0 +1,58 @@
+; Interrupt Service Routine Stubs
+; One stub per vector, all funnel into interrupt_dispatch (kernel/idt.c)
+
+BITS 32
+
+section .text
+
+extern interrupt_dispatch
+global isr_stub_table
+
+KERNEL_DS equ 0x10
+
+; Generate 256 stubs. Vectors where the CPU pushes an error code
+; only push the vector number, the rest push a dummy 0 first so the
+; stack layout always matches struct interrupt_frame.
+%assign i 0
+%rep 256
+isr_stub_ %+ i:
+%if i == 8 || (i >= 10 && i <= 14) || i == 17 || i == 21 || i == 29 || i == 30
+    push dword i
+%else
+    push dword 0
+    push dword i
+%endif
+    jmp isr_common
+%assign i i+1
+%endrep
+
+isr_common:
+    pusha
+    mov ax, ds
+    push eax
+
+    mov ax, KERNEL_DS
+    mov ds, ax
+    mov es, ax
+
+    cld
+    push esp                ; struct interrupt_frame*
+    call interrupt_dispatch
+    add esp, 4
+
+    pop eax
+    mov ds, ax
+    mov es, ax
+    popa
+    add esp, 8              ; Drop vector and error code
+    iret
+
+section .data
+
+; Stub addresses, indexed by vector (used by idt_init)
+isr_stub_table:
+%assign i 0
+%rep 256
+    dd isr_stub_ %+ i
+%assign i i+1
+%endrep
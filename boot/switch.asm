@@ -0,0 +1,29 @@
+; Kernel Thread Context Switch
+; void context_switch(uint32_t* old_esp, uint32_t new_esp)  (kernel/thread.c)
+
+BITS 32
+
+section .text
+
+global context_switch
+
+; Only callee-saved registers need saving: the caller (schedule) already
+; assumes eax/ecx/edx are clobbered. EFLAGS travels with each thread's
+; own irq_save/irq_restore or iret.
+context_switch:
+    mov eax, [esp + 4]          ; old_esp
+    mov edx, [esp + 8]          ; new_esp
+
+    push ebp
+    push ebx
+    push esi
+    push edi
+
+    mov [eax], esp
+    mov esp, edx
+
+    pop edi
+    pop esi
+    pop ebx
+    pop ebp
+    ret
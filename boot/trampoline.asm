@@ -0,0 +1,70 @@
+; Application Processor Startup Trampoline
+; Copied to SMP_TRAMPOLINE_ADDR by smp_init (kernel/smp.c); each AP starts
+; here in real mode after INIT-SIPI-SIPI and jumps into smp_ap_entry.
+
+SMP_TRAMPOLINE_ADDR equ 0x8000      ; Must match include/smp.h (SIPI vector 0x08)
+
+CODE_SEG equ 0x08
+DATA_SEG equ 0x10
+
+; Address of a trampoline label once copied to low memory
+%define TRAMP(label) (SMP_TRAMPOLINE_ADDR + (label) - smp_trampoline_start)
+
+section .text
+
+global smp_trampoline_start
+global smp_trampoline_end
+global smp_trampoline_stack
+global smp_trampoline_entry
+global smp_trampoline_cpu
+
+BITS 16
+smp_trampoline_start:
+    cli
+    cld
+    xor ax, ax
+    mov ds, ax
+
+    ; Flat code/data, same layout as boot.asm
+    lgdt [TRAMP(tramp_gdt_descriptor)]
+
+    mov eax, cr0
+    or eax, 1
+    mov cr0, eax
+
+    jmp dword CODE_SEG:TRAMP(tramp_pmode)
+
+BITS 32
+tramp_pmode:
+    mov ax, DATA_SEG
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+
+    ; Parameters written by smp_init before each SIPI
+    mov esp, [TRAMP(smp_trampoline_stack)]
+    push dword [TRAMP(smp_trampoline_cpu)]
+    mov eax, [TRAMP(smp_trampoline_entry)]
+    call eax
+
+.hang:
+    cli
+    hlt
+    jmp .hang
+
+align 8
+tramp_gdt:
+    dq 0x0000000000000000       ; Null
+    dq 0x00CF9A000000FFFF       ; Code: base 0, 4GB, ring 0
+    dq 0x00CF92000000FFFF       ; Data: base 0, 4GB, ring 0
+
+tramp_gdt_descriptor:
+    dw tramp_gdt_descriptor - tramp_gdt - 1
+    dd TRAMP(tramp_gdt)
+
+smp_trampoline_stack:   dd 0    ; Top of the AP's stack
+smp_trampoline_entry:   dd 0    ; void smp_ap_entry(struct cpu*)
+smp_trampoline_cpu:     dd 0    ; struct cpu* for this AP
+smp_trampoline_end:
@@ -0,0 +1,188 @@
+/**************************************************************
+ * ACPI Table Driver - BloodG OS
+ * Finds the RSDP, walks the RSDT and parses the MADT
+ **************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "string.h"
+#include "acpi.h"
+#include "page.h"
+
+// RSDP search areas
+#define BDA_EBDA_SEGMENT    0x40E
+#define EBDA_SEARCH_SIZE    1024
+#define BIOS_ROM_START      0xE0000
+#define BIOS_ROM_END        0x100000
+
+// ACPI state
+static const acpi_sdt_header_t* rsdt = NULL;
+static struct acpi_info info;
+
+void print_string(const char* str);
+char* utoa(uint32_t value, char* str, int base);
+
+// Sum bytes (valid structures sum to 0)
+static uint8_t acpi_checksum(const void* ptr, uint32_t length) {
+    const uint8_t* p = (const uint8_t*)ptr;
+    uint8_t sum = 0;
+
+    for (uint32_t i = 0; i < length; i++) {
+        sum += p[i];
+    }
+
+    return sum;
+}
+
+// Scan memory range for RSDP (16-byte aligned)
+static const acpi_rsdp_t* acpi_scan_rsdp(uint32_t start, uint32_t end) {
+    for (uint32_t addr = start; addr + sizeof(acpi_rsdp_t) <= end; addr += 16) {
+        const acpi_rsdp_t* rsdp = (const acpi_rsdp_t*)addr;
+
+        if (memcmp(rsdp->signature, "RSD PTR ", 8) == 0 &&
+            acpi_checksum(rsdp, sizeof(acpi_rsdp_t)) == 0) {
+            return rsdp;
+        }
+    }
+
+    return NULL;
+}
+
+// Find RSDP in EBDA, then in BIOS ROM area
+static const acpi_rsdp_t* acpi_find_rsdp(void) {
+    uint32_t ebda = (uint32_t)(*(volatile uint16_t*)BDA_EBDA_SEGMENT) << 4;
+    const acpi_rsdp_t* rsdp = NULL;
+
+    if (ebda) {
+        rsdp = acpi_scan_rsdp(ebda, ebda + EBDA_SEARCH_SIZE);
+    }
+    if (!rsdp) {
+        rsdp = acpi_scan_rsdp(BIOS_ROM_START, BIOS_ROM_END);
+    }
+
+    return rsdp;
+}
+
+// Parse MADT entries
+static void acpi_parse_madt(const acpi_madt_t* madt) {
+    const uint8_t* p = (const uint8_t*)madt + sizeof(acpi_madt_t);
+    const uint8_t* end = (const uint8_t*)madt + madt->header.length;
+
+    info.madt_found = true;
+    info.lapic_address = madt->lapic_address;
+    info.pcat_compat = (madt->flags & ACPI_MADT_PCAT_COMPAT) != 0;
+
+    while (p + sizeof(acpi_madt_entry_t) <= end) {
+        const acpi_madt_entry_t* entry = (const acpi_madt_entry_t*)p;
+        if (entry->length < sizeof(acpi_madt_entry_t)) {
+            break;  // Malformed table
+        }
+
+        switch (entry->type) {
+        case ACPI_MADT_LAPIC:
+            // processor id, apic id, flags
+            if ((*(const uint32_t*)(p + 4) & ACPI_LAPIC_ENABLED) &&
+                info.cpu_count < ACPI_MAX_CPUS) {
+                info.cpu_apic_ids[info.cpu_count++] = p[3];
+            }
+            break;
+
+        case ACPI_MADT_IOAPIC:
+            // id, reserved, address, gsi base
+            if (info.ioapic_count < ACPI_MAX_IOAPICS) {
+                struct acpi_ioapic* ioapic = &info.ioapics[info.ioapic_count++];
+                ioapic->id = p[2];
+                ioapic->address = *(const uint32_t*)(p + 4);
+                ioapic->gsi_base = *(const uint32_t*)(p + 8);
+            }
+            break;
+
+        case ACPI_MADT_ISO: {
+            // bus, source irq, gsi, flags
+            uint8_t irq = p[3];
+            if (irq < ACPI_ISA_IRQS) {
+                info.isa_gsi[irq] = *(const uint32_t*)(p + 4);
+                info.isa_flags[irq] = *(const uint16_t*)(p + 8);
+            }
+            break;
+        }
+
+        default:
+            break;
+        }
+
+        p += entry->length;
+    }
+}
+
+// Initialize ACPI tables
+bool acpi_init(void) {
+    // ISA IRQs are identity mapped unless overridden
+    for (int i = 0; i < ACPI_ISA_IRQS; i++) {
+        info.isa_gsi[i] = i;
+        info.isa_flags[i] = 0;
+    }
+
+    const acpi_rsdp_t* rsdp = acpi_find_rsdp();
+    if (!rsdp) {
+        print_string("ACPI: RSDP not found\n");
+        return false;
+    }
+
+    rsdt = (const acpi_sdt_header_t*)rsdp->rsdt_address;
+    if (memcmp(rsdt->signature, "RSDT", 4) != 0 ||
+        acpi_checksum(rsdt, rsdt->length) != 0) {
+        print_string("ACPI: Invalid RSDT\n");
+        rsdt = NULL;
+        return false;
+    }
+
+    // Tables usually sit at the top of RAM: keep the page allocator off them
+    page_reserve((uint32_t)rsdt, rsdt->length);
+    const uint32_t* pointers = (const uint32_t*)((const uint8_t*)rsdt + sizeof(acpi_sdt_header_t));
+    for (uint32_t i = 0; i < (rsdt->length - sizeof(acpi_sdt_header_t)) / 4; i++) {
+        const acpi_sdt_header_t* table = (const acpi_sdt_header_t*)pointers[i];
+        page_reserve(pointers[i], table->length);
+    }
+
+    const acpi_madt_t* madt = (const acpi_madt_t*)acpi_find_table("APIC");
+    if (madt) {
+        acpi_parse_madt(madt);
+    }
+
+    char num[16];
+    print_string("ACPI: ");
+    print_string(utoa(info.cpu_count, num, 10));
+    print_string(" CPU(s), ");
+    print_string(utoa(info.ioapic_count, num, 10));
+    print_string(" I/O APIC(s)\n");
+
+    return true;
+}
+
+// Find table by signature
+const acpi_sdt_header_t* acpi_find_table(const char* signature) {
+    if (!rsdt) {
+        return NULL;
+    }
+
+    uint32_t entries = (rsdt->length - sizeof(acpi_sdt_header_t)) / 4;
+    const uint32_t* pointers = (const uint32_t*)((const uint8_t*)rsdt + sizeof(acpi_sdt_header_t));
+
+    for (uint32_t i = 0; i < entries; i++) {
+        const acpi_sdt_header_t* table = (const acpi_sdt_header_t*)pointers[i];
+
+        if (memcmp(table->signature, signature, 4) == 0 &&
+            acpi_checksum(table, table->length) == 0) {
+            return table;
+        }
+    }
+
+    return NULL;
+}
+
+// Get parsed MADT information
+const struct acpi_info* acpi_get_info(void) {
+    return &info;
+}
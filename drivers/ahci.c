@@ -0,0 +1,502 @@
+/**************************************************************
+ * AHCI (SATA) Driver - BloodG OS
+ * Port discovery, command list/FIS setup, PRDT scatter-gather
+ * and native command queuing behind the block layer
+ **************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "io.h"
+#include "string.h"
+#include "clock.h"
+#include "page.h"
+#include "pci.h"
+#include "idt.h"
+#include "sync.h"
+#include "spinlock.h"
+#include "workqueue.h"
+#include "block.h"
+#include "ahci.h"
+
+#define AHCI_MAX_DISKS      8
+#define AHCI_TIMEOUT_NS     (500ULL * 1000000ULL)   // Port start/stop, IDENTIFY
+#define AHCI_MAX_POLLS      1000000                 // Limit without a usable clock
+#define AHCI_TABLE_PAGES    ((AHCI_MAX_SLOTS * sizeof(struct ahci_cmd_table) + PAGE_SIZE - 1) / PAGE_SIZE)
+
+// One SATA disk on one port
+struct ahci_disk {
+    struct block_device block;          // sdN
+    volatile struct ahci_port_regs* regs;
+    uint32_t port;
+    struct ahci_cmd_header* cmd_list;   // 32 headers (1KB)
+    uint8_t* fis;                       // Received FIS area (256B)
+    struct ahci_cmd_table* tables;      // One per slot
+    bool ncq;                           // FPDMA QUEUED commands in use
+    uint64_t sectors;
+    char model[41];
+
+    spinlock_t lock;                    // Guards PxCI/PxSACT writes and the masks below
+    uint32_t issued;                    // Slots handed to the HBA
+    uint32_t done;                      // Finished, not yet reported
+    uint32_t failed;                    // Subset of done that failed
+    struct work work;                   // Reports done slots in process context
+};
+
+static volatile struct ahci_hba_regs* hba = NULL;
+static struct ahci_disk disks[AHCI_MAX_DISKS];
+static uint32_t disk_count = 0;
+static uint32_t hba_slots = 1;
+
+// Guards initialization
+static struct mutex ahci_lock = MUTEX_INIT;
+
+void print_string(const char* str);
+
+// Poll register until (value & mask) == want
+static bool ahci_wait(volatile uint32_t* reg, uint32_t mask, uint32_t want) {
+    uint64_t deadline = clock_ns() + AHCI_TIMEOUT_NS;
+
+    for (uint32_t polls = 0; ; polls++) {
+        if ((*reg & mask) == want) {
+            return true;
+        }
+        if (clock_highres() ? clock_ns() >= deadline : polls >= AHCI_MAX_POLLS) {
+            return false;
+        }
+        cpu_relax();
+    }
+}
+
+// Stop command processing and FIS reception
+static bool ahci_port_stop(volatile struct ahci_port_regs* regs) {
+    regs->cmd &= ~AHCI_PORT_CMD_ST;
+    if (!ahci_wait(&regs->cmd, AHCI_PORT_CMD_CR, 0)) {
+        return false;
+    }
+    regs->cmd &= ~AHCI_PORT_CMD_FRE;
+    return ahci_wait(&regs->cmd, AHCI_PORT_CMD_FR, 0);
+}
+
+// Start FIS reception and command processing
+static bool ahci_port_start(volatile struct ahci_port_regs* regs) {
+    if (!ahci_wait(&regs->cmd, AHCI_PORT_CMD_CR, 0)) {
+        return false;
+    }
+    regs->cmd |= AHCI_PORT_CMD_FRE;
+    regs->cmd |= AHCI_PORT_CMD_ST;
+    return true;
+}
+
+// Drop every outstanding command after an error (disk lock held)
+static void ahci_port_recover(struct ahci_disk* d) {
+    // Clearing ST also clears PxCI and PxSACT
+    d->regs->cmd &= ~AHCI_PORT_CMD_ST;
+    ahci_wait(&d->regs->cmd, AHCI_PORT_CMD_CR, 0);
+    d->regs->serr = 0xFFFFFFFF;
+    d->regs->is = 0xFFFFFFFF;
+    d->regs->cmd |= AHCI_PORT_CMD_ST;
+
+    d->done |= d->issued;
+    d->failed |= d->issued;
+    d->issued = 0;
+}
+
+// Fill command slot: FIS, PRDT and header
+static bool ahci_build(struct ahci_disk* d, uint32_t slot, uint8_t command, uint64_t lba,
+                       uint32_t count, uint8_t* buffer, uint32_t bytes, bool write) {
+    struct ahci_cmd_header* header = &d->cmd_list[slot];
+    struct ahci_cmd_table* table = &d->tables[slot];
+    struct ahci_fis_h2d* fis = (struct ahci_fis_h2d*)table->cfis;
+    bool queued = command == AHCI_ATA_READ_FPDMA_QUEUED || command == AHCI_ATA_WRITE_FPDMA_QUEUED;
+
+    // Identity mapped: buffer address is the bus address
+    uint32_t address = (uint32_t)buffer;
+    uint32_t prds = 0;
+    if (address & 1) {
+        return false;
+    }
+    while (bytes > 0) {
+        if (prds == AHCI_PRDT_ENTRIES) {
+            return false;
+        }
+
+        uint32_t chunk = bytes < AHCI_PRD_MAX_BYTES ? bytes : AHCI_PRD_MAX_BYTES;
+        table->prdt[prds].dba = address;
+        table->prdt[prds].dbau = 0;
+        table->prdt[prds].reserved = 0;
+        table->prdt[prds].dbc = chunk - 1;
+
+        address += chunk;
+        bytes -= chunk;
+        prds++;
+    }
+
+    memset(fis, 0, sizeof(*fis));
+    fis->type = AHCI_FIS_REG_H2D;
+    fis->flags = AHCI_FIS_H2D_COMMAND;
+    fis->command = command;
+    fis->device = 0x40;                 // LBA
+    fis->lba0 = lba & 0xFF;
+    fis->lba1 = (lba >> 8) & 0xFF;
+    fis->lba2 = (lba >> 16) & 0xFF;
+    fis->lba3 = (lba >> 24) & 0xFF;
+    fis->lba4 = (lba >> 32) & 0xFF;
+    fis->lba5 = (lba >> 40) & 0xFF;
+
+    // NCQ moves the sector count to FEATURES and the tag to COUNT
+    if (queued) {
+        fis->feature_low = count & 0xFF;
+        fis->feature_high = (count >> 8) & 0xFF;
+        fis->count_low = slot << 3;
+    } else {
+        fis->count_low = count & 0xFF;
+        fis->count_high = (count >> 8) & 0xFF;
+    }
+
+    header->flags = AHCI_CMD_FIS_LEN | (write ? AHCI_CMD_WRITE : 0) |
+                    (prds << AHCI_CMD_PRDTL_SHIFT);
+    header->prdbc = 0;
+    header->ctba = (uint32_t)table;
+    header->ctbau = 0;
+    return true;
+}
+
+// Hand slot to the HBA
+static void ahci_issue(struct ahci_disk* d, uint32_t slot, bool queued) {
+    uint32_t bit = 1u << slot;
+    uint32_t flags = spin_lock_irqsave(&d->lock);
+
+    compiler_barrier();                 // Command table before CI
+    d->issued |= bit;
+    if (queued) {
+        d->regs->sact = bit;
+    }
+    d->regs->ci = bit;
+    spin_unlock_irqrestore(&d->lock, flags);
+}
+
+// Run IDENTIFY in slot 0 by polling (before interrupts are set up)
+static bool ahci_identify(struct ahci_disk* d, uint16_t* data) {
+    if (!ahci_build(d, 0, AHCI_ATA_IDENTIFY, 0, 0, (uint8_t*)data, 512, false)) {
+        return false;
+    }
+
+    d->regs->is = 0xFFFFFFFF;
+    d->regs->ci = 1;
+    if (!ahci_wait(&d->regs->ci, 1, 0)) {
+        ahci_port_stop(d->regs);
+        ahci_port_start(d->regs);
+        return false;
+    }
+    return !(d->regs->is & AHCI_PORT_IS_TFES) && !(d->regs->tfd & AHCI_TFD_ERR);
+}
+
+// Set up port memory and identify its disk
+static bool ahci_port_init(struct ahci_disk* d, uint32_t port) {
+    volatile struct ahci_port_regs* regs = &hba->ports[port];
+
+    if ((regs->ssts & AHCI_SSTS_DET_MASK) != AHCI_SSTS_DET_PRESENT ||
+        regs->sig != AHCI_SIG_ATA) {
+        return false;
+    }
+
+    d->regs = regs;
+    d->port = port;
+    if (!ahci_port_stop(regs)) {
+        return false;
+    }
+
+    // Command list (1KB) and received FIS (256B) share one page
+    if (!d->cmd_list) {
+        d->cmd_list = (struct ahci_cmd_header*)page_alloc(1);
+    }
+    if (!d->tables) {
+        d->tables = (struct ahci_cmd_table*)page_alloc(AHCI_TABLE_PAGES);
+    }
+    if (!d->cmd_list || !d->tables) {
+        return false;
+    }
+    d->fis = (uint8_t*)d->cmd_list + 1024;
+    memset(d->cmd_list, 0, PAGE_SIZE);
+    memset(d->tables, 0, AHCI_TABLE_PAGES * PAGE_SIZE);
+
+    regs->clb = (uint32_t)d->cmd_list;
+    regs->clbu = 0;
+    regs->fb = (uint32_t)d->fis;
+    regs->fbu = 0;
+    regs->serr = 0xFFFFFFFF;
+    regs->is = 0xFFFFFFFF;
+    regs->ie = 0;
+    if (!ahci_port_start(regs)) {
+        return false;
+    }
+
+    uint16_t identify_data[256];
+    if (!ahci_identify(d, identify_data)) {
+        return false;
+    }
+
+    // Model string (words 27-46, byte-swapped), trailing spaces trimmed
+    for (int i = 0; i < 20; i++) {
+        d->model[i * 2] = identify_data[27 + i] >> 8;
+        d->model[i * 2 + 1] = identify_data[27 + i] & 0xFF;
+    }
+    d->model[40] = '\0';
+    for (int i = 39; i >= 0 && d->model[i] == ' '; i--) {
+        d->model[i] = '\0';
+    }
+
+    // 48-bit capacity (words 100-103), else 28-bit (words 60-61)
+    if (identify_data[83] & (1 << 10)) {
+        d->sectors = ((uint64_t)identify_data[103] << 48) | ((uint64_t)identify_data[102] << 32) |
+                     ((uint64_t)identify_data[101] << 16) | identify_data[100];
+    } else {
+        d->sectors = ((uint32_t)identify_data[61] << 16) | identify_data[60];
+    }
+
+    // NCQ needs HBA (CAP.SNCQ) and drive (word 76 bit 8); word 75 is depth - 1
+    uint32_t depth = 1;
+    d->ncq = (hba->cap & AHCI_CAP_SNCQ) && (identify_data[76] & (1 << 8));
+    if (d->ncq) {
+        depth = (identify_data[75] & 0x1F) + 1;
+        if (depth > hba_slots) depth = hba_slots;
+    }
+
+    d->block.sectors = d->sectors;
+    d->block.max_sectors = AHCI_MAX_SECTORS;
+    d->block.queue_depth = depth;
+    return d->sectors > 0;
+}
+
+// Report finished slots to the block layer
+static void ahci_complete_work(void* arg) {
+    struct ahci_disk* d = (struct ahci_disk*)arg;
+
+    uint32_t flags = spin_lock_irqsave(&d->lock);
+    uint32_t done = d->done;
+    uint32_t failed = d->failed & done;
+    d->done = 0;
+    d->failed &= ~done;
+    spin_unlock_irqrestore(&d->lock, flags);
+
+    while (done) {
+        uint32_t slot = __builtin_ctz(done);
+        done &= done - 1;
+        block_complete(&d->block, slot, !(failed & (1u << slot)));
+    }
+}
+
+// Reap one port's finished commands (interrupt context)
+static void ahci_port_irq(struct ahci_disk* d) {
+    uint32_t flags = spin_lock_irqsave(&d->lock);
+    uint32_t status = d->regs->is;
+    d->regs->is = status;
+
+    if (status & AHCI_PORT_IS_ERRORS) {
+        // One failed NCQ command aborts the whole queue
+        ahci_port_recover(d);
+    } else {
+        uint32_t finished = d->issued & ~(d->regs->ci | d->regs->sact);
+        d->issued &= ~finished;
+        d->done |= finished;
+    }
+
+    bool report = d->done != 0;
+    spin_unlock_irqrestore(&d->lock, flags);
+
+    // A pending run picks up the new bits too
+    if (report) {
+        block_schedule(&d->work);
+    }
+}
+
+// HBA interrupt
+static void ahci_irq(struct interrupt_frame* frame) {
+    (void)frame;
+
+    // The line is shared: nothing pending means another device
+    uint32_t pending = hba->is;
+    if (!pending) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < disk_count; i++) {
+        if (pending & (1u << disks[i].port)) {
+            ahci_port_irq(&disks[i]);
+        }
+    }
+    hba->is = pending;
+}
+
+// Start a block layer read/write in slot tag
+static bool ahci_block_submit(struct block_device* dev, uint32_t tag, uint64_t sector,
+                              uint32_t count, uint8_t* buffer, bool write) {
+    struct ahci_disk* d = (struct ahci_disk*)dev->private;
+    uint8_t command;
+
+    if (d->ncq) {
+        command = write ? AHCI_ATA_WRITE_FPDMA_QUEUED : AHCI_ATA_READ_FPDMA_QUEUED;
+    } else {
+        command = write ? AHCI_ATA_WRITE_DMA_EXT : AHCI_ATA_READ_DMA_EXT;
+    }
+
+    if (count > AHCI_MAX_SECTORS ||
+        !ahci_build(d, tag, command, sector, count, buffer, count * BLOCK_SECTOR_SIZE, write)) {
+        return false;
+    }
+    ahci_issue(d, tag, d->ncq);
+    return true;
+}
+
+// Start a cache flush (never queued: the block layer runs it alone)
+static bool ahci_block_flush(struct block_device* dev, uint32_t tag) {
+    struct ahci_disk* d = (struct ahci_disk*)dev->private;
+
+    if (!ahci_build(d, tag, AHCI_ATA_FLUSH_CACHE_EXT, 0, 0, NULL, 0, false)) {
+        return false;
+    }
+    ahci_issue(d, tag, false);
+    return true;
+}
+
+// Kill a stuck command (and, with it, everything else outstanding)
+static bool ahci_block_abort(struct block_device* dev, uint32_t tag) {
+    struct ahci_disk* d = (struct ahci_disk*)dev->private;
+    uint32_t bit = 1u << tag;
+
+    uint32_t flags = spin_lock_irqsave(&d->lock);
+    if (!(d->issued & bit)) {
+        spin_unlock_irqrestore(&d->lock, flags);
+        return false;               // Already finished; report is on its way
+    }
+
+    ahci_port_recover(d);
+    d->done &= ~bit;                // The caller completes this one
+    d->failed &= ~bit;
+    bool report = d->done != 0;
+    spin_unlock_irqrestore(&d->lock, flags);
+
+    if (report) {
+        block_schedule(&d->work);
+    }
+    return true;
+}
+
+static const struct block_ops ahci_block_ops = {
+    ahci_block_submit,
+    ahci_block_flush,
+    ahci_block_abort,
+    NULL,                               // PxCI is written per command
+};
+
+// Print one line per disk
+static void ahci_print_disk(struct ahci_disk* d) {
+    char num[16];
+
+    print_string("AHCI: ");
+    print_string(d->block.name);
+    print_string(" (port ");
+    print_string(utoa(d->port, num, 10));
+    print_string(") - ");
+    print_string(d->model);
+    print_string("\n      ");
+    print_string(utoa((uint32_t)(d->sectors >> 11), num, 10));
+    print_string(" MB, ");
+    if (d->ncq) {
+        print_string("NCQ depth ");
+        print_string(utoa(d->block.queue_depth, num, 10));
+    } else {
+        print_string("no NCQ");
+    }
+    print_string("\n");
+}
+
+// Find the HBA and bring up every SATA disk
+bool ahci_init(void) {
+    struct pci_device ahci;
+
+    if (!pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_SATA, 0, &ahci) ||
+        ahci.prog_if != AHCI_PROG_IF) {
+        return false;
+    }
+
+    mutex_lock(&ahci_lock);
+
+    // Disks stay registered once found
+    if (hba) {
+        mutex_unlock(&ahci_lock);
+        return disk_count > 0;
+    }
+
+    print_string("Initializing AHCI controller...\n");
+
+    uint32_t abar = pci_config_read32(&ahci, PCI_BAR(AHCI_BAR));
+    if ((abar & PCI_BAR_IO) || (abar & PCI_BAR_MEM_MASK) == 0) {
+        print_string("AHCI: No register BAR\n");
+        mutex_unlock(&ahci_lock);
+        return false;
+    }
+    pci_enable(&ahci, PCI_CMD_MEMORY | PCI_CMD_BUS_MASTER);
+
+    hba = (volatile struct ahci_hba_regs*)(abar & PCI_BAR_MEM_MASK);
+    hba->ghc |= AHCI_GHC_AE;
+    hba_slots = ((hba->cap >> AHCI_CAP_NCS_SHIFT) & 0x1F) + 1;
+
+    uint32_t implemented = hba->pi;
+    for (uint32_t port = 0; port < AHCI_MAX_PORTS && disk_count < AHCI_MAX_DISKS; port++) {
+        if ((implemented & (1u << port)) && ahci_port_init(&disks[disk_count], port)) {
+            disk_count++;
+        }
+    }
+
+    // Completion is interrupt driven: no IRQ, no disks
+    uint8_t irq = pci_config_read8(&ahci, PCI_INTERRUPT_LINE);
+    if (disk_count > 0 && (irq >= IRQ_COUNT || !irq_register_shared(irq, ahci_irq))) {
+        print_string("AHCI: IRQ unavailable\n");
+        for (uint32_t i = 0; i < disk_count; i++) {
+            ahci_port_stop(disks[i].regs);
+        }
+        disk_count = 0;
+    }
+
+    for (uint32_t i = 0; i < disk_count; i++) {
+        struct ahci_disk* d = &disks[i];
+
+        spin_lock_init(&d->lock, "ahci");
+        work_init(&d->work, ahci_complete_work, d);
+        d->issued = 0;
+        d->done = 0;
+        d->failed = 0;
+
+        d->regs->is = 0xFFFFFFFF;
+        d->regs->ie = AHCI_PORT_IS_DHRS | AHCI_PORT_IS_PSS | AHCI_PORT_IS_DSS |
+                      AHCI_PORT_IS_SDBS | AHCI_PORT_IS_ERRORS;
+
+        strcpy(d->block.name, "sd0");
+        d->block.name[2] = '0' + i;
+        d->block.ops = &ahci_block_ops;
+        d->block.private = d;
+        block_register(&d->block);
+    }
+
+    hba->is = 0xFFFFFFFF;
+    if (disk_count > 0) {
+        hba->ghc |= AHCI_GHC_IE;
+    }
+    mutex_unlock(&ahci_lock);
+
+    if (disk_count == 0) {
+        print_string("AHCI: No SATA disk detected\n");
+        return false;
+    }
+    for (uint32_t i = 0; i < disk_count; i++) {
+        ahci_print_disk(&disks[i]);
+    }
+    return true;
+}
+
+// Get disk count
+uint32_t ahci_disk_count(void) {
+    return disk_count;
+}
@@ -0,0 +1,304 @@
+/**************************************************************
+ * APIC Driver - BloodG OS
+ * Local APIC, I/O APIC redirection and LAPIC one-shot timer
+ **************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "io.h"
+#include "idt.h"
+#include "pic.h"
+#include "acpi.h"
+#include "apic.h"
+#include "clock.h"
+#include "timer.h"
+#include "math64.h"
+
+// APIC base MSR
+#define MSR_APIC_BASE           0x1B
+#define MSR_APIC_BASE_ENABLE    (1 << 11)
+
+#define CPUID_EDX_APIC          (1 << 9)
+
+// I/O APIC registers (indirect through IOREGSEL/IOWIN)
+#define IOAPIC_REGSEL           0x00
+#define IOAPIC_WINDOW           0x10
+#define IOAPIC_REG_ID           0x00
+#define IOAPIC_REG_VERSION      0x01
+#define IOAPIC_REG_REDTBL       0x10    // 2 registers per entry
+
+// Redirection entry bits
+#define IOAPIC_ACTIVE_LOW       (1 << 13)
+#define IOAPIC_LEVEL            (1 << 15)
+#define IOAPIC_MASKED           (1 << 16)
+
+#define LAPIC_CALIBRATE_MS      10
+
+// APIC state
+static volatile uint32_t* lapic_base = NULL;
+static bool apic_active = false;
+static uint8_t boot_apic_id = 0;    // ISA IRQs are delivered here
+static uint32_t timer_khz = 0;      // LAPIC timer counts per ms (divide by 16)
+static uint16_t pci_irqs = 0;       // Lines carrying PCI INTx (level/active low)
+
+void print_string(const char* str);
+char* utoa(uint32_t value, char* str, int base);
+
+// Read local APIC register
+uint32_t lapic_read(uint32_t reg) {
+    return lapic_base[reg / 4];
+}
+
+// Write local APIC register
+void lapic_write(uint32_t reg, uint32_t value) {
+    lapic_base[reg / 4] = value;
+}
+
+// Signal end of interrupt
+void lapic_eoi(void) {
+    lapic_write(LAPIC_REG_EOI, 0);
+}
+
+// Get local APIC ID
+uint8_t lapic_id(void) {
+    return lapic_read(LAPIC_REG_ID) >> 24;
+}
+
+// Check if APIC mode is active
+bool apic_enabled(void) {
+    return apic_active;
+}
+
+// Read I/O APIC register
+static uint32_t ioapic_read(uint32_t base, uint8_t reg) {
+    volatile uint32_t* ioapic = (volatile uint32_t*)base;
+    ioapic[IOAPIC_REGSEL / 4] = reg;
+    return ioapic[IOAPIC_WINDOW / 4];
+}
+
+// Write I/O APIC register
+static void ioapic_write(uint32_t base, uint8_t reg, uint32_t value) {
+    volatile uint32_t* ioapic = (volatile uint32_t*)base;
+    ioapic[IOAPIC_REGSEL / 4] = reg;
+    ioapic[IOAPIC_WINDOW / 4] = value;
+}
+
+// Number of redirection entries on an I/O APIC
+static uint32_t ioapic_max_entries(uint32_t base) {
+    return ((ioapic_read(base, IOAPIC_REG_VERSION) >> 16) & 0xFF) + 1;
+}
+
+// Find I/O APIC handling a GSI
+static const struct acpi_ioapic* ioapic_for_gsi(uint32_t gsi) {
+    const struct acpi_info* info = acpi_get_info();
+
+    for (int i = 0; i < info->ioapic_count; i++) {
+        const struct acpi_ioapic* ioapic = &info->ioapics[i];
+        if (gsi >= ioapic->gsi_base &&
+            gsi < ioapic->gsi_base + ioapic_max_entries(ioapic->address)) {
+            return ioapic;
+        }
+    }
+
+    return NULL;
+}
+
+// Program redirection entry for ISA IRQ
+static void ioapic_route(uint8_t irq, bool masked) {
+    const struct acpi_info* info = acpi_get_info();
+    uint32_t gsi = info->isa_gsi[irq];
+    uint16_t flags = info->isa_flags[irq];
+
+    const struct acpi_ioapic* ioapic = ioapic_for_gsi(gsi);
+    if (!ioapic) {
+        return;
+    }
+
+    // Fixed delivery, physical destination, ISA default is edge/active high
+    uint32_t low = IRQ_VECTOR(irq);
+    if ((flags & ACPI_IRQ_POLARITY_MASK) == ACPI_IRQ_ACTIVE_LOW) {
+        low |= IOAPIC_ACTIVE_LOW;
+    }
+    if ((flags & ACPI_IRQ_TRIGGER_MASK) == ACPI_IRQ_LEVEL) {
+        low |= IOAPIC_LEVEL;
+    }
+    if (pci_irqs & (1 << irq)) {
+        low |= IOAPIC_ACTIVE_LOW | IOAPIC_LEVEL;
+    }
+    if (masked) {
+        low |= IOAPIC_MASKED;
+    }
+
+    uint8_t entry = IOAPIC_REG_REDTBL + (gsi - ioapic->gsi_base) * 2;
+    ioapic_write(ioapic->address, entry + 1, (uint32_t)boot_apic_id << 24);
+    ioapic_write(ioapic->address, entry, low);
+}
+
+// Mark ISA IRQ as a PCI INTx line (applies on the next route)
+void ioapic_set_pci_irq(uint8_t irq) {
+    if (irq < ACPI_ISA_IRQS) {
+        pci_irqs |= 1 << irq;
+    }
+}
+
+// Route and unmask ISA IRQ
+void ioapic_enable_irq(uint8_t irq) {
+    if (irq < ACPI_ISA_IRQS) {
+        ioapic_route(irq, false);
+    }
+}
+
+// Program this CPU's local APIC
+static void lapic_setup(void) {
+    // Enable LAPIC globally
+    uint64_t base = read_msr(MSR_APIC_BASE);
+    write_msr(MSR_APIC_BASE, base | MSR_APIC_BASE_ENABLE);
+
+    // Accept all priorities, ExtINT off, NMI on LINT1, no error interrupts
+    lapic_write(LAPIC_REG_TPR, 0);
+    lapic_write(LAPIC_REG_LVT_LINT0, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_REG_LVT_LINT1, LAPIC_LVT_NMI);
+    lapic_write(LAPIC_REG_LVT_ERROR, LAPIC_LVT_MASKED | APIC_ERROR_VECTOR);
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED | APIC_TIMER_VECTOR);
+    lapic_write(LAPIC_REG_ESR, 0);
+
+    lapic_write(LAPIC_REG_SVR, LAPIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+}
+
+// Enable AP local APIC
+void lapic_init_ap(void) {
+    lapic_setup();
+    lapic_eoi();
+}
+
+// Send IPI
+void lapic_send_ipi(uint8_t apic_id, uint32_t icr_low) {
+    while (lapic_read(LAPIC_REG_ICR_LOW) & LAPIC_ICR_PENDING) {
+        asm volatile ("pause");
+    }
+
+    // Writing the low word sends it
+    lapic_write(LAPIC_REG_ICR_HIGH, (uint32_t)apic_id << 24);
+    lapic_write(LAPIC_REG_ICR_LOW, icr_low);
+
+    while (lapic_read(LAPIC_REG_ICR_LOW) & LAPIC_ICR_PENDING) {
+        asm volatile ("pause");
+    }
+}
+
+// Mask ISA IRQ
+void ioapic_disable_irq(uint8_t irq) {
+    if (irq < ACPI_ISA_IRQS) {
+        ioapic_route(irq, true);
+    }
+}
+
+// LAPIC timer interrupt
+static void lapic_timer_irq(struct interrupt_frame* frame) {
+    (void)frame;
+    timer_handler();
+}
+
+// Measure LAPIC timer rate against the TSC/HPET clock
+static void lapic_timer_calibrate(void) {
+    if (!clock_highres()) {
+        return;     // Nothing to calibrate against
+    }
+
+    lapic_write(LAPIC_REG_TIMER_DIVIDE, LAPIC_TIMER_DIV16);
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED | APIC_TIMER_VECTOR);
+    lapic_write(LAPIC_REG_TIMER_INIT, 0xFFFFFFFF);
+
+    uint64_t start = clock_ns();
+    while (clock_ns() - start < LAPIC_CALIBRATE_MS * NSEC_PER_MSEC) {
+        asm volatile ("pause");
+    }
+
+    uint32_t elapsed = 0xFFFFFFFF - lapic_read(LAPIC_REG_TIMER_CURRENT);
+    lapic_write(LAPIC_REG_TIMER_INIT, 0);
+
+    timer_khz = elapsed / LAPIC_CALIBRATE_MS;
+    if (timer_khz == 0) {
+        return;
+    }
+
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_ONESHOT | APIC_TIMER_VECTOR);
+    interrupt_register_handler(APIC_TIMER_VECTOR, lapic_timer_irq);
+}
+
+// Switch to LAPIC/IOAPIC
+bool apic_init(void) {
+    const struct acpi_info* info = acpi_get_info();
+    uint32_t eax, ebx, ecx, edx;
+
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_EDX_APIC) || !info->madt_found || info->ioapic_count == 0) {
+        print_string("APIC: Not available, using 8259 PIC\n");
+        return false;
+    }
+
+    lapic_base = (volatile uint32_t*)(info->lapic_address ? info->lapic_address
+                                                          : LAPIC_DEFAULT_BASE);
+    lapic_setup();
+    boot_apic_id = lapic_id();
+
+    // Start with every redirection entry masked
+    for (int i = 0; i < info->ioapic_count; i++) {
+        uint32_t address = info->ioapics[i].address;
+        uint32_t entries = ioapic_max_entries(address);
+        for (uint32_t j = 0; j < entries; j++) {
+            ioapic_write(address, IOAPIC_REG_REDTBL + j * 2, IOAPIC_MASKED);
+        }
+    }
+
+    // Silence the 8259s; irq_enable now goes to the I/O APIC
+    pic_disable();
+    apic_active = true;
+    lapic_eoi();
+
+    lapic_timer_calibrate();
+
+    char num[16];
+    print_string("APIC: LAPIC ");
+    print_string(utoa(lapic_id(), num, 10));
+    print_string(", ");
+    print_string(utoa(info->ioapic_count, num, 10));
+    print_string(" I/O APIC(s)");
+    if (timer_khz) {
+        print_string(", timer ");
+        print_string(utoa(timer_khz, num, 10));
+        print_string(" kHz");
+    }
+    print_string("\n");
+
+    return true;
+}
+
+// Check if LAPIC timer is usable
+bool lapic_timer_available(void) {
+    return apic_active && timer_khz != 0;
+}
+
+// Arm LAPIC one-shot
+void lapic_timer_oneshot(uint64_t delta_ns) {
+    if (delta_ns > LAPIC_TIMER_MAX_NS) {
+        delta_ns = LAPIC_TIMER_MAX_NS;
+    }
+
+    uint64_t count = div_u64(delta_ns * timer_khz, NSEC_PER_MSEC);
+    if (count < 1) count = 1;
+    if (count > 0xFFFFFFFF) count = 0xFFFFFFFF;
+
+    lapic_write(LAPIC_REG_TIMER_INIT, (uint32_t)count);
+}
+
+// Cancel LAPIC one-shot
+void lapic_timer_stop(void) {
+    lapic_write(LAPIC_REG_TIMER_INIT, 0);
+}
+
+// Get LAPIC timer rate
+uint32_t lapic_timer_khz(void) {
+    return timer_khz;
+}
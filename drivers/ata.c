@@ -1,318 +1,1385 @@
 /**************************************************************
  * ATA (IDE) Disk Driver - BloodG OS
- * Complete PIO implementation with error handling
+ * Interrupt-driven PIO and bus-master DMA, one request queue
+ * per channel, up to four drives
  **************************************************************/
 
 #include <stdint.h>
 #include <stdbool.h>
 #include "io.h"
 #include "string.h"
+#include "clock.h"
+#include "thread.h"
+#include "sync.h"
+#include "page.h"
+#include "pci.h"
+#include "idt.h"
+#include "spinlock.h"
+#include "timer_wheel.h"
+#include "block.h"
+#include "ata.h"
 
-// ATA Registers for Primary Controller
-#define ATA_DATA        0x1F0
-#define ATA_ERROR       0x1F1
-#define ATA_FEATURES    0x1F1
-#define ATA_SECTOR_CNT  0x1F2
-#define ATA_LBA_LOW     0x1F3
-#define ATA_LBA_MID     0x1F4
-#define ATA_LBA_HIGH    0x1F5
-#define ATA_DRIVE_SEL   0x1F6
-#define ATA_COMMAND     0x1F7
-#define ATA_STATUS      0x1F7
-#define ATA_ALT_STATUS  0x3F6
-
-// Status bits
-#define ATA_SR_BSY      0x80    // Busy
-#define ATA_SR_DRDY     0x40    // Drive ready
-#define ATA_SR_DF       0x20    // Drive write fault
-#define ATA_SR_DSC      0x10    // Drive seek complete
-#define ATA_SR_DRQ      0x08    // Data request ready
-#define ATA_SR_CORR     0x04    // Corrected data
-#define ATA_SR_IDX      0x02    // Index
-#define ATA_SR_ERR      0x01    // Error
-
-// Commands
-#define ATA_CMD_READ_PIO    0x20
-#define ATA_CMD_WRITE_PIO   0x30
-#define ATA_CMD_CACHE_FLUSH 0xE7
-#define ATA_CMD_IDENTIFY    0xEC
-
-// Global drive information
-static struct {
+// Task-file registers (offsets from the channel's I/O base)
+#define ATA_REG_DATA        0
+#define ATA_REG_ERROR       1
+#define ATA_REG_FEATURES    1
+#define ATA_REG_SECTOR_CNT  2
+#define ATA_REG_LBA_LOW     3
+#define ATA_REG_LBA_MID     4
+#define ATA_REG_LBA_HIGH    5
+#define ATA_REG_DRIVE_SEL   6
+#define ATA_REG_COMMAND     7
+#define ATA_REG_STATUS      7
+
+// Request states
+#define ATA_REQ_DATA    0           // Read/write command on the wire
+#define ATA_REQ_FLUSH   1           // CACHE FLUSH on the wire
+#define ATA_REQ_PACKET  2           // ATAPI READ(10) on the wire
+
+// Polling limits
+#define ATA_TIMEOUT_NS  (1000ULL * 1000000ULL)  // Give up after 1s
+#define ATA_SPIN_POLLS  1000                    // Polls before yielding the CPU
+#define ATA_MAX_POLLS   100000                  // Limit without a usable clock
+
+// Issue stages waiting on the drive (re-checked from a timer, never spun on)
+#define ATA_STAGE_NONE      0       // Nothing outstanding
+#define ATA_STAGE_SELECT    1       // Drive busy: issue again once BSY clears
+#define ATA_STAGE_WRITE     2       // PIO write: first block goes out on DRQ
+#define ATA_STAGE_PACKET    3       // ATAPI: command packet goes out on DRQ
+
+#define ATA_READY_POLLS     32                  // Status reads before deferring
+#define ATA_RETRY_NS        (1000ULL * 1000ULL) // Re-check about every jiffy
+#define ATA_RETRY_LIMIT     1000                // About ATA_TIMEOUT_NS of re-checks
+
+// Physical region descriptor (one contiguous piece of a DMA buffer)
+struct ata_prd {
+    uint32_t address;
+    uint16_t bytes;             // 0 means 64KB
+    uint16_t flags;
+} __attribute__((packed));
+
+// One IDE channel: two drives share its registers, so one command at a time
+struct ata_channel {
+    const char* name;
+    uint16_t io;                // Task-file base
+    uint16_t ctrl;              // Alt status / device control
+    uint16_t bm;                // Bus-master registers (0 = no DMA)
+    uint8_t irq;
+    struct ata_prd* prdt;       // One page: aligned, never crosses 64KB
+    
+    spinlock_t lock;            // Guards the queue and the registers while I/O runs
+    struct ata_request* head;
+    struct ata_request* tail;
+    struct ata_request* active;
+    volatile bool irq_ready;
+    bool irq_hooked;
+    uint8_t stage;              // ATA_STAGE_* of the active request
+    uint32_t retries;           // Deferrals since the last stage completed
+    int retry_timer;            // Pending re-check, or -1
+};
+
+// One drive (index = channel * 2 + slave)
+struct ata_drive {
     bool present;
+    bool slave;
     bool lba_supported;
-    uint32_t total_sectors;
+    bool lba48;                 // 48-bit commands available
+    uint64_t total_sectors;
+    uint32_t multiple;          // Sectors per DRQ block (1 = one IRQ per sector)
+    bool dma_supported;
+    bool atapi;                 // PACKET device: read-only, 2048-byte sectors, PIO
     char model[41];
     char serial[21];
-} drive_info = {0};
+    struct block_device block;  // hdN or cdN
+    struct ata_request block_req;   // Command the block layer has in flight
+};
 
-// Wait for BSY to clear
-static bool ata_wait_bsy(uint32_t timeout) {
-    for (uint32_t i = 0; i < timeout; i++) {
-        if (!(inb(ATA_STATUS) & ATA_SR_BSY)) {
+static struct ata_channel channels[ATA_CHANNELS] = {
+    { "primary", ATA_PRIMARY_DATA, ATA_PRIMARY_ALT_STATUS, 0, IRQ_ATA_PRIMARY, NULL,
+      SPINLOCK_INIT("ata0"), NULL, NULL, NULL, false, false, ATA_STAGE_NONE, 0, -1 },
+    { "secondary", ATA_SECONDARY_DATA, ATA_SECONDARY_ALT_STATUS, 0, IRQ_ATA_SECONDARY, NULL,
+      SPINLOCK_INIT("ata1"), NULL, NULL, NULL, false, false, ATA_STAGE_NONE, 0, -1 },
+};
+
+static struct ata_drive drives[ATA_MAX_DRIVES];
+static int boot_drive = -1;                 // Target of the disk_* calls
+static volatile bool dma_enabled = false;
+
+// Guards drives[] and (re)initialization
+static struct mutex ata_lock = MUTEX_INIT;
+
+static void ata_irq_primary(struct interrupt_frame* frame);
+static void ata_irq_secondary(struct interrupt_frame* frame);
+static void ata_register_block(uint32_t drive);
+
+// Channel a drive sits on
+static inline struct ata_channel* ata_channel_of(uint32_t drive) {
+    return &channels[drive / 2];
+}
+
+// Drive/head register value for LBA commands
+static inline uint8_t ata_select_lba(uint32_t drive) {
+    return (drive & 1) ? 0xF0 : 0xE0;
+}
+
+// Poll port until (status & mask) == value, yielding to other threads
+// (only when interrupts are on; the locked issue path uses ata_status_ready)
+static bool ata_poll(uint16_t port, uint8_t mask, uint8_t value) {
+    uint64_t deadline = 0;
+    
+    for (uint32_t polls = 0; ; polls++) {
+        if ((inb(port) & mask) == value) {
             return true;
         }
-        io_wait();
+        
+        // Short waits stay cheap; long ones (spin-up, seeks) let others run
+        if (polls < ATA_SPIN_POLLS) {
+            continue;
+        }
+        if (!clock_highres()) {
+            if (polls >= ATA_MAX_POLLS) {
+                return false;
+            }
+            continue;
+        }
+        if (!deadline) {
+            deadline = clock_ns() + ATA_TIMEOUT_NS;
+        } else if (clock_ns() >= deadline) {
+            return false;
+        }
+        if (read_eflags() & EFLAGS_IF) {
+            thread_yield();
+        }
     }
-    return false;
+}
+
+// Wait for BSY to clear
+static bool ata_wait_bsy(struct ata_channel* ch) {
+    return ata_poll(ch->io + ATA_REG_STATUS, ATA_SR_BSY, 0);
 }
 
 // Wait for DRQ to set
-static bool ata_wait_drq(uint32_t timeout) {
-    for (uint32_t i = 0; i < timeout; i++) {
-        if (inb(ATA_STATUS) & ATA_SR_DRQ) {
-            return true;
-        }
-        io_wait();
+static bool ata_wait_drq(struct ata_channel* ch) {
+    return ata_poll(ch->io + ATA_REG_STATUS, ATA_SR_DRQ, ATA_SR_DRQ);
+}
+
+// Give the drive 400ns to raise BSY after a command or drive select
+static void ata_delay_400ns(struct ata_channel* ch) {
+    for (int i = 0; i < 4; i++) {
+        inb(ch->ctrl);
     }
-    return false;
 }
 
-// Poll for status (BSY clear, DRQ set)
-static bool ata_poll(uint32_t timeout) {
-    if (!ata_wait_bsy(timeout)) {
+// Wait for the next data block of a command
+static bool ata_wait_data(struct ata_channel* ch) {
+    if (!ata_wait_bsy(ch)) {
+        return false;
+    }
+    if (inb(ch->io + ATA_REG_STATUS) & (ATA_SR_ERR | ATA_SR_DF)) {
+        return false;
+    }
+    return ata_wait_drq(ch);
+}
+
+// Largest power of two not above the drive's READ/WRITE MULTIPLE limit
+static uint32_t ata_multiple_size(uint16_t identify_word47) {
+    uint32_t max = identify_word47 & 0xFF;
+    uint32_t size = 1;
+    
+    while (size * 2 <= max) {
+        size *= 2;
+    }
+    return size;
+}
+
+// Enable READ/WRITE MULTIPLE with size sectors per block (caller holds ata_lock)
+static bool ata_set_multiple(uint32_t drive, uint32_t size) {
+    struct ata_channel* ch = ata_channel_of(drive);
+    
+    outb(ch->io + ATA_REG_DRIVE_SEL, ata_select_lba(drive));
+    ata_delay_400ns(ch);
+    if (!ata_wait_bsy(ch)) {
         return false;
     }
-    if (!ata_wait_drq(timeout)) {
+    
+    outb(ch->io + ATA_REG_SECTOR_CNT, size);
+    outb(ch->io + ATA_REG_COMMAND, ATA_CMD_SET_MULTIPLE);
+    ata_delay_400ns(ch);
+    
+    if (!ata_wait_bsy(ch)) {
         return false;
     }
+    return !(inb(ch->io + ATA_REG_STATUS) & (ATA_SR_ERR | ATA_SR_DF));
+}
+
+// Copy model and serial out of IDENTIFY data (word-swapped strings)
+static void ata_identify_strings(struct ata_drive* d, const uint16_t* identify_data) {
+    // Get model string (bytes 27-46, word-swapped)
+    for (int i = 0; i < 20; i++) {
+        d->model[i] = identify_data[27 + i] >> 8;
+        d->model[i + 20] = identify_data[27 + i] & 0xFF;
+    }
+    d->model[40] = '\0';
+    
+    // Trim spaces from model
+    for (int i = 39; i >= 0 && d->model[i] == ' '; i--) {
+        d->model[i] = '\0';
+    }
+    
+    // Get serial string (bytes 10-19, word-swapped)
+    for (int i = 0; i < 10; i++) {
+        d->serial[i * 2] = identify_data[10 + i] >> 8;
+        d->serial[i * 2 + 1] = identify_data[10 + i] & 0xFF;
+    }
+    d->serial[20] = '\0';
+}
+
+// Polled PACKET command with up to bytes of data in (probe only: nIEN set)
+static bool atapi_packet_polled(uint32_t drive, const uint8_t* packet, uint8_t* buffer, uint32_t bytes) {
+    struct ata_channel* ch = ata_channel_of(drive);
+    uint32_t got = 0;
+    
+    outb(ch->io + ATA_REG_DRIVE_SEL, (drive & 1) ? ATA_DRIVE_SLAVE : ATA_DRIVE_MASTER);
+    ata_delay_400ns(ch);
+    if (!ata_wait_bsy(ch)) {
+        return false;
+    }
+    
+    // PIO, at most ATAPI_BYTE_LIMIT bytes per DRQ block
+    outb(ch->io + ATA_REG_FEATURES, 0);
+    outb(ch->io + ATA_REG_LBA_MID, ATAPI_BYTE_LIMIT & 0xFF);
+    outb(ch->io + ATA_REG_LBA_HIGH, ATAPI_BYTE_LIMIT >> 8);
+    outb(ch->io + ATA_REG_COMMAND, ATA_CMD_PACKET);
+    ata_delay_400ns(ch);
+    if (!ata_wait_data(ch)) {
+        return false;
+    }
+    outsw(ch->io + ATA_REG_DATA, packet, ATAPI_PACKET_SIZE / 2);
+    
+    // DRQ blocks until the drive drops DRQ with the final status
+    for (;;) {
+        ata_delay_400ns(ch);
+        if (!ata_wait_bsy(ch)) {
+            return false;
+        }
+        uint8_t status = inb(ch->io + ATA_REG_STATUS);
+        if (status & (ATA_SR_ERR | ATA_SR_DF)) {
+            return false;
+        }
+        if (!(status & ATA_SR_DRQ)) {
+            return got == bytes;
+        }
+        
+        uint32_t block = inb(ch->io + ATA_REG_LBA_MID) | (inb(ch->io + ATA_REG_LBA_HIGH) << 8);
+        for (uint32_t i = 0; i < block; i += 2) {
+            uint16_t word = inw(ch->io + ATA_REG_DATA);
+            if (got + 2 <= bytes) {
+                buffer[got++] = word & 0xFF;
+                buffer[got++] = word >> 8;
+            }
+        }
+    }
+}
+
+// IDENTIFY PACKET DEVICE and READ CAPACITY (caller holds ata_lock)
+static bool atapi_probe(uint32_t drive) {
+    struct ata_channel* ch = ata_channel_of(drive);
+    struct ata_drive* d = &drives[drive];
+    
+    outb(ch->io + ATA_REG_COMMAND, ATA_CMD_IDENTIFY_PACKET);
+    ata_delay_400ns(ch);
+    if (!ata_wait_data(ch)) {
+        return false;
+    }
+    
+    uint16_t identify_data[256];
+    insw(ch->io + ATA_REG_DATA, identify_data, 256);
+    ata_identify_strings(d, identify_data);
+    
+    d->atapi = true;
+    d->lba_supported = true;
+    d->lba48 = false;
+    d->dma_supported = false;           // PACKET commands always use PIO
+    d->multiple = 1;
+    d->total_sectors = 0;
+    
+    // First command after reset or a media change reports UNIT ATTENTION
+    uint8_t packet[ATAPI_PACKET_SIZE] = { ATAPI_CMD_READ_CAPACITY };
+    uint8_t capacity[8];
+    for (int tries = 0; tries < 3; tries++) {
+        if (atapi_packet_polled(drive, packet, capacity, sizeof(capacity))) {
+            uint32_t last = ((uint32_t)capacity[0] << 24) | ((uint32_t)capacity[1] << 16) |
+                            ((uint32_t)capacity[2] << 8) | capacity[3];
+            uint32_t size = ((uint32_t)capacity[4] << 24) | ((uint32_t)capacity[5] << 16) |
+                            ((uint32_t)capacity[6] << 8) | capacity[7];
+            if (size == ATAPI_SECTOR_SIZE) {
+                d->total_sectors = ((uint64_t)last + 1) * ATAPI_SECTOR_RATIO;
+            }
+            break;
+        }
+    }
+    
+    // No (or unreadable) media still leaves the drive usable later
+    d->present = true;
     return true;
 }
 
-// Initialize ATA controller
-bool ata_init(void) {
-    print_string("Initializing ATA controller...\n");
+// IDENTIFY one drive and fill drives[drive] (caller holds ata_lock)
+static bool ata_probe(uint32_t drive) {
+    struct ata_channel* ch = ata_channel_of(drive);
+    struct ata_drive* d = &drives[drive];
+    
+    d->present = false;
+    d->atapi = false;
+    d->slave = drive & 1;
     
-    // Select master drive
-    outb(ATA_DRIVE_SEL, 0xA0);
+    // Select drive
+    outb(ch->io + ATA_REG_DRIVE_SEL, d->slave ? ATA_DRIVE_SLAVE : ATA_DRIVE_MASTER);
+    ata_delay_400ns(ch);
     
     // Wait for BSY to clear
-    if (!ata_wait_bsy(5000)) {
-        print_string("ATA: Drive busy timeout\n");
+    if (!ata_wait_bsy(ch)) {
         return false;
     }
     
     // Check if drive exists
-    outb(ATA_SECTOR_CNT, 0);
-    outb(ATA_LBA_LOW, 0);
-    outb(ATA_LBA_MID, 0);
-    outb(ATA_LBA_HIGH, 0);
-    outb(ATA_COMMAND, ATA_CMD_IDENTIFY);
+    outb(ch->io + ATA_REG_SECTOR_CNT, 0);
+    outb(ch->io + ATA_REG_LBA_LOW, 0);
+    outb(ch->io + ATA_REG_LBA_MID, 0);
+    outb(ch->io + ATA_REG_LBA_HIGH, 0);
+    outb(ch->io + ATA_REG_COMMAND, ATA_CMD_IDENTIFY);
+    ata_delay_400ns(ch);
     
     // Check if drive responded
-    if (inb(ATA_STATUS) == 0) {
-        print_string("ATA: No drive detected\n");
+    if (inb(ch->io + ATA_REG_STATUS) == 0) {
         return false;
     }
     
     // Wait for BSY to clear
-    if (!ata_wait_bsy(5000)) {
+    if (!ata_wait_bsy(ch)) {
         print_string("ATA: Identify command timeout\n");
         return false;
     }
     
+    // ATAPI aborts IDENTIFY and leaves its signature; SATA ones are not ours
+    uint8_t mid = inb(ch->io + ATA_REG_LBA_MID);
+    uint8_t high = inb(ch->io + ATA_REG_LBA_HIGH);
+    if (mid == ATAPI_SIG_MID && high == ATAPI_SIG_HIGH) {
+        return atapi_probe(drive);
+    }
+    if (mid || high) {
+        return false;
+    }
+    
     // Check for error
-    uint8_t status = inb(ATA_STATUS);
+    uint8_t status = inb(ch->io + ATA_REG_STATUS);
     if (status & ATA_SR_ERR) {
-        print_string("ATA: Error during identify\n");
         return false;
     }
     
     // Wait for DRQ
-    if (!ata_wait_drq(5000)) {
+    if (!ata_wait_drq(ch)) {
         print_string("ATA: No data from drive\n");
         return false;
     }
     
     // Read identify data
     uint16_t identify_data[256];
-    for (int i = 0; i < 256; i++) {
-        identify_data[i] = inw(ATA_DATA);
-    }
+    insw(ch->io + ATA_REG_DATA, identify_data, 256);
     
-    // Parse drive information
-    drive_info.present = true;
+    ata_identify_strings(d, identify_data);
     
-    // Get model string (bytes 27-46, word-swapped)
-    for (int i = 0; i < 20; i++) {
-        drive_info.model[i] = identify_data[27 + i] >> 8;
-        drive_info.model[i + 20] = identify_data[27 + i] & 0xFF;
-    }
-    drive_info.model[40] = '\0';
-    
-    // Trim spaces from model
-    for (int i = 39; i >= 0 && drive_info.model[i] == ' '; i--) {
-        drive_info.model[i] = '\0';
-    }
+    // Check LBA and DMA support
+    d->lba_supported = (identify_data[49] & (1 << 9)) != 0;
+    d->dma_supported = (identify_data[49] & (1 << 8)) != 0;
     
-    // Get serial string (bytes 10-19, word-swapped)
-    for (int i = 0; i < 10; i++) {
-        drive_info.serial[i * 2] = identify_data[10 + i] >> 8;
-        drive_info.serial[i * 2 + 1] = identify_data[10 + i] & 0xFF;
-    }
-    drive_info.serial[20] = '\0';
+    // Word 83 bit 10: 48-bit address feature set
+    d->lba48 = d->lba_supported && (identify_data[83] & (1 << 10)) != 0;
     
-    // Check LBA support
-    drive_info.lba_supported = (identify_data[49] & (1 << 9)) != 0;
-    
-    // Get total sectors (LBA28)
-    if (drive_info.lba_supported) {
-        drive_info.total_sectors = 
+    // Get total sectors (words 100-103 for LBA48, 60-61 for LBA28)
+    if (d->lba48) {
+        d->total_sectors =
+            ((uint64_t)identify_data[103] << 48) | ((uint64_t)identify_data[102] << 32) |
+            ((uint64_t)identify_data[101] << 16) | identify_data[100];
+    } else if (d->lba_supported) {
+        d->total_sectors =
             ((uint32_t)identify_data[61] << 16) | identify_data[60];
     } else {
         // CHS geometry
         uint16_t cylinders = identify_data[1];
         uint16_t heads = identify_data[3];
         uint16_t sectors = identify_data[6];
-        drive_info.total_sectors = cylinders * heads * sectors;
+        d->total_sectors = cylinders * heads * sectors;
     }
     
-    // Print drive info
-    print_string("ATA: Drive detected - ");
-    print_string(drive_info.model);
-    print_string("\n");
-    
-    if (drive_info.lba_supported) {
-        print_string("ATA: LBA supported, ");
-        char sectors_str[16];
-        utoa(drive_info.total_sectors, sectors_str, 10);
-        print_string(sectors_str);
-        print_string(" sectors\n");
-    } else {
-        print_string("ATA: CHS mode only\n");
+    // Word 47: sectors per DRQ block for READ/WRITE MULTIPLE (0 = unsupported)
+    d->multiple = 1;
+    uint32_t multiple = ata_multiple_size(identify_data[47]);
+    if (multiple > 1 && ata_set_multiple(drive, multiple)) {
+        d->multiple = multiple;
     }
     
+    d->present = true;
     return true;
 }
 
-// Read single sector (LBA)
-bool disk_read_sector(uint32_t lba, uint8_t* buffer) {
-    if (!drive_info.present) {
-        return false;
+// Find the IDE function's bus-master registers (caller holds ata_lock)
+static void ata_dma_init(void) {
+    struct pci_device ide;
+    
+    dma_enabled = false;
+    for (uint32_t c = 0; c < ATA_CHANNELS; c++) {
+        channels[c].bm = 0;
+    }
+    if (!pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE, 0, &ide) ||
+        !(ide.prog_if & ATA_PROG_IF_BUS_MASTER)) {
+        return;
     }
     
-    // Select drive (LBA mode, master)
-    outb(ATA_DRIVE_SEL, 0xE0 | ((lba >> 24) & 0x0F));
+    uint32_t bar4 = pci_config_read32(&ide, PCI_BAR(4));
+    if (!(bar4 & PCI_BAR_IO) || (bar4 & PCI_BAR_IO_MASK) == 0) {
+        return;
+    }
+    pci_enable(&ide, PCI_CMD_IO | PCI_CMD_BUS_MASTER);
     
-    // Wait for BSY to clear
-    if (!ata_wait_bsy(5000)) {
+    for (uint32_t c = 0; c < ATA_CHANNELS; c++) {
+        struct ata_channel* ch = &channels[c];
+        struct ata_drive* master = &drives[c * 2];
+        struct ata_drive* slave = &drives[c * 2 + 1];
+        
+        if (!(master->present && master->dma_supported) &&
+            !(slave->present && slave->dma_supported)) {
+            continue;
+        }
+        
+        // Each channel needs its own table so both can run at once
+        if (!ch->prdt) {
+            ch->prdt = (struct ata_prd*)page_alloc(1);
+            if (!ch->prdt) {
+                continue;
+            }
+        }
+        
+        ch->bm = (bar4 & PCI_BAR_IO_MASK) + c * ATA_BM_CHANNEL_STRIDE;
+        uint8_t capable = inb(ch->bm + ATA_BM_STATUS);
+        if (master->present && master->dma_supported) capable |= ATA_BM_SR_DRV0_DMA;
+        if (slave->present && slave->dma_supported) capable |= ATA_BM_SR_DRV1_DMA;
+        outb(ch->bm + ATA_BM_STATUS, capable);
+        
+        dma_enabled = true;
+    }
+}
+
+// Hook the channel's IRQ and unmask the drives (caller holds ata_lock)
+static bool ata_channel_start(struct ata_channel* ch) {
+    if (!ch->irq_hooked) {
+        ch->irq_hooked = irq_register_handler(ch->irq,
+            ch == &channels[0] ? ata_irq_primary : ata_irq_secondary);
+    }
+    if (!ch->irq_hooked) {
         return false;
     }
     
-    // Send sector count (1)
-    outb(ATA_SECTOR_CNT, 1);
+    inb(ch->io + ATA_REG_STATUS);           // Drop any stale INTRQ
+    outb(ch->ctrl, 0);
+    ch->irq_ready = true;
+    return true;
+}
+
+// Print one line per detected drive
+static void ata_print_drive(uint32_t drive) {
+    struct ata_drive* d = &drives[drive];
+    char num[16];
+    
+    print_string("ATA: ");
+    print_string(d->block.name);
+    print_string(" (");
+    print_string(ata_channel_of(drive)->name);
+    print_string(d->slave ? " slave) - " : " master) - ");
+    print_string(d->model);
+    print_string("\n     ");
+    
+    if (d->atapi) {
+        print_string("ATAPI, ");
+        if (d->total_sectors) {
+            print_string(utoa((uint32_t)(d->total_sectors >> 11), num, 10));
+            print_string(" MB");
+        } else {
+            print_string("no media");
+        }
+    } else if (d->lba_supported) {
+        print_string(d->lba48 ? "LBA48, " : "LBA28, ");
+        print_string(utoa((uint32_t)(d->total_sectors >> 11), num, 10));
+        print_string(" MB");
+    } else {
+        print_string("CHS only");
+    }
+    if (d->multiple > 1) {
+        print_string(", MULTIPLE ");
+        print_string(utoa(d->multiple, num, 10));
+    }
+    if (d->dma_supported && ata_channel_of(drive)->bm) {
+        print_string(", DMA");
+    }
+    print_string("\n");
+}
+
+// Initialize ATA controller
+bool ata_init(void) {
+    print_string("Initializing ATA controller...\n");
     
-    // Send LBA
-    outb(ATA_LBA_LOW, lba & 0xFF);
-    outb(ATA_LBA_MID, (lba >> 8) & 0xFF);
-    outb(ATA_LBA_HIGH, (lba >> 16) & 0xFF);
+    mutex_lock(&ata_lock);
     
-    // Send read command
-    outb(ATA_COMMAND, ATA_CMD_READ_PIO);
+    // Re-probe only once queued I/O has drained
+    for (uint32_t c = 0; c < ATA_CHANNELS; c++) {
+        while (channels[c].active || channels[c].head) {
+            thread_yield();
+        }
+        channels[c].irq_ready = false;
+    }
+    boot_drive = -1;
     
-    // Wait for data
-    if (!ata_poll(5000)) {
-        return false;
+    for (uint32_t c = 0; c < ATA_CHANNELS; c++) {
+        struct ata_channel* ch = &channels[c];
+        
+        drives[c * 2].present = false;
+        drives[c * 2 + 1].present = false;
+        
+        // Floating bus: no controller behind this channel
+        if (inb(ch->io + ATA_REG_STATUS) == 0xFF) {
+            continue;
+        }
+        
+        // Probe with interrupts masked at the drives (nIEN)
+        outb(ch->ctrl, ATA_CTL_NIEN);
+        ata_probe(c * 2);
+        ata_probe(c * 2 + 1);
     }
     
-    // Check for errors
-    uint8_t status = inb(ATA_STATUS);
-    if (status & ATA_SR_ERR) {
+    ata_dma_init();
+    
+    // From here on every command completes through IRQ14/15
+    for (uint32_t c = 0; c < ATA_CHANNELS; c++) {
+        if (!drives[c * 2].present && !drives[c * 2 + 1].present) {
+            continue;
+        }
+        if (!ata_channel_start(&channels[c])) {
+            print_string("ATA: IRQ unavailable for the ");
+            print_string(channels[c].name);
+            print_string(" channel\n");
+            drives[c * 2].present = false;
+            drives[c * 2 + 1].present = false;
+        }
+    }
+    
+    bool found = false;
+    for (uint32_t i = 0; i < ATA_MAX_DRIVES; i++) {
+        if (drives[i].present) {
+            // The disk_* calls need a hard disk, not a CD
+            if (boot_drive < 0 && !drives[i].atapi) {
+                boot_drive = i;
+            }
+            ata_register_block(i);
+            found = true;
+        }
+    }
+    mutex_unlock(&ata_lock);
+    
+    if (!found) {
+        print_string("ATA: No drive detected\n");
         return false;
     }
     
-    // Read data (256 words = 512 bytes)
-    uint16_t* buf16 = (uint16_t*)buffer;
-    for (int i = 0; i < 256; i++) {
-        buf16[i] = inw(ATA_DATA);
+    for (uint32_t i = 0; i < ATA_MAX_DRIVES; i++) {
+        if (drives[i].present) {
+            ata_print_drive(i);
+        }
+    }
+    return true;
+}
+
+/* ==================== REQUEST QUEUE ==================== */
+
+// Describe buffer in the channel's PRD table, split at 64KB boundaries
+static bool ata_dma_build_prdt(struct ata_channel* ch, uint8_t* buffer, uint32_t bytes) {
+    uint32_t address = (uint32_t)buffer;   // Identity mapped: virtual == physical
+    uint32_t entries = 0;
+    
+    while (bytes > 0) {
+        if (entries == ATA_PRD_MAX) {
+            return false;
+        }
+        
+        uint32_t chunk = 0x10000 - (address & 0xFFFF);
+        if (chunk > bytes) chunk = bytes;
+        
+        ch->prdt[entries].address = address;
+        ch->prdt[entries].bytes = chunk & 0xFFFF;
+        ch->prdt[entries].flags = 0;
+        
+        address += chunk;
+        bytes -= chunk;
+        entries++;
     }
     
+    ch->prdt[entries - 1].flags = ATA_PRD_EOT;
     return true;
 }
 
-// Write single sector (LBA)
-bool disk_write_sector(uint32_t lba, uint8_t* buffer) {
-    if (!drive_info.present) {
+// Stop the bus-master engine and clear its status, returning the old status
+static uint8_t ata_dma_stop(struct ata_channel* ch, bool write) {
+    outb(ch->bm + ATA_BM_COMMAND, write ? 0 : ATA_BM_CMD_READ);
+    uint8_t status = inb(ch->bm + ATA_BM_STATUS);
+    outb(ch->bm + ATA_BM_STATUS, status | ATA_BM_SR_ERR | ATA_BM_SR_IRQ);
+    return status;
+}
+
+// Pick command width and size for the next chunk of req
+static uint32_t ata_next_chunk(struct ata_request* req, bool* ext) {
+    uint64_t lba = req->lba + req->done;
+    uint32_t left = req->count - req->done;
+    uint32_t small = left < ATA_MAX_SECTORS ? left : ATA_MAX_SECTORS;
+    
+    // 48-bit only when the address or the size needs it
+    *ext = drives[req->drive].lba48 &&
+           (lba + small > ATA_LBA28_LIMIT || left > ATA_MAX_SECTORS);
+    if (!*ext) {
+        return small;
+    }
+    
+    uint32_t limit = req->dma ? ATA_DMA_MAX_SECTORS : ATA_MAX_SECTORS_EXT;
+    return left < limit ? left : limit;
+}
+
+// Write LBA and count to the task file (HOB bytes first for 48-bit)
+static void ata_write_taskfile(struct ata_channel* ch, uint64_t lba, uint32_t count, bool ext) {
+    if (ext) {
+        outb(ch->io + ATA_REG_SECTOR_CNT, (count >> 8) & 0xFF);    // 0 with low 0 means 65536
+        outb(ch->io + ATA_REG_LBA_LOW, (lba >> 24) & 0xFF);
+        outb(ch->io + ATA_REG_LBA_MID, (lba >> 32) & 0xFF);
+        outb(ch->io + ATA_REG_LBA_HIGH, (lba >> 40) & 0xFF);
+    }
+    outb(ch->io + ATA_REG_SECTOR_CNT, count & 0xFF);
+    outb(ch->io + ATA_REG_LBA_LOW, lba & 0xFF);
+    outb(ch->io + ATA_REG_LBA_MID, (lba >> 8) & 0xFF);
+    outb(ch->io + ATA_REG_LBA_HIGH, (lba >> 16) & 0xFF);
+}
+
+// Brief status check for the issue path, which runs with the channel lock
+// held and interrupts off: true once BSY is clear and, if want is given,
+// the drive raised it or an error
+static bool ata_status_ready(struct ata_channel* ch, uint8_t want, uint8_t* status) {
+    for (int i = 0; i < ATA_READY_POLLS; i++) {
+        *status = inb(ch->io + ATA_REG_STATUS);
+        if (!(*status & ATA_SR_BSY) &&
+            (!want || (*status & (want | ATA_SR_ERR | ATA_SR_DF)))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void ata_issue_retry(void* arg);
+
+// Drive not ready: re-check stage from a timer (channel lock held)
+static bool ata_defer(struct ata_channel* ch, uint8_t stage) {
+    if (ch->retry_timer >= 0) {
+        timer_cancel(ch->retry_timer);
+    }
+    ch->stage = ATA_STAGE_NONE;
+    ch->retry_timer = -1;
+    
+    if (++ch->retries > ATA_RETRY_LIMIT) {
+        return false;
+    }
+    ch->retry_timer = timer_add(ATA_RETRY_NS, ata_issue_retry, ch);
+    if (ch->retry_timer < 0) {
         return false;
     }
+    ch->stage = stage;
+    return true;
+}
+
+// Send the READ(10) packet once the drive asks for it (channel lock held)
+static bool atapi_send_packet(struct ata_channel* ch, struct ata_request* req) {
+    uint32_t blocks = req->chunk / ATAPI_SECTOR_RATIO;
+    uint32_t lba = (uint32_t)((req->lba + req->done) / ATAPI_SECTOR_RATIO);
+    uint8_t status;
     
-    // Select drive (LBA mode, master)
-    outb(ATA_DRIVE_SEL, 0xE0 | ((lba >> 24) & 0x0F));
+    if (!ata_status_ready(ch, ATA_SR_DRQ, &status)) {
+        return ata_defer(ch, ATA_STAGE_PACKET);
+    }
+    if ((status & (ATA_SR_ERR | ATA_SR_DF)) || !(status & ATA_SR_DRQ)) {
+        return false;
+    }
     
-    // Wait for BSY to clear
-    if (!ata_wait_bsy(5000)) {
+    // One command for the whole chunk: every DRQ block then raises an IRQ
+    uint8_t packet[ATAPI_PACKET_SIZE] = {
+        ATAPI_CMD_READ_10, 0,
+        (lba >> 24) & 0xFF, (lba >> 16) & 0xFF, (lba >> 8) & 0xFF, lba & 0xFF,
+        0, (blocks >> 8) & 0xFF, blocks & 0xFF, 0, 0, 0
+    };
+    outsw(ch->io + ATA_REG_DATA, packet, ATAPI_PACKET_SIZE / 2);
+    ch->retries = 0;
+    return true;
+}
+
+// Start a READ(10) for the next CD sectors of req (channel lock held)
+static bool atapi_issue(struct ata_channel* ch, struct ata_request* req) {
+    uint32_t left = (req->count - req->done) / ATAPI_SECTOR_RATIO;
+    uint32_t blocks = left < ATAPI_MAX_BLOCKS ? left : ATAPI_MAX_BLOCKS;
+    uint8_t status;
+    
+    req->chunk = blocks * ATAPI_SECTOR_RATIO;
+    req->moved = 0;
+    req->state = ATA_REQ_PACKET;
+    
+    outb(ch->io + ATA_REG_DRIVE_SEL, (req->drive & 1) ? ATA_DRIVE_SLAVE : ATA_DRIVE_MASTER);
+    ata_delay_400ns(ch);
+    if (!ata_status_ready(ch, 0, &status)) {
+        return ata_defer(ch, ATA_STAGE_SELECT);
+    }
+    
+    // PIO; the drive splits the data into DRQ blocks of at most the limit
+    outb(ch->io + ATA_REG_FEATURES, 0);
+    outb(ch->io + ATA_REG_LBA_MID, ATAPI_BYTE_LIMIT & 0xFF);
+    outb(ch->io + ATA_REG_LBA_HIGH, ATAPI_BYTE_LIMIT >> 8);
+    outb(ch->io + ATA_REG_COMMAND, ATA_CMD_PACKET);
+    ata_delay_400ns(ch);
+    return atapi_send_packet(ch, req);
+}
+
+// PIO write: send the first block once the drive asks for it (channel lock held)
+static bool ata_write_first(struct ata_channel* ch, struct ata_request* req) {
+    struct ata_drive* d = &drives[req->drive];
+    uint8_t status;
+    
+    if (!ata_status_ready(ch, ATA_SR_DRQ, &status)) {
+        return ata_defer(ch, ATA_STAGE_WRITE);
+    }
+    if ((status & (ATA_SR_ERR | ATA_SR_DF)) || !(status & ATA_SR_DRQ)) {
         return false;
     }
     
-    // Send sector count (1)
-    outb(ATA_SECTOR_CNT, 1);
+    uint32_t block = req->chunk < d->multiple ? req->chunk : d->multiple;
+    outsw(ch->io + ATA_REG_DATA, req->buffer + req->done * 512, block * 256);
+    req->moved = block;
+    ch->retries = 0;
+    return true;
+}
+
+// Start the next command of req (channel lock held); a busy drive is
+// re-checked from a timer rather than polled with interrupts off
+static bool ata_issue(struct ata_channel* ch, struct ata_request* req) {
+    struct ata_drive* d = &drives[req->drive];
+    uint8_t status;
+    
+    if (d->atapi) {
+        return atapi_issue(ch, req);
+    }
+    
+    // Flush request (count 0)
+    if (req->done == req->count) {
+        req->state = ATA_REQ_FLUSH;
+        outb(ch->io + ATA_REG_DRIVE_SEL, ata_select_lba(req->drive));
+        ata_delay_400ns(ch);
+        if (!ata_status_ready(ch, 0, &status)) {
+            return ata_defer(ch, ATA_STAGE_SELECT);
+        }
+        outb(ch->io + ATA_REG_COMMAND, d->lba48 ? ATA_CMD_CACHE_FLUSH_EXT : ATA_CMD_CACHE_FLUSH);
+        ch->retries = 0;
+        return true;
+    }
+    
+    bool ext;
+    uint64_t lba = req->lba + req->done;
+    uint8_t* buffer = req->buffer + req->done * 512;
     
-    // Send LBA
-    outb(ATA_LBA_LOW, lba & 0xFF);
-    outb(ATA_LBA_MID, (lba >> 8) & 0xFF);
-    outb(ATA_LBA_HIGH, (lba >> 16) & 0xFF);
+    req->chunk = ata_next_chunk(req, &ext);
+    req->moved = 0;
+    req->state = ATA_REQ_DATA;
     
-    // Send write command
-    outb(ATA_COMMAND, ATA_CMD_WRITE_PIO);
+    if (req->dma) {
+        if (!ata_dma_build_prdt(ch, buffer, req->chunk * 512)) {
+            return false;
+        }
+        ata_dma_stop(ch, req->write);
+        outl(ch->bm + ATA_BM_PRDT, (uint32_t)ch->prdt);
+    }
     
-    // Wait for DRQ
-    if (!ata_wait_drq(5000)) {
+    // Select drive (LBA mode; 48-bit keeps the top bits in HOB)
+    uint8_t select = ata_select_lba(req->drive);
+    outb(ch->io + ATA_REG_DRIVE_SEL, ext ? select : select | ((lba >> 24) & 0x0F));
+    ata_delay_400ns(ch);
+    if (!ata_status_ready(ch, 0, &status)) {
+        return ata_defer(ch, ATA_STAGE_SELECT);
+    }
+    
+    // Send sector count (0 means 256, or 65536 for 48-bit) and LBA
+    ata_write_taskfile(ch, lba, req->chunk, ext);
+    
+    // MULTIPLE variants raise DRQ once per block instead of once per sector
+    uint8_t command;
+    if (req->dma) {
+        if (ext) {
+            command = req->write ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_READ_DMA_EXT;
+        } else {
+            command = req->write ? ATA_CMD_WRITE_DMA : ATA_CMD_READ_DMA;
+        }
+    } else if (d->multiple > 1) {
+        if (ext) {
+            command = req->write ? ATA_CMD_WRITE_MULTIPLE_EXT : ATA_CMD_READ_MULTIPLE_EXT;
+        } else {
+            command = req->write ? ATA_CMD_WRITE_MULTIPLE : ATA_CMD_READ_MULTIPLE;
+        }
+    } else {
+        if (ext) {
+            command = req->write ? ATA_CMD_WRITE_PIO_EXT : ATA_CMD_READ_PIO_EXT;
+        } else {
+            command = req->write ? ATA_CMD_WRITE_PIO : ATA_CMD_READ_PIO;
+        }
+    }
+    outb(ch->io + ATA_REG_COMMAND, command);
+    
+    if (req->dma) {
+        outb(ch->bm + ATA_BM_COMMAND,
+             (req->write ? 0 : ATA_BM_CMD_READ) | ATA_BM_CMD_START);
+        ch->retries = 0;
+        return true;
+    }
+    
+    // PIO writes: the first block goes out without an interrupt
+    if (req->write) {
+        ata_delay_400ns(ch);
+        return ata_write_first(ch, req);
+    }
+    ch->retries = 0;
+    return true;
+}
+
+// Deliver an async result in process context
+static void ata_request_work(void* arg) {
+    struct ata_request* req = (struct ata_request*)arg;
+    req->callback(req);
+}
+
+// Finish request and hand it back (channel lock held)
+static void ata_finish(struct ata_channel* ch, struct ata_request* req, bool ok) {
+    if (ch->active == req) {
+        ch->active = NULL;
+    }
+    req->ok = ok;
+    req->finished = true;
+    
+    // Callbacks run on kblockd, never in the IRQ handler (they may resubmit)
+    if (!req->callback) {
+        complete(&req->completion);
+    } else {
+        block_schedule(&req->work);
+    }
+}
+
+// Start queued requests until one is on the wire (channel lock held)
+static void ata_start_next(struct ata_channel* ch) {
+    while (!ch->active && ch->head) {
+        struct ata_request* req = ch->head;
+        ch->head = req->next;
+        if (!ch->head) {
+            ch->tail = NULL;
+        }
+        req->next = NULL;
+        
+        ch->active = req;
+        ch->retries = 0;
+        if (!ata_issue(ch, req)) {
+            ata_finish(ch, req, false);
+        }
+    }
+}
+
+// Resume a deferred issue stage (channel lock held)
+static void ata_issue_continue(struct ata_channel* ch) {
+    struct ata_request* req = ch->active;
+    uint8_t stage = ch->stage;
+    bool ok;
+    
+    ch->stage = ATA_STAGE_NONE;
+    if (!req || stage == ATA_STAGE_NONE) {
+        return;
+    }
+    
+    if (stage == ATA_STAGE_WRITE) {
+        ok = ata_write_first(ch, req);
+    } else if (stage == ATA_STAGE_PACKET) {
+        ok = atapi_send_packet(ch, req);
+    } else {
+        ok = ata_issue(ch, req);
+    }
+    if (!ok) {
+        ata_finish(ch, req, false);
+        ata_start_next(ch);
+    }
+}
+
+// Re-check timer for a deferred stage (interrupt context)
+static void ata_issue_retry(void* arg) {
+    struct ata_channel* ch = (struct ata_channel*)arg;
+    uint32_t flags = spin_lock_irqsave(&ch->lock);
+    
+    ch->retry_timer = -1;
+    ata_issue_continue(ch);
+    spin_unlock_irqrestore(&ch->lock, flags);
+}
+
+// Take one DRQ block of a READ(10), or finish the chunk (channel lock held)
+static void atapi_service(struct ata_channel* ch, struct ata_request* req, uint8_t status) {
+    uint32_t total = req->chunk * 512;
+    
+    if (status & ATA_SR_DRQ) {
+        uint32_t bytes = inb(ch->io + ATA_REG_LBA_MID) | (inb(ch->io + ATA_REG_LBA_HIGH) << 8);
+        uint32_t take = bytes < total - req->moved ? bytes : total - req->moved;
+        uint8_t* buffer = req->buffer + req->done * 512 + req->moved;
+        
+        insw(ch->io + ATA_REG_DATA, buffer, take / 2);
+        for (uint32_t i = take; i < bytes; i += 2) {
+            inw(ch->io + ATA_REG_DATA);     // More than asked for: drain it
+        }
+        req->moved += take;
+        return;                 // Next interrupt: next block or final status
+    }
+    
+    // DRQ clear: command done
+    if (req->moved < total) {
+        ata_finish(ch, req, false);
+        return;
+    }
+    req->done += req->chunk;
+    if (req->done < req->count) {
+        if (!ata_issue(ch, req)) {
+            ata_finish(ch, req, false);
+        }
+        return;
+    }
+    ata_finish(ch, req, true);
+}
+
+// Advance the active request after an interrupt (channel lock held)
+static void ata_service(struct ata_channel* ch, struct ata_request* req,
+                        uint8_t status, uint8_t bm_status) {
+    struct ata_drive* d = &drives[req->drive];
+    
+    if (status & ATA_SR_BSY) {
+        return;                 // Not for us yet
+    }
+    if ((status & (ATA_SR_ERR | ATA_SR_DF)) || (bm_status & ATA_BM_SR_ERR)) {
+        ata_finish(ch, req, false);
+        return;
+    }
+    if (req->state == ATA_REQ_FLUSH) {
+        ata_finish(ch, req, true);
+        return;
+    }
+    if (req->state == ATA_REQ_PACKET) {
+        atapi_service(ch, req, status);
+        return;
+    }
+    
+    // PIO: one interrupt per DRQ block (reads) or per block written (writes)
+    if (!req->dma && req->moved < req->chunk) {
+        uint32_t left = req->chunk - req->moved;
+        uint32_t block = left < d->multiple ? left : d->multiple;
+        uint8_t* buffer = req->buffer + (req->done + req->moved) * 512;
+        
+        if (!(status & ATA_SR_DRQ)) {
+            ata_finish(ch, req, false);
+            return;
+        }
+        if (req->write) {
+            outsw(ch->io + ATA_REG_DATA, buffer, block * 256);
+            req->moved += block;
+            return;             // Next interrupt: block accepted
+        }
+        insw(ch->io + ATA_REG_DATA, buffer, block * 256);
+        req->moved += block;
+        if (req->moved < req->chunk) {
+            return;
+        }
+        // Last read block: the command is done, no further interrupt
+    }
+    
+    // Command finished: next chunk (writes stay in the drive cache until a flush)
+    req->done += req->chunk;
+    if (req->done < req->count) {
+        if (!ata_issue(ch, req)) {
+            ata_finish(ch, req, false);
+        }
+        return;
+    }
+    ata_finish(ch, req, true);
+}
+
+// Channel interrupt
+static void ata_channel_irq(struct ata_channel* ch) {
+    uint32_t flags = spin_lock_irqsave(&ch->lock);
+    struct ata_request* req = ch->active;
+    uint8_t bm_status = 0;
+    
+    // Mid-issue (an ATAPI drive may interrupt when it wants the packet)
+    if (ch->stage != ATA_STAGE_NONE) {
+        inb(ch->io + ATA_REG_STATUS);
+        ata_issue_continue(ch);
+        spin_unlock_irqrestore(&ch->lock, flags);
+        return;
+    }
+    
+    if (req && req->dma && req->state == ATA_REQ_DATA) {
+        // Engine still running and no error: not the end of our transfer
+        bm_status = inb(ch->bm + ATA_BM_STATUS);
+        if (!(bm_status & (ATA_BM_SR_IRQ | ATA_BM_SR_ERR))) {
+            spin_unlock_irqrestore(&ch->lock, flags);
+            return;
+        }
+        ata_dma_stop(ch, req->write);
+    }
+    uint8_t status = inb(ch->io + ATA_REG_STATUS);     // Also acknowledges INTRQ
+    
+    if (req) {
+        ata_service(ch, req, status, bm_status);
+        ata_start_next(ch);
+    }
+    spin_unlock_irqrestore(&ch->lock, flags);
+}
+
+// IRQ14 entry
+static void ata_irq_primary(struct interrupt_frame* frame) {
+    (void)frame;
+    ata_channel_irq(&channels[0]);
+}
+
+// IRQ15 entry
+static void ata_irq_secondary(struct interrupt_frame* frame) {
+    (void)frame;
+    ata_channel_irq(&channels[1]);
+}
+
+// Fill in a request
+void ata_request_init(struct ata_request* req, uint32_t drive, uint64_t lba, uint32_t count,
+                      uint8_t* buffer, bool write, ata_callback_t callback, void* arg) {
+    req->drive = drive;
+    req->lba = lba;
+    req->count = count;
+    req->buffer = buffer;
+    req->write = write;
+    req->callback = callback;
+    req->arg = arg;
+    req->ok = false;
+    req->finished = false;
+    req->done = 0;
+    req->chunk = 0;
+    req->moved = 0;
+    req->state = ATA_REQ_DATA;
+    req->dma = false;
+    req->next = NULL;
+    completion_init(&req->completion);
+    work_init(&req->work, ata_request_work, req);
+}
+
+// Queue request on its drive's channel
+bool ata_submit(struct ata_request* req) {
+    if (req->drive >= ATA_MAX_DRIVES || (req->count == 0 && !req->write)) {
         return false;
     }
     
-    // Write data
-    uint16_t* buf16 = (uint16_t*)buffer;
-    for (int i = 0; i < 256; i++) {
-        outw(ATA_DATA, buf16[i]);
+    struct ata_channel* ch = ata_channel_of(req->drive);
+    struct ata_drive* d = &drives[req->drive];
+    
+    if (!d->present || !ch->irq_ready) {
+        return false;
+    }
+    if (req->lba + req->count > d->total_sectors) {
+        return false;           // Also keeps LBA28-only drives below 128GiB
+    }
+    if (d->atapi && (req->write || (req->lba | req->count) % ATAPI_SECTOR_RATIO)) {
+        return false;           // Read-only, whole CD sectors only
     }
     
-    // Flush cache
-    outb(ATA_COMMAND, ATA_CMD_CACHE_FLUSH);
+    // PRD addresses must be word aligned; odd buffers go through PIO
+    req->dma = dma_enabled && ch->bm && d->dma_supported &&
+               req->count > 0 && !((uint32_t)req->buffer & 1);
     
-    // Wait for BSY to clear
-    return ata_wait_bsy(5000);
+    uint32_t flags = spin_lock_irqsave(&ch->lock);
+    if (ch->tail) {
+        ch->tail->next = req;
+    } else {
+        ch->head = req;
+    }
+    ch->tail = req;
+    ata_start_next(ch);
+    spin_unlock_irqrestore(&ch->lock, flags);
+    return true;
 }
 
-// Read multiple sectors
-bool disk_read_sectors(uint32_t lba, uint8_t count, uint8_t* buffer) {
-    for (uint8_t i = 0; i < count; i++) {
-        if (!disk_read_sector(lba + i, buffer + (i * 512))) {
-            return false;
+// Give up on a request whose interrupt never came (false if it already finished)
+static bool ata_cancel(struct ata_request* req) {
+    struct ata_channel* ch = ata_channel_of(req->drive);
+    uint32_t flags = spin_lock_irqsave(&ch->lock);
+    
+    if (req->finished) {
+        spin_unlock_irqrestore(&ch->lock, flags);
+        return false;
+    }
+    
+    if (ch->active == req) {
+        // Reset the channel so a late interrupt cannot hit the next request
+        // (the next issue waits out BSY from its retry timer)
+        if (req->dma) {
+            ata_dma_stop(ch, req->write);
+        }
+        if (ch->retry_timer >= 0) {
+            timer_cancel(ch->retry_timer);
+            ch->retry_timer = -1;
+        }
+        ch->stage = ATA_STAGE_NONE;
+        ch->retries = 0;
+        outb(ch->ctrl, ATA_CTL_SRST);
+        ata_delay_400ns(ch);
+        outb(ch->ctrl, 0);
+        ch->active = NULL;
+    } else {
+        struct ata_request* prev = NULL;
+        for (struct ata_request* cur = ch->head; cur; prev = cur, cur = cur->next) {
+            if (cur != req) {
+                continue;
+            }
+            if (prev) {
+                prev->next = cur->next;
+            } else {
+                ch->head = cur->next;
+            }
+            if (ch->tail == cur) {
+                ch->tail = prev;
+            }
+            break;
         }
     }
+    
+    req->ok = false;
+    req->finished = true;
+    ata_start_next(ch);
+    spin_unlock_irqrestore(&ch->lock, flags);
     return true;
 }
 
+// Block until a callback-less request finishes
+bool ata_request_wait(struct ata_request* req) {
+    // Generous: every 128KB command gets the full poll timeout
+    uint64_t timeout = ATA_TIMEOUT_NS * (2 + req->count / ATA_MAX_SECTORS);
+    
+    if (!wait_for_completion_timeout(&req->completion, timeout)) {
+        ata_cancel(req);
+    }
+    return req->ok;
+}
+
+// Synchronous transfer
+static bool ata_transfer(uint32_t drive, uint64_t lba, uint32_t count, uint8_t* buffer, bool write) {
+    struct ata_request req;
+    
+    if (count == 0) {
+        return true;
+    }
+    
+    ata_request_init(&req, drive, lba, count, buffer, write, NULL, NULL);
+    if (!ata_submit(&req)) {
+        return false;
+    }
+    return ata_request_wait(&req);
+}
+
+// Read sectors from a drive
+bool ata_read(uint32_t drive, uint64_t lba, uint32_t count, uint8_t* buffer) {
+    return ata_transfer(drive, lba, count, buffer, false);
+}
+
+// Write sectors to a drive
+bool ata_write(uint32_t drive, uint64_t lba, uint32_t count, uint8_t* buffer) {
+    return ata_transfer(drive, lba, count, buffer, true);
+}
+
+// Read single sector (LBA)
+bool disk_read_sector(uint32_t lba, uint8_t* buffer) {
+    return boot_drive >= 0 && ata_read(boot_drive, lba, 1, buffer);
+}
+
+// Write single sector (LBA)
+bool disk_write_sector(uint32_t lba, uint8_t* buffer) {
+    return boot_drive >= 0 && ata_write(boot_drive, lba, 1, buffer);
+}
+
+// Read multiple sectors
+bool disk_read_sectors(uint64_t lba, uint32_t count, uint8_t* buffer) {
+    return boot_drive >= 0 && ata_read(boot_drive, lba, count, buffer);
+}
+
 // Write multiple sectors
-bool disk_write_sectors(uint32_t lba, uint8_t count, uint8_t* buffer) {
-    for (uint8_t i = 0; i < count; i++) {
-        if (!disk_write_sector(lba + i, buffer + (i * 512))) {
-            return false;
+bool disk_write_sectors(uint64_t lba, uint32_t count, uint8_t* buffer) {
+    return boot_drive >= 0 && ata_write(boot_drive, lba, count, buffer);
+}
+
+// Flush drive cache
+bool ata_flush_cache(uint32_t drive) {
+    struct ata_request req;
+    
+    ata_request_init(&req, drive, 0, 0, NULL, true, NULL, NULL);
+    if (!ata_submit(&req)) {
+        return false;
+    }
+    return ata_request_wait(&req);
+}
+
+// Check if DMA was set up on any channel
+bool ata_dma_available(void) {
+    for (uint32_t c = 0; c < ATA_CHANNELS; c++) {
+        if (channels[c].bm) {
+            return true;
         }
     }
-    return true;
+    return false;
+}
+
+// Switch between DMA and PIO
+bool ata_set_dma(bool enable) {
+    mutex_lock(&ata_lock);
+    dma_enabled = enable && ata_dma_available();
+    bool enabled = dma_enabled;
+    mutex_unlock(&ata_lock);
+    return enabled;
+}
+
+// Check if DMA is in use
+bool ata_dma_enabled(void) {
+    return dma_enabled;
 }
 
 // Get drive information
-bool ata_get_drive_info(char* model, char* serial, uint32_t* sectors) {
-    if (!drive_info.present) {
+bool ata_get_drive_info(uint32_t drive, char* model, char* serial, uint64_t* sectors) {
+    if (drive >= ATA_MAX_DRIVES) {
+        return false;
+    }
+    
+    mutex_lock(&ata_lock);
+    struct ata_drive* d = &drives[drive];
+    
+    if (!d->present) {
+        mutex_unlock(&ata_lock);
         return false;
     }
     
     if (model) {
-        strcpy(model, drive_info.model);
+        strcpy(model, d->model);
     }
     if (serial) {
-        strcpy(serial, drive_info.serial);
+        strcpy(serial, d->serial);
     }
     if (sectors) {
-        *sectors = drive_info.total_sectors;
+        *sectors = d->total_sectors;
     }
     
+    mutex_unlock(&ata_lock);
     return true;
 }
 
+// Block device name of a drive
+const char* ata_drive_name(uint32_t drive) {
+    if (drive >= ATA_MAX_DRIVES || !drives[drive].present) {
+        return NULL;
+    }
+    return drives[drive].block.name;
+}
+
 // Check if drive is ready
-bool ata_drive_ready(void) {
-    return drive_info.present;
+bool ata_drive_ready(uint32_t drive) {
+    return drive < ATA_MAX_DRIVES && drives[drive].present;
+}
+
+// Drive used by the disk_* calls
+int ata_boot_drive(void) {
+    return boot_drive;
+}
+
+/* ==================== BLOCK DEVICE ==================== */
+
+// Block layer command finished
+static void ata_block_done(struct ata_request* req) {
+    block_complete((struct block_device*)req->arg, 0, req->ok);
+}
+
+// Start a block layer command (queue depth 1: tag is always 0)
+static bool ata_block_submit(struct block_device* dev, uint32_t tag, uint64_t sector,
+                             uint32_t count, uint8_t* buffer, bool write) {
+    struct ata_drive* d = (struct ata_drive*)dev->private;
+    
+    (void)tag;
+    ata_request_init(&d->block_req, d - drives, sector, count, buffer, write,
+                     ata_block_done, dev);
+    return ata_submit(&d->block_req);
+}
+
+// Start a block layer cache flush
+static bool ata_block_flush(struct block_device* dev, uint32_t tag) {
+    struct ata_drive* d = (struct ata_drive*)dev->private;
+    
+    (void)tag;
+    ata_request_init(&d->block_req, d - drives, 0, 0, NULL, true, ata_block_done, dev);
+    return ata_submit(&d->block_req);
+}
+
+// Kill a stuck block layer command
+static bool ata_block_abort(struct block_device* dev, uint32_t tag) {
+    struct ata_drive* d = (struct ata_drive*)dev->private;
+    
+    (void)tag;
+    return ata_cancel(&d->block_req);
+}
+
+static const struct block_ops ata_block_ops = {
+    ata_block_submit,
+    ata_block_flush,
+    ata_block_abort,
+    NULL,                               // One command at a time
+};
+
+// CDs have no write cache to flush
+static const struct block_ops atapi_block_ops = {
+    ata_block_submit,
+    NULL,
+    ata_block_abort,
+    NULL,
+};
+
+// Expose drive as hdN, or cdN for ATAPI (caller holds ata_lock)
+static void ata_register_block(uint32_t drive) {
+    struct ata_drive* d = &drives[drive];
+    
+    if (d->atapi) {
+        uint32_t index = 0;
+        for (uint32_t i = 0; i < drive; i++) {
+            if (drives[i].present && drives[i].atapi) {
+                index++;
+            }
+        }
+        strcpy(d->block.name, "cd0");
+        d->block.name[2] = '0' + index;
+        d->block.ops = &atapi_block_ops;
+        d->block.max_sectors = ATAPI_MAX_BLOCKS * ATAPI_SECTOR_RATIO;
+    } else {
+        strcpy(d->block.name, "hd0");
+        d->block.name[2] = '0' + drive;
+        d->block.ops = &ata_block_ops;
+        d->block.max_sectors = d->lba48 ? ATA_DMA_MAX_SECTORS : ATA_MAX_SECTORS;
+    }
+    d->block.private = d;
+    d->block.sectors = d->total_sectors;
+    d->block.queue_depth = 1;           // Channel runs one command at a time
+    block_register(&d->block);
 }
@@ -0,0 +1,187 @@
+/**************************************************************
+ * TSC Monotonic Clock - BloodG OS
+ * rdtsc timestamps calibrated at boot against HPET or PIT channel 2
+ **************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "io.h"
+#include "timer.h"
+#include "hpet.h"
+#include "math64.h"
+#include "clock.h"
+
+// PIT channel 2 (gated through port 0x61)
+#define PIT_CHANNEL2        0x42
+#define PIT_COMMAND         0x43
+#define PIT_CMD_CH2_ONESHOT 0xB0  // Channel 2, lo/hi byte, mode 0, binary
+#define PIT_BASE_FREQ       1193182
+
+#define PORT_B              0x61
+#define PORT_B_GATE2        0x01  // Timer 2 gate
+#define PORT_B_SPEAKER      0x02  // Speaker data enable
+#define PORT_B_OUT2         0x20  // Timer 2 output (read-only)
+
+// CPUID feature bits
+#define CPUID_EDX_TSC           (1 << 4)
+#define CPUID_EDX_INVARIANT_TSC (1 << 8)   // Leaf 0x80000007
+
+// Fixed-point cycles -> ns factor: ns = cycles * mult >> CLOCK_SHIFT
+#define CLOCK_SHIFT         24
+
+// Clock state
+static bool tsc_enabled = false;
+static bool tsc_invariant = false;
+static uint32_t tsc_khz = 0;
+static uint32_t tsc_mult = 0;
+static uint64_t tsc_base = 0;
+static uint64_t hpet_base_count = 0;
+
+void print_string(const char* str);
+char* utoa(uint32_t value, char* str, int base);
+
+// Measure TSC cycles across CLOCK_CALIBRATE_MS of HPET counter
+static uint64_t clock_measure_window_hpet(void) {
+    uint64_t window = div_u64((uint64_t)hpet_frequency() * CLOCK_CALIBRATE_MS, 1000);
+
+    // Start on a counter edge
+    uint64_t edge = hpet_counter();
+    while (hpet_counter() == edge) {
+        // Wait for next tick
+    }
+
+    uint64_t start_count = hpet_counter();
+    uint64_t start = rdtsc();
+    uint64_t count;
+    while ((count = hpet_counter()) - start_count < window) {
+        // Wait for window to elapse
+    }
+    uint64_t cycles = rdtsc() - start;
+
+    // Scale to exactly one window (we may have overshot by a few ticks)
+    return div_u64(cycles * window, (uint32_t)(count - start_count));
+}
+
+// Measure TSC cycles across one PIT channel 2 countdown
+static uint64_t clock_measure_window(void) {
+    if (hpet_available()) {
+        return clock_measure_window_hpet();
+    }
+
+    uint32_t latch = PIT_BASE_FREQ / (1000 / CLOCK_CALIBRATE_MS);
+
+    // Gate high, speaker off
+    outb(PORT_B, (inb(PORT_B) & ~PORT_B_SPEAKER) | PORT_B_GATE2);
+
+    // Mode 0: OUT2 goes low on load and high at terminal count
+    outb(PIT_COMMAND, PIT_CMD_CH2_ONESHOT);
+    outb(PIT_CHANNEL2, latch & 0xFF);
+    outb(PIT_CHANNEL2, (latch >> 8) & 0xFF);
+
+    uint64_t start = rdtsc();
+    while (!(inb(PORT_B) & PORT_B_OUT2)) {
+        // Wait for terminal count
+    }
+    return rdtsc() - start;
+}
+
+// Detect and calibrate TSC
+bool clock_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    cpuid(0, &eax, &ebx, &ecx, &edx);
+    if (eax >= 1) {
+        cpuid(1, &eax, &ebx, &ecx, &edx);
+        tsc_enabled = (edx & CPUID_EDX_TSC) != 0;
+    }
+
+    if (!tsc_enabled) {
+        if (hpet_available()) {
+            hpet_base_count = hpet_counter();
+            print_string("Clock: No TSC, using HPET\n");
+        } else {
+            print_string("Clock: No TSC, using timer ticks\n");
+        }
+        return false;
+    }
+
+    cpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+    if (eax >= 0x80000007) {
+        cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+        tsc_invariant = (edx & CPUID_EDX_INVARIANT_TSC) != 0;
+    }
+
+    // Take the shortest window: longer ones were disturbed (SMI, VM exit)
+    uint64_t best = ~0ULL;
+    for (int i = 0; i < CLOCK_CALIBRATE_RUNS; i++) {
+        uint64_t cycles = clock_measure_window();
+        if (cycles < best) {
+            best = cycles;
+        }
+    }
+
+    tsc_khz = (uint32_t)div_u64(best, CLOCK_CALIBRATE_MS);
+    if (tsc_khz == 0) {
+        tsc_enabled = false;
+        print_string("Clock: TSC calibration failed, using timer ticks\n");
+        return false;
+    }
+
+    tsc_mult = (uint32_t)div_u64((uint64_t)NSEC_PER_MSEC << CLOCK_SHIFT, tsc_khz);
+    tsc_base = rdtsc();
+
+    char num[16];
+    print_string("Clock: TSC at ");
+    print_string(utoa(tsc_khz / 1000, num, 10));
+    print_string(" MHz");
+    print_string(hpet_available() ? ", HPET-calibrated" : ", PIT-calibrated");
+    print_string(tsc_invariant ? " (invariant)\n" : "\n");
+
+    return true;
+}
+
+// Convert TSC cycles to nanoseconds
+uint64_t clock_cycles_to_ns(uint64_t cycles) {
+    uint32_t high = (uint32_t)(cycles >> 32);
+    uint32_t low = (uint32_t)cycles;
+
+    // Split to keep the 32x32 products within 64 bits
+    return (((uint64_t)low * tsc_mult) >> CLOCK_SHIFT) +
+           (((uint64_t)high * tsc_mult) << (32 - CLOCK_SHIFT));
+}
+
+// Nanoseconds since clock_init()
+uint64_t clock_ns(void) {
+    if (!tsc_enabled) {
+        if (hpet_available()) {
+            return hpet_ticks_to_ns(hpet_counter() - hpet_base_count);
+        }
+        return (uint64_t)timer_get_ticks() * (NSEC_PER_SEC / timer_get_frequency());
+    }
+    return clock_cycles_to_ns(rdtsc() - tsc_base);
+}
+
+// Microseconds since clock_init()
+uint64_t clock_us(void) {
+    return div_u64(clock_ns(), NSEC_PER_USEC);
+}
+
+// Milliseconds since clock_init()
+uint64_t clock_ms(void) {
+    return div_u64(clock_ns(), NSEC_PER_MSEC);
+}
+
+// Get calibrated TSC frequency
+uint32_t clock_tsc_khz(void) {
+    return tsc_enabled ? tsc_khz : 0;
+}
+
+// Check for invariant TSC
+bool clock_tsc_invariant(void) {
+    return tsc_invariant;
+}
+
+// Check if clock_ns() is finer than the timer tick
+bool clock_highres(void) {
+    return tsc_enabled || hpet_available();
+}
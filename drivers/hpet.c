@@ -0,0 +1,171 @@
+/**************************************************************
+ * HPET Driver - BloodG OS
+ * Main counter as clock reference, timer 0 as IRQ0 event source
+ **************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "acpi.h"
+#include "hpet.h"
+#include "clock.h"
+#include "math64.h"
+
+#pragma pack(push, 1)
+
+// ACPI "HPET" table
+struct acpi_hpet {
+    acpi_sdt_header_t header;
+    uint32_t event_timer_block_id;
+    uint8_t  address_space;         // 0 = system memory
+    uint8_t  register_bit_width;
+    uint8_t  register_bit_offset;
+    uint8_t  reserved;
+    uint64_t address;
+    uint8_t  hpet_number;
+    uint16_t minimum_tick;
+    uint8_t  page_protection;
+};
+
+#pragma pack(pop)
+
+#define HPET_MAX_PERIOD_FS      100000000U  // Spec limit (10 MHz minimum)
+#define HPET_MIN_DELTA_TICKS    64          // Smallest comparator lead
+
+// HPET state
+static volatile uint32_t* hpet_base = NULL;
+static uint32_t hpet_freq = 0;
+static bool event_capable = false;
+
+void print_string(const char* str);
+char* utoa(uint32_t value, char* str, int base);
+
+// Read 32-bit HPET register
+static uint32_t hpet_read(uint32_t reg) {
+    return hpet_base[reg / 4];
+}
+
+// Write 32-bit HPET register
+static void hpet_write(uint32_t reg, uint32_t value) {
+    hpet_base[reg / 4] = value;
+}
+
+// Convert nanoseconds to counter ticks
+static uint64_t hpet_ns_to_ticks(uint64_t ns) {
+    return div_u64(ns * hpet_freq, NSEC_PER_SEC);
+}
+
+// Find and start HPET
+bool hpet_init(void) {
+    const struct acpi_hpet* table = (const struct acpi_hpet*)acpi_find_table("HPET");
+    if (!table || table->address_space != 0 || (table->address >> 32)) {
+        return false;
+    }
+
+    hpet_base = (volatile uint32_t*)(uint32_t)table->address;
+
+    uint32_t caps = hpet_read(HPET_REG_CAPS);
+    uint32_t period_fs = hpet_read(HPET_REG_CAPS + 4);
+
+    // A 32-bit main counter would wrap every few minutes
+    if (period_fs == 0 || period_fs > HPET_MAX_PERIOD_FS || !(caps & HPET_CAP_COUNT_64)) {
+        hpet_base = NULL;
+        return false;
+    }
+
+    hpet_freq = (uint32_t)div_u64(1000000000000000ULL, period_fs);
+
+    uint32_t timer0 = hpet_read(HPET_REG_TIMER_CONFIG(0));
+    event_capable = (caps & HPET_CAP_LEGACY_ROUTE) && (timer0 & HPET_TN_PERIODIC_CAP);
+
+    // Timer 0 quiet until someone asks for events
+    hpet_write(HPET_REG_TIMER_CONFIG(0), timer0 & ~(HPET_TN_INT_ENABLE | HPET_TN_PERIODIC));
+
+    // Start counter (leave legacy routing to hpet_event_enable)
+    uint32_t config = hpet_read(HPET_REG_CONFIG) & ~HPET_CFG_LEGACY;
+    hpet_write(HPET_REG_CONFIG, config | HPET_CFG_ENABLE);
+
+    char num[16];
+    print_string("HPET: ");
+    print_string(utoa(hpet_freq / 1000, num, 10));
+    print_string(" kHz, ");
+    print_string(utoa(((caps >> 8) & 0x1F) + 1, num, 10));
+    print_string(" timers\n");
+
+    return true;
+}
+
+// Check if HPET is running
+bool hpet_available(void) {
+    return hpet_base != NULL;
+}
+
+// Read 64-bit main counter (high half may tick between the two reads)
+uint64_t hpet_counter(void) {
+    uint32_t high, low;
+
+    do {
+        high = hpet_read(HPET_REG_COUNTER + 4);
+        low = hpet_read(HPET_REG_COUNTER);
+    } while (high != hpet_read(HPET_REG_COUNTER + 4));
+
+    return ((uint64_t)high << 32) | low;
+}
+
+// Get counter frequency
+uint32_t hpet_frequency(void) {
+    return hpet_freq;
+}
+
+// Convert counter ticks to nanoseconds
+uint64_t hpet_ticks_to_ns(uint64_t count) {
+    uint32_t rem;
+    uint64_t seconds = div_u64_rem(count, hpet_freq, &rem);
+    return seconds * NSEC_PER_SEC + div_u64((uint64_t)rem * NSEC_PER_SEC, hpet_freq);
+}
+
+// Check if timer 0 can replace the PIT
+bool hpet_event_available(void) {
+    return hpet_base != NULL && event_capable;
+}
+
+// Route timer 0 to IRQ0
+void hpet_event_enable(void) {
+    hpet_write(HPET_REG_CONFIG, hpet_read(HPET_REG_CONFIG) | HPET_CFG_LEGACY);
+}
+
+// Program timer 0 periodic
+void hpet_event_periodic(uint64_t period_ns) {
+    uint32_t period = (uint32_t)hpet_ns_to_ticks(period_ns);
+    if (period < HPET_MIN_DELTA_TICKS) period = HPET_MIN_DELTA_TICKS;
+
+    uint32_t config = hpet_read(HPET_REG_TIMER_CONFIG(0));
+    config |= HPET_TN_INT_ENABLE | HPET_TN_PERIODIC | HPET_TN_VAL_SET | HPET_TN_32BIT;
+    hpet_write(HPET_REG_TIMER_CONFIG(0), config);
+
+    // With VAL_SET the first write sets the comparator, the second the period
+    hpet_write(HPET_REG_TIMER_CMP(0), (uint32_t)hpet_counter() + period);
+    hpet_write(HPET_REG_TIMER_CMP(0), period);
+}
+
+// Program timer 0 one-shot
+void hpet_event_oneshot(uint64_t delta_ns) {
+    if (delta_ns > HPET_ONESHOT_MAX_NS) {
+        delta_ns = HPET_ONESHOT_MAX_NS;
+    }
+
+    uint32_t delta = (uint32_t)hpet_ns_to_ticks(delta_ns);
+    if (delta < HPET_MIN_DELTA_TICKS) delta = HPET_MIN_DELTA_TICKS;
+
+    uint32_t config = hpet_read(HPET_REG_TIMER_CONFIG(0)) & ~HPET_TN_PERIODIC;
+    hpet_write(HPET_REG_TIMER_CONFIG(0), config | HPET_TN_INT_ENABLE | HPET_TN_32BIT);
+
+    // Comparator only matches on equality: if the counter already passed
+    // it we would wait a full 32-bit wrap, so retry with a bigger lead
+    uint32_t compare;
+    do {
+        compare = (uint32_t)hpet_counter() + delta;
+        hpet_write(HPET_REG_TIMER_CMP(0), compare);
+        delta *= 2;
+    } while ((int32_t)(compare - (uint32_t)hpet_counter()) <= 0);
+}
@@ -7,6 +7,8 @@
 #include <stdbool.h>
 #include "io.h"
 #include "string.h"
+#include "idt.h"
+#include "sync.h"
 
 // Keyboard ports
 #define KEYBOARD_DATA   0x60
@@ -53,6 +55,15 @@ static struct {
     bool scroll_lock;
 } keyboard_state = {0};
 
+// Translated characters (filled by IRQ1, drained by keyboard_getchar)
+#define KEYBOARD_BUFFER_SIZE 64
+static volatile char key_buffer[KEYBOARD_BUFFER_SIZE];
+static volatile uint32_t key_head = 0;
+static volatile uint32_t key_tail = 0;
+static struct wait_queue key_wait = WAIT_QUEUE_INIT;
+
+static void keyboard_irq(struct interrupt_frame* frame);
+
 // Scancode translation tables
 static const char scancode_normal[] = {
     0,   0x1B, '1', '2', '3', '4', '5', '6', '7', '8', '9', '0', '-', '=', '\b',
@@ -142,6 +153,10 @@ bool keyboard_init(void) {
         return false;
     }
     
+    // Keys arrive through IRQ1 from here on
+    key_head = key_tail = 0;
+    irq_register_handler(IRQ_KEYBOARD, keyboard_irq);
+    
     print_string("Keyboard: Initialized successfully\n");
     return true;
 }
@@ -220,26 +235,48 @@ static char keyboard_handle_scancode(uint8_t scancode) {
     return key;
 }
 
+// IRQ1: translate and queue key, wake readers
+static void keyboard_irq(struct interrupt_frame* frame) {
+    (void)frame;
+    
+    char key = keyboard_handle_scancode(inb(KEYBOARD_DATA));
+    if (!key) {
+        return;  // Modifier or release
+    }
+    
+    // Drop key if buffer is full
+    uint32_t next = (key_head + 1) % KEYBOARD_BUFFER_SIZE;
+    if (next != key_tail) {
+        key_buffer[key_head] = key;
+        key_head = next;
+    }
+    
+    wait_queue_wake_all(&key_wait);
+}
+
 // Get keyboard status
 bool keyboard_has_data(void) {
-    return (inb(KEYBOARD_STATUS) & KEYBOARD_STATUS_OUTPUT_FULL) != 0;
+    return key_head != key_tail;
 }
 
 // Read character from keyboard (non-blocking)
 char keyboard_read_char(void) {
-    if (!keyboard_has_data()) {
-        return 0;
+    uint32_t flags = irq_save();
+    char key = 0;
+    
+    if (key_head != key_tail) {
+        key = key_buffer[key_tail];
+        key_tail = (key_tail + 1) % KEYBOARD_BUFFER_SIZE;
     }
     
-    uint8_t scancode = inb(KEYBOARD_DATA);
-    return keyboard_handle_scancode(scancode);
+    irq_restore(flags);
+    return key;
 }
 
 // Read character from keyboard (blocking)
 char keyboard_getchar(void) {
-    while (!keyboard_has_data()) {
-        // Wait for key press
-    }
+    // Sleep until keyboard_irq queues a key
+    wait_event(&key_wait, key_head != key_tail);
     return keyboard_read_char();
 }
 
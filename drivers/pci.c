@@ -0,0 +1,138 @@
+/**************************************************************
+ * PCI Driver - BloodG OS
+ * Configuration mechanism #1 and brute-force bus scan
+ **************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "io.h"
+#include "spinlock.h"
+#include "pci.h"
+
+#define PCI_MAX_BUS     256
+#define PCI_MAX_SLOT    32
+#define PCI_MAX_FUNC    8
+
+// Address/data port pair must be used as one unit
+static spinlock_t pci_lock = SPINLOCK_INIT("pci");
+
+// Build CONFIG_ADDRESS value
+static uint32_t pci_address(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    return (1u << 31) |
+           ((uint32_t)bus << 16) |
+           ((uint32_t)(slot & 0x1F) << 11) |
+           ((uint32_t)(func & 0x07) << 8) |
+           (offset & 0xFC);
+}
+
+// Raw dword read by location
+static uint32_t pci_read(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    uint32_t flags = spin_lock_irqsave(&pci_lock);
+    outl(PCI_CONFIG_ADDRESS, pci_address(bus, slot, func, offset));
+    uint32_t value = inl(PCI_CONFIG_DATA);
+    spin_unlock_irqrestore(&pci_lock, flags);
+    return value;
+}
+
+// Read 32-bit register
+uint32_t pci_config_read32(const struct pci_device* dev, uint8_t offset) {
+    return pci_read(dev->bus, dev->slot, dev->func, offset);
+}
+
+// Read 16-bit register
+uint16_t pci_config_read16(const struct pci_device* dev, uint8_t offset) {
+    return (uint16_t)(pci_config_read32(dev, offset) >> ((offset & 2) * 8));
+}
+
+// Read 8-bit register
+uint8_t pci_config_read8(const struct pci_device* dev, uint8_t offset) {
+    return (uint8_t)(pci_config_read32(dev, offset) >> ((offset & 3) * 8));
+}
+
+// Write 32-bit register
+void pci_config_write32(const struct pci_device* dev, uint8_t offset, uint32_t value) {
+    uint32_t flags = spin_lock_irqsave(&pci_lock);
+    outl(PCI_CONFIG_ADDRESS, pci_address(dev->bus, dev->slot, dev->func, offset));
+    outl(PCI_CONFIG_DATA, value);
+    spin_unlock_irqrestore(&pci_lock, flags);
+}
+
+// Write 16-bit register (a word access, so the other half of the dword is
+// untouched: rewriting PCI_STATUS would clear its write-1-to-clear bits)
+void pci_config_write16(const struct pci_device* dev, uint8_t offset, uint16_t value) {
+    uint32_t flags = spin_lock_irqsave(&pci_lock);
+    outl(PCI_CONFIG_ADDRESS, pci_address(dev->bus, dev->slot, dev->func, offset));
+    outw(PCI_CONFIG_DATA + (offset & 2), value);
+    spin_unlock_irqrestore(&pci_lock, flags);
+}
+
+// Scan every bus/slot/function for a match
+static bool pci_find(bool (*match)(uint32_t id, uint32_t class_reg, uint32_t a, uint32_t b),
+                     uint32_t a, uint32_t b, uint32_t index, struct pci_device* dev) {
+    for (uint32_t bus = 0; bus < PCI_MAX_BUS; bus++) {
+        for (uint32_t slot = 0; slot < PCI_MAX_SLOT; slot++) {
+            uint32_t funcs = 1;
+
+            for (uint32_t func = 0; func < funcs; func++) {
+                uint32_t id = pci_read(bus, slot, func, PCI_VENDOR_ID);
+                if ((id & 0xFFFF) == PCI_VENDOR_NONE) {
+                    continue;
+                }
+
+                // Only multi-function devices have functions 1-7
+                if (func == 0 &&
+                    (pci_read(bus, slot, 0, PCI_HEADER_TYPE) >> 16) & PCI_HEADER_MULTIFUNC) {
+                    funcs = PCI_MAX_FUNC;
+                }
+
+                uint32_t class_reg = pci_read(bus, slot, func, 0x08);
+                if (!match(id, class_reg, a, b)) {
+                    continue;
+                }
+                if (index-- > 0) {
+                    continue;
+                }
+
+                dev->bus = bus;
+                dev->slot = slot;
+                dev->func = func;
+                dev->vendor = id & 0xFFFF;
+                dev->device = id >> 16;
+                dev->class_code = class_reg >> 24;
+                dev->subclass = (class_reg >> 16) & 0xFF;
+                dev->prog_if = (class_reg >> 8) & 0xFF;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Class and subclass match
+static bool pci_match_class(uint32_t id, uint32_t class_reg, uint32_t class_code, uint32_t subclass) {
+    (void)id;
+    return (class_reg >> 24) == class_code && ((class_reg >> 16) & 0xFF) == subclass;
+}
+
+// Vendor and device ID match
+static bool pci_match_id(uint32_t id, uint32_t class_reg, uint32_t vendor, uint32_t device) {
+    (void)class_reg;
+    return (id & 0xFFFF) == vendor && (id >> 16) == device;
+}
+
+// Find function by class
+bool pci_find_class(uint8_t class_code, uint8_t subclass, uint32_t index, struct pci_device* dev) {
+    return pci_find(pci_match_class, class_code, subclass, index, dev);
+}
+
+// Find function by vendor/device ID
+bool pci_find_device(uint16_t vendor, uint16_t device, uint32_t index, struct pci_device* dev) {
+    return pci_find(pci_match_id, vendor, device, index, dev);
+}
+
+// Enable decoding/bus mastering
+void pci_enable(const struct pci_device* dev, uint16_t bits) {
+    uint16_t command = pci_config_read16(dev, PCI_COMMAND);
+    pci_config_write16(dev, PCI_COMMAND, command | bits);
+}
@@ -4,7 +4,9 @@
  **************************************************************/
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "io.h"
+#include "pic.h"
 
 // PIC ports
 #define PIC1_COMMAND    0x20
@@ -29,9 +31,9 @@
 #define PIC_ICW4_BUF_MASTER 0x0C  // Buffered mode/master
 #define PIC_ICW4_SFNM       0x10  // Special fully nested mode
 
-// Remap PIC interrupts to avoid conflicts with CPU exceptions
-#define PIC1_OFFSET         0x20  // IRQ 0-7 -> INT 0x20-0x27
-#define PIC2_OFFSET         0x28  // IRQ 8-15 -> INT 0x28-0x2F
+// Edge/level control registers (PIIX/ICH, one bit per IRQ)
+#define PIC1_ELCR           0x4D0
+#define PIC2_ELCR           0x4D1
 
 // Initialize PIC with custom offsets
 void pic_init(void) {
@@ -120,6 +122,20 @@ void pic_disable_irq(uint8_t irq) {
     outb(port, value);
 }
 
+// Switch IRQ to level-triggered (shared PCI lines)
+void pic_set_level(uint8_t irq) {
+    uint16_t port;
+    
+    if (irq < 8) {
+        port = PIC1_ELCR;
+    } else {
+        port = PIC2_ELCR;
+        irq -= 8;
+    }
+    
+    outb(port, inb(port) | (1 << irq));
+}
+
 // Get IRR (Interrupt Request Register)
 uint16_t pic_get_irr(void) {
     outb(PIC1_COMMAND, 0x0A);  // Command: read IRR
@@ -142,6 +158,14 @@ uint16_t pic_get_isr(void) {
     return (isr2 << 8) | isr1;
 }
 
+// Check for spurious IRQ7/IRQ15 (raised but not in service)
+bool pic_is_spurious(uint8_t irq) {
+    if (irq != 7 && irq != 15) {
+        return false;
+    }
+    return !(pic_get_isr() & (1 << irq));
+}
+
 // Mask all interrupts except cascade
 void pic_mask_all(void) {
     outb(PIC1_DATA, 0xFF & ~(1 << 2));  // Keep IRQ2 (cascade) enabled
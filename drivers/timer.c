@@ -1,10 +1,22 @@
 /**************************************************************
  * PIT Timer Driver - BloodG OS
- * Provides timing and scheduling functions
+ * Provides timing and scheduling functions (PIT or HPET event source)
  **************************************************************/
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include "io.h"
+#include "idt.h"
+#include "apic.h"
+#include "hpet.h"
+#include "timer.h"
+#include "idle.h"
+#include "clock.h"
+#include "math64.h"
+#include "sync.h"
+#include "thread.h"
+#include "spinlock.h"
 
 // PIT ports
 #define PIT_CHANNEL0    0x40
@@ -37,17 +49,47 @@
 #define PIT_BASE_FREQ       1193182
 #define PIT_DEFAULT_HZ      1000  // 1ms ticks
 
-// Timer state
-static volatile uint32_t timer_ticks = 0;
+// Longest one-shot the 16-bit PIT counter can do (~54.9ms)
+#define PIT_ONESHOT_MAX_NS  (0xFFFFULL * NSEC_PER_SEC / PIT_BASE_FREQ)
+
+// Timer state (ticks and frequency change together under tick_lock)
+static uint64_t timer_ticks = 0;
 static uint32_t timer_frequency = PIT_DEFAULT_HZ;
+static seqlock_t tick_lock = SEQLOCK_INIT("ticks");
+static volatile bool tickless = false;
+static bool use_hpet = false;              // HPET timer 0 drives IRQ0
+static uint64_t oneshot_deadline_ns = 0;   // When the armed one-shot fires
 
-// Initialize PIT
-void timer_init(uint32_t frequency) {
-    if (frequency < 19) frequency = 19;    // Minimum frequency
-    if (frequency > PIT_BASE_FREQ) frequency = PIT_BASE_FREQ;
+// Consistent tick count and rate, without locking out the writer
+static uint64_t timer_read_ticks(uint32_t* frequency) {
+    uint64_t ticks;
+    uint32_t sequence;
     
-    timer_frequency = frequency;
+    do {
+        sequence = read_seqbegin(&tick_lock);
+        ticks = timer_ticks;
+        *frequency = timer_frequency;
+    } while (read_seqretry(&tick_lock, sequence));
     
+    return ticks;
+}
+
+// Publish new tick state (interrupts off, so no reader can spin on us)
+static void timer_write_ticks(uint64_t ticks, uint32_t frequency) {
+    write_seqlock(&tick_lock);
+    timer_ticks = ticks;
+    timer_frequency = frequency;
+    write_sequnlock(&tick_lock);
+}
+
+// IRQ0 entry
+static void timer_irq(struct interrupt_frame* frame) {
+    (void)frame;
+    timer_handler();
+}
+
+// Program channel 0 as periodic square wave
+static void pit_program_periodic(uint32_t frequency) {
     // Calculate divisor
     uint16_t divisor = PIT_BASE_FREQ / frequency;
     
@@ -61,75 +103,271 @@ void timer_init(uint32_t frequency) {
     // Send divisor (low then high byte)
     outb(PIT_CHANNEL0, divisor & 0xFF);
     outb(PIT_CHANNEL0, (divisor >> 8) & 0xFF);
+}
+
+// Program channel 0 to fire once after delta_ns
+static void pit_program_oneshot(uint64_t delta_ns) {
+    if (delta_ns > PIT_ONESHOT_MAX_NS) {
+        delta_ns = PIT_ONESHOT_MAX_NS;
+    }
     
-    // Reset tick counter
-    timer_ticks = 0;
+    uint32_t count = (uint32_t)div_u64(delta_ns * PIT_BASE_FREQ, NSEC_PER_SEC);
+    if (count < 1) count = 1;
+    if (count > 0xFFFF) count = 0xFFFF;
+    
+    // Mode 0: interrupt on terminal count, then stop
+    outb(PIT_COMMAND, 
+         PIT_CMD_CHANNEL0 | 
+         PIT_CMD_LOHIBYTE | 
+         PIT_CMD_MODE0 | 
+         PIT_CMD_BINARY);
+    
+    outb(PIT_CHANNEL0, count & 0xFF);
+    outb(PIT_CHANNEL0, (count >> 8) & 0xFF);
+}
+
+// Program IRQ0 source for periodic ticks
+static void timer_program_periodic(void) {
+    if (use_hpet) {
+        hpet_event_periodic(NSEC_PER_SEC / timer_frequency);
+    } else {
+        pit_program_periodic(timer_frequency);
+    }
+}
+
+// Longest one-shot the active event source can do
+static uint64_t timer_oneshot_max_ns(void) {
+    if (lapic_timer_available()) {
+        return LAPIC_TIMER_MAX_NS;
+    }
+    return use_hpet ? HPET_ONESHOT_MAX_NS : PIT_ONESHOT_MAX_NS;
+}
+
+// Arm the one-shot for the next timer wheel expiry
+static void timer_program_next(void) {
+    uint64_t max_ns = timer_oneshot_max_ns();
+    uint64_t now = clock_ns();
+    uint64_t next = timer_wheel_next_expiry();
+    uint64_t delta_ns = max_ns;
+    
+    if (next != TIMER_NO_EXPIRY) {
+        delta_ns = next > now ? next - now : 0;
+    }
+    if (delta_ns > max_ns) {
+        delta_ns = max_ns;
+    }
+    
+    oneshot_deadline_ns = now + delta_ns;
+    if (lapic_timer_available()) {
+        lapic_timer_oneshot(delta_ns);
+    } else if (use_hpet) {
+        hpet_event_oneshot(delta_ns);
+    } else {
+        pit_program_oneshot(delta_ns);
+    }
+}
+
+// Initialize PIT
+void timer_init(uint32_t frequency) {
+    if (frequency < 19) frequency = 19;    // Minimum frequency
+    if (frequency > PIT_BASE_FREQ) frequency = PIT_BASE_FREQ;
+    
+    // Reset tick counter at the new rate (interrupts are still off)
+    timer_write_ticks(0, frequency);
+    
+    // HPET timer 0 takes over IRQ0 from PIT channel 0 when it can
+    if (hpet_event_available()) {
+        hpet_event_enable();
+        use_hpet = true;
+    }
+    timer_program_periodic();
+    timer_wheel_init(clock_ns());
+    
+    // Hook IRQ0
+    irq_register_handler(IRQ_TIMER, timer_irq);
     
     // Print initialization message
     char freq_str[16];
     utoa(frequency, freq_str, 10);
     print_string("Timer: Initialized at ");
     print_string(freq_str);
-    print_string(" Hz\n");
+    print_string(use_hpet ? " Hz (HPET)\n" : " Hz (PIT)\n");
 }
 
 // Timer interrupt handler (called from ISR)
 void timer_handler(void) {
-    timer_ticks++;
+    if (tickless) {
+        timer_wheel_run(clock_ns());
+        timer_program_next();
+        return;
+    }
+    
+    timer_write_ticks(timer_ticks + 1, timer_frequency);
+    if (timer_pending()) {
+        timer_wheel_run(clock_ns());
+    }
 }
 
-// Get current tick count
-uint32_t timer_get_ticks(void) {
-    return timer_ticks;
+// Wait for the next tick (halt if interrupts are on)
+static inline void timer_wait_tick(void) {
+    if (read_eflags() & EFLAGS_IF) {
+        halt();
+    } else {
+        asm volatile ("pause");
+    }
+}
+
+// A timer was queued: pull the one-shot in if it would fire too late
+void timer_clockevent_update(uint64_t expires_ns) {
+    if (tickless && expires_ns < oneshot_deadline_ns) {
+        timer_program_next();
+    }
+}
+
+// Switch between periodic ticks and one-shot (tickless) mode
+bool timer_set_tickless(bool enable) {
+    // Timekeeping must come from the TSC/HPET once ticks stop
+    if (enable && !clock_highres()) {
+        return false;
+    }
+    
+    uint32_t flags = irq_save();
+    
+    if (enable && !tickless) {
+        tickless = true;
+        if (lapic_timer_available()) {
+            irq_disable(IRQ_TIMER);     // PIT no longer needed
+        }
+        timer_program_next();
+    } else if (!enable && tickless) {
+        // Resume tick count where the clock says it should be
+        timer_write_ticks(div_u64(clock_ns(), NSEC_PER_SEC / timer_frequency), timer_frequency);
+        tickless = false;
+        if (lapic_timer_available()) {
+            lapic_timer_stop();
+            irq_enable(IRQ_TIMER);
+        }
+        timer_program_periodic();
+    }
+    
+    irq_restore(flags);
+    return true;
+}
+
+// Check if tickless mode is active
+bool timer_is_tickless(void) {
+    return tickless;
+}
+
+// Tick count and the rate it was counted at, as one snapshot
+static uint64_t timer_snapshot(uint32_t* frequency) {
+    uint64_t ticks = timer_read_ticks(frequency);
+    
+    if (tickless) {
+        return div_u64(clock_ns(), NSEC_PER_SEC / *frequency);
+    }
+    return ticks;
+}
+
+// Get current tick count (derived from clock_ns when tickless)
+uint64_t timer_get_ticks(void) {
+    uint32_t frequency;
+    return timer_snapshot(&frequency);
 }
 
 // Get timer frequency
 uint32_t timer_get_frequency(void) {
-    return timer_frequency;
+    uint32_t frequency;
+    timer_read_ticks(&frequency);
+    return frequency;
 }
 
-// Calculate milliseconds from ticks
-uint32_t timer_ticks_to_ms(uint32_t ticks) {
-    return (ticks * 1000) / timer_frequency;
+// Calculate milliseconds from ticks (64-bit intermediate, no overflow)
+uint64_t timer_ticks_to_ms(uint64_t ticks) {
+    return div_u64(ticks * 1000, timer_get_frequency());
 }
 
-// Calculate microseconds from ticks
-uint32_t timer_ticks_to_us(uint32_t ticks) {
-    return (ticks * 1000000) / timer_frequency;
+// Calculate microseconds from ticks (64-bit intermediate, no overflow)
+uint64_t timer_ticks_to_us(uint64_t ticks) {
+    return div_u64(ticks * 1000000, timer_get_frequency());
 }
 
-// Sleep for specified milliseconds (busy wait)
-void timer_sleep_ms(uint32_t milliseconds) {
-    uint32_t start_ticks = timer_ticks;
-    uint32_t target_ticks = start_ticks + 
-                           (milliseconds * timer_frequency / 1000);
+// Sleep wakeup event (the interrupt itself ends the hlt)
+static void timer_sleep_wakeup(void* arg) {
+    (void)arg;
+}
+
+// Blocking sleep expired: release the sleeper
+static void timer_sleep_complete(void* arg) {
+    complete((struct completion*)arg);
+}
+
+// Sleep for specified nanoseconds
+static void timer_sleep_ns(uint64_t nanoseconds) {
+    // No TSC/HPET: count periodic ticks
+    if (!clock_highres()) {
+        uint32_t frequency;
+        uint64_t start_ticks = timer_read_ticks(&frequency);
+        uint64_t target_ticks = start_ticks + 
+                               div_u64(nanoseconds * frequency, NSEC_PER_SEC);
+        
+        while (timer_get_ticks() < target_ticks) {
+            timer_wait_tick();
+        }
+        return;
+    }
     
-    while (timer_ticks < target_ticks) {
-        // Busy wait - could be improved with interrupts
-        asm volatile ("pause");
+    uint64_t deadline = clock_ns() + nanoseconds;
+    
+    // Threads give the CPU away for anything longer than a wheel jiffy
+    if (thread_current() && nanoseconds >= (1ULL << TIMER_WHEEL_SHIFT)) {
+        struct completion done;
+        completion_init(&done);
+        
+        if (timer_add(nanoseconds, timer_sleep_complete, &done) >= 0) {
+            wait_for_completion(&done);
+        }
+        // Spin out whatever jiffy rounding left (or all of it if the pool is full)
+    }
+    
+    // No periodic tick to wake us - queue one at the deadline, if not past
+    uint64_t now = clock_ns();
+    if (now >= deadline) {
+        return;
+    }
+    int wakeup = tickless ? timer_add(deadline - now, timer_sleep_wakeup, NULL) : -1;
+    
+    while (clock_ns() < deadline) {
+        timer_wait_tick();
+    }
+    
+    if (wakeup >= 0) {
+        timer_cancel(wakeup);
     }
 }
 
-// Sleep for specified microseconds (busy wait)
+// Sleep for specified milliseconds
+void timer_sleep_ms(uint32_t milliseconds) {
+    timer_sleep_ns((uint64_t)milliseconds * NSEC_PER_MSEC);
+}
+
+// Sleep for specified microseconds
 void timer_sleep_us(uint32_t microseconds) {
-    uint32_t start_ticks = timer_ticks;
-    uint32_t target_ticks = start_ticks + 
-                           (microseconds * timer_frequency / 1000000);
-    
-    while (timer_ticks < target_ticks) {
-        asm volatile ("pause");
-    }
+    timer_sleep_ns((uint64_t)microseconds * NSEC_PER_USEC);
 }
 
 // Get current time in milliseconds
-uint32_t timer_get_ms(void) {
-    return timer_ticks_to_ms(timer_ticks);
+uint64_t timer_get_ms(void) {
+    uint32_t frequency;
+    uint64_t ticks = timer_snapshot(&frequency);
+    return div_u64(ticks * 1000, frequency);
 }
 
 // Get current time in microseconds
 uint64_t timer_get_us(void) {
-    uint64_t ticks = timer_ticks;
-    return (ticks * 1000000) / timer_frequency;
+    uint32_t frequency;
+    uint64_t ticks = timer_snapshot(&frequency);
+    return div_u64(ticks * 1000000, frequency);
 }
 
 // Simple delay using port I/O (alternative to timer)
@@ -139,9 +377,33 @@ void delay_io(uint32_t count) {
     }
 }
 
-// Calibrate timer (measure actual frequency)
+// Calibrate timer (measure actual IRQ0 rate against clock_ns)
 uint32_t timer_calibrate(void) {
-    // This would require a reference clock
-    // For now, just return configured frequency
-    return timer_frequency;
+    // Needs running periodic ticks and a TSC reference
+    if (tickless || !(read_eflags() & EFLAGS_IF) || !clock_highres()) {
+        return timer_get_frequency();
+    }
+    
+    uint32_t window = timer_get_frequency() / 10 + 1;  // ~100ms worth of ticks
+    
+    // Align to a tick edge
+    uint64_t start_ticks = timer_get_ticks();
+    while (timer_get_ticks() == start_ticks) {
+        timer_wait_tick();
+    }
+    
+    start_ticks = timer_get_ticks();
+    uint64_t start_ns = clock_ns();
+    uint64_t end_ticks;
+    while ((end_ticks = timer_get_ticks()) - start_ticks < window) {
+        timer_wait_tick();
+    }
+    uint64_t elapsed_ns = clock_ns() - start_ns;
+    
+    uint32_t elapsed_us = (uint32_t)div_u64(elapsed_ns, 1000);
+    if (elapsed_us == 0) {
+        return timer_get_frequency();
+    }
+    
+    return (uint32_t)div_u64((end_ticks - start_ticks) * 1000000, elapsed_us);
 }
@@ -0,0 +1,410 @@
+/**************************************************************
+ * Virtio Block Driver - BloodG OS
+ * Legacy virtio-pci disk with one split virtqueue, event index
+ * notification suppression and interrupt-driven completion
+ **************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "io.h"
+#include "string.h"
+#include "page.h"
+#include "pci.h"
+#include "idt.h"
+#include "sync.h"
+#include "spinlock.h"
+#include "workqueue.h"
+#include "block.h"
+#include "virtio_blk.h"
+
+#define VIRTIO_BLK_MAX_DISKS    4
+
+// One virtio-blk device (request queue 0 only)
+struct virtio_blk {
+    struct block_device block;          // vdN
+    uint16_t io;                        // BAR0
+    uint8_t irq;
+    uint32_t features;                  // Negotiated
+    uint64_t sectors;
+
+    // Virtqueue (identity mapped, so addresses are guest-physical)
+    uint16_t size;                      // Descriptors
+    struct vring_desc* desc;
+    struct vring_avail* avail;
+    struct vring_used* used;
+    volatile uint16_t* used_event;      // Driver: interrupt me at this used index
+    volatile uint16_t* avail_event;     // Device: notify me at this avail index
+
+    // Per tag: descriptors 3*tag..3*tag+2, header and status byte
+    struct virtio_blk_header* headers;
+    volatile uint8_t* status;
+
+    spinlock_t lock;                    // Guards the rings and the masks below
+    uint16_t avail_idx;                 // Next avail slot
+    uint16_t kicked_idx;                // avail_idx at the last notification
+    uint16_t last_used;                 // Used entries consumed
+    uint32_t done;                      // Finished, not yet reported
+    uint32_t failed;                    // Subset of done that failed
+    struct work work;                   // Reports done tags in process context
+};
+
+static struct virtio_blk disks[VIRTIO_BLK_MAX_DISKS];
+static uint32_t disk_count = 0;
+static uint32_t hooked_irqs = 0;        // Lines our handler is chained on (it scans every disk)
+
+// Notification counters
+static volatile uint32_t stat_submitted = 0;
+static volatile uint32_t stat_kicks = 0;
+static volatile uint32_t stat_interrupts = 0;
+
+// Guards initialization
+static struct mutex virtio_lock = MUTEX_INIT;
+
+void print_string(const char* str);
+
+// Has the other side asked to be told once idx moves from old to new?
+static inline bool vring_need_event(uint16_t event, uint16_t new_idx, uint16_t old_idx) {
+    return (uint16_t)(new_idx - event - 1) < (uint16_t)(new_idx - old_idx);
+}
+
+// Bytes needed for a legacy virtqueue of size entries
+static uint32_t vring_bytes(uint16_t size) {
+    uint32_t ring = 16 * size + 6 + 2 * size;   // desc + avail (with used_event)
+    uint32_t used = 6 + 8 * size;               // used (with avail_event)
+
+    ring = (ring + VIRTIO_QUEUE_ALIGN - 1) & ~(VIRTIO_QUEUE_ALIGN - 1);
+    return ring + ((used + VIRTIO_QUEUE_ALIGN - 1) & ~(VIRTIO_QUEUE_ALIGN - 1));
+}
+
+// Lay out and register queue 0
+static bool virtio_blk_setup_queue(struct virtio_blk* d) {
+    outw(d->io + VIRTIO_REG_QUEUE_SELECT, 0);
+    d->size = inw(d->io + VIRTIO_REG_QUEUE_SIZE);
+    if (d->size < VIRTIO_BLK_DESCS) {
+        return false;
+    }
+
+    uint32_t pages = vring_bytes(d->size) / PAGE_SIZE;
+    uint8_t* ring = (uint8_t*)page_alloc(pages);
+    if (!ring) {
+        return false;
+    }
+    memset(ring, 0, pages * PAGE_SIZE);
+
+    uint32_t used_offset = (16 * d->size + 6 + 2 * d->size + VIRTIO_QUEUE_ALIGN - 1) &
+                           ~(VIRTIO_QUEUE_ALIGN - 1);
+    d->desc = (struct vring_desc*)ring;
+    d->avail = (struct vring_avail*)(ring + 16 * d->size);
+    d->used = (struct vring_used*)(ring + used_offset);
+    d->used_event = &d->avail->ring[d->size];
+    d->avail_event = (volatile uint16_t*)&d->used->ring[d->size];
+
+    // Header and status for every tag in one page
+    uint8_t* requests = (uint8_t*)page_alloc(1);
+    if (!requests) {
+        page_free(ring, pages);
+        return false;
+    }
+    memset(requests, 0, PAGE_SIZE);
+    d->headers = (struct virtio_blk_header*)requests;
+    d->status = requests + BLOCK_MAX_TAGS * sizeof(struct virtio_blk_header);
+
+    d->avail_idx = 0;
+    d->kicked_idx = 0;
+    d->last_used = 0;
+    outl(d->io + VIRTIO_REG_QUEUE_PFN, (uint32_t)ring >> 12);
+    return true;
+}
+
+// Take the queue back from the device and free its pages
+static void virtio_blk_free_queue(struct virtio_blk* d) {
+    outl(d->io + VIRTIO_REG_QUEUE_PFN, 0);
+    page_free((void*)d->desc, vring_bytes(d->size) / PAGE_SIZE);
+    page_free(d->headers, 1);
+    d->desc = NULL;
+    d->headers = NULL;
+}
+
+// Make chain for tag available to the device (notification comes later)
+static void virtio_blk_queue(struct virtio_blk* d, uint32_t tag) {
+    uint32_t flags = spin_lock_irqsave(&d->lock);
+
+    d->avail->ring[d->avail_idx % d->size] = tag * VIRTIO_BLK_DESCS;
+    compiler_barrier();                 // Descriptors and ring entry before idx
+    d->avail->idx = ++d->avail_idx;
+    stat_submitted++;
+    spin_unlock_irqrestore(&d->lock, flags);
+}
+
+// Fill the descriptor chain for tag
+static void virtio_blk_build(struct virtio_blk* d, uint32_t tag, uint32_t type, uint64_t sector,
+                             uint8_t* buffer, uint32_t bytes) {
+    struct vring_desc* desc = &d->desc[tag * VIRTIO_BLK_DESCS];
+    struct virtio_blk_header* header = &d->headers[tag];
+
+    header->type = type;
+    header->reserved = 0;
+    header->sector = sector;
+    d->status[tag] = 0xFF;
+
+    // Header -> [data] -> status
+    desc[0].addr = (uint32_t)header;
+    desc[0].len = sizeof(*header);
+    desc[0].flags = VRING_DESC_F_NEXT;
+    desc[0].next = tag * VIRTIO_BLK_DESCS + (bytes ? 1 : 2);
+
+    desc[1].addr = (uint32_t)buffer;
+    desc[1].len = bytes;
+    desc[1].flags = VRING_DESC_F_NEXT | (type == VIRTIO_BLK_T_IN ? VRING_DESC_F_WRITE : 0);
+    desc[1].next = tag * VIRTIO_BLK_DESCS + 2;
+
+    desc[2].addr = (uint32_t)&d->status[tag];
+    desc[2].len = 1;
+    desc[2].flags = VRING_DESC_F_WRITE;
+    desc[2].next = 0;
+}
+
+// Start a block layer read/write
+static bool virtio_blk_submit(struct block_device* dev, uint32_t tag, uint64_t sector,
+                              uint32_t count, uint8_t* buffer, bool write) {
+    struct virtio_blk* d = (struct virtio_blk*)dev->private;
+
+    if (write && (d->features & VIRTIO_BLK_F_RO)) {
+        return false;
+    }
+    virtio_blk_build(d, tag, write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN, sector,
+                     buffer, count * BLOCK_SECTOR_SIZE);
+    virtio_blk_queue(d, tag);
+    return true;
+}
+
+// Start a cache flush
+static bool virtio_blk_flush(struct block_device* dev, uint32_t tag) {
+    struct virtio_blk* d = (struct virtio_blk*)dev->private;
+
+    virtio_blk_build(d, tag, VIRTIO_BLK_T_FLUSH, 0, NULL, 0);
+    virtio_blk_queue(d, tag);
+    return true;
+}
+
+// One notification for everything queued since the last one
+static void virtio_blk_kick(struct block_device* dev) {
+    struct virtio_blk* d = (struct virtio_blk*)dev->private;
+
+    uint32_t flags = spin_lock_irqsave(&d->lock);
+    uint16_t old_idx = d->kicked_idx;
+    uint16_t new_idx = d->avail_idx;
+    d->kicked_idx = new_idx;
+
+    // avail->idx must be visible before we read the device's wish
+    __sync_synchronize();
+    bool notify;
+    if (d->features & VIRTIO_RING_F_EVENT_IDX) {
+        notify = vring_need_event(*d->avail_event, new_idx, old_idx);
+    } else {
+        notify = !(d->used->flags & VRING_USED_F_NO_NOTIFY);
+    }
+    spin_unlock_irqrestore(&d->lock, flags);
+
+    if (notify && new_idx != old_idx) {
+        stat_kicks++;
+        outw(d->io + VIRTIO_REG_QUEUE_NOTIFY, 0);
+    }
+}
+
+static const struct block_ops virtio_blk_ops = {
+    virtio_blk_submit,
+    virtio_blk_flush,
+    NULL,                               // Requests cannot be cancelled
+    virtio_blk_kick,
+};
+
+// Without VIRTIO_BLK_F_FLUSH the device has no volatile cache
+static const struct block_ops virtio_blk_ops_nocache = {
+    virtio_blk_submit,
+    NULL,
+    NULL,
+    virtio_blk_kick,
+};
+
+// Report finished tags to the block layer
+static void virtio_blk_work(void* arg) {
+    struct virtio_blk* d = (struct virtio_blk*)arg;
+
+    uint32_t flags = spin_lock_irqsave(&d->lock);
+    uint32_t done = d->done;
+    uint32_t failed = d->failed & done;
+    d->done = 0;
+    d->failed &= ~done;
+    spin_unlock_irqrestore(&d->lock, flags);
+
+    while (done) {
+        uint32_t tag = __builtin_ctz(done);
+        done &= done - 1;
+        block_complete(&d->block, tag, !(failed & (1u << tag)));
+    }
+}
+
+// Consume used entries (interrupt context)
+static void virtio_blk_reap(struct virtio_blk* d) {
+    uint32_t flags = spin_lock_irqsave(&d->lock);
+
+    for (;;) {
+        while (d->last_used != d->used->idx) {
+            struct vring_used_elem* elem = &d->used->ring[d->last_used % d->size];
+            uint32_t tag = elem->id / VIRTIO_BLK_DESCS;
+
+            d->done |= 1u << tag;
+            if (d->status[tag] != VIRTIO_BLK_S_OK) {
+                d->failed |= 1u << tag;
+            }
+            d->last_used++;
+        }
+
+        // Interrupt on the next completion; recheck in case it already came
+        *d->used_event = d->last_used;
+        __sync_synchronize();
+        if (d->last_used == d->used->idx) {
+            break;
+        }
+    }
+
+    bool report = d->done != 0;
+    spin_unlock_irqrestore(&d->lock, flags);
+
+    // A pending run picks up the new bits too
+    if (report) {
+        block_schedule(&d->work);
+    }
+}
+
+// Shared handler for every line a virtio-blk device uses
+static void virtio_blk_irq(struct interrupt_frame* frame) {
+    (void)frame;
+
+    for (uint32_t i = 0; i < disk_count; i++) {
+        // Reading ISR acknowledges the interrupt
+        if (inb(disks[i].io + VIRTIO_REG_ISR_STATUS) & VIRTIO_ISR_QUEUE) {
+            stat_interrupts++;
+            virtio_blk_reap(&disks[i]);
+        }
+    }
+}
+
+// Reset, negotiate features and set up the queue
+static bool virtio_blk_probe(struct virtio_blk* d, struct pci_device* pci) {
+    uint32_t bar0 = pci_config_read32(pci, PCI_BAR(0));
+
+    if (!(bar0 & PCI_BAR_IO)) {
+        return false;
+    }
+    pci_enable(pci, PCI_CMD_IO | PCI_CMD_BUS_MASTER);
+    d->io = bar0 & PCI_BAR_IO_MASK;
+    d->irq = pci_config_read8(pci, PCI_INTERRUPT_LINE);
+
+    outb(d->io + VIRTIO_REG_DEVICE_STATUS, 0);
+    outb(d->io + VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_ACKNOWLEDGE);
+    outb(d->io + VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+
+    uint32_t offered = inl(d->io + VIRTIO_REG_DEVICE_FEATURES);
+    d->features = offered & (VIRTIO_BLK_F_RO | VIRTIO_BLK_F_FLUSH | VIRTIO_RING_F_EVENT_IDX);
+    outl(d->io + VIRTIO_REG_GUEST_FEATURES, d->features);
+
+    d->sectors = inl(d->io + VIRTIO_REG_CONFIG + VIRTIO_BLK_CFG_CAPACITY) |
+                 ((uint64_t)inl(d->io + VIRTIO_REG_CONFIG + VIRTIO_BLK_CFG_CAPACITY + 4) << 32);
+
+    if (d->irq >= IRQ_COUNT || d->sectors == 0 || !virtio_blk_setup_queue(d)) {
+        outb(d->io + VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_FAILED);
+        return false;
+    }
+    return true;
+}
+
+// Print one line per disk
+static void virtio_blk_print(struct virtio_blk* d) {
+    char num[16];
+
+    print_string("VIRTIO: ");
+    print_string(d->block.name);
+    print_string(" - ");
+    print_string(utoa((uint32_t)(d->sectors >> 11), num, 10));
+    print_string(" MB, queue ");
+    print_string(utoa(d->size, num, 10));
+    print_string(", depth ");
+    print_string(utoa(d->block.queue_depth, num, 10));
+    if (d->features & VIRTIO_RING_F_EVENT_IDX) print_string(", event idx");
+    if (d->features & VIRTIO_BLK_F_FLUSH) print_string(", flush");
+    if (d->features & VIRTIO_BLK_F_RO) print_string(", read-only");
+    print_string("\n");
+}
+
+// Find and start every legacy virtio-blk device
+bool virtio_blk_init(void) {
+    struct pci_device pci;
+
+    mutex_lock(&virtio_lock);
+
+    // Devices stay registered once found
+    if (disk_count > 0) {
+        mutex_unlock(&virtio_lock);
+        return true;
+    }
+
+    for (uint32_t index = 0; disk_count < VIRTIO_BLK_MAX_DISKS &&
+         pci_find_device(VIRTIO_PCI_VENDOR, VIRTIO_PCI_DEVICE_BLK, index, &pci); index++) {
+        struct virtio_blk* d = &disks[disk_count];
+
+        if (!virtio_blk_probe(d, &pci)) {
+            continue;
+        }
+
+        // Completion is interrupt driven: no IRQ, no disk
+        uint32_t line = 1u << d->irq;
+        if (!(hooked_irqs & line)) {
+            if (!irq_register_shared(d->irq, virtio_blk_irq)) {
+                print_string("VIRTIO: IRQ unavailable\n");
+                virtio_blk_free_queue(d);
+                outb(d->io + VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_FAILED);
+                continue;
+            }
+            hooked_irqs |= line;
+        }
+
+        spin_lock_init(&d->lock, "virtio");
+        work_init(&d->work, virtio_blk_work, d);
+        d->done = 0;
+        d->failed = 0;
+
+        // Ask for an interrupt on the first completion
+        *d->used_event = 0;
+        disk_count++;
+        outb(d->io + VIRTIO_REG_DEVICE_STATUS,
+             VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK);
+
+        strcpy(d->block.name, "vd0");
+        d->block.name[2] = '0' + disk_count - 1;
+        d->block.ops = (d->features & VIRTIO_BLK_F_FLUSH) ? &virtio_blk_ops : &virtio_blk_ops_nocache;
+        d->block.private = d;
+        d->block.sectors = d->sectors;
+        d->block.max_sectors = VIRTIO_BLK_MAX_SECTORS;
+        d->block.queue_depth = d->size / VIRTIO_BLK_DESCS;
+        if (d->block.queue_depth > BLOCK_MAX_TAGS) {
+            d->block.queue_depth = BLOCK_MAX_TAGS;
+        }
+        block_register(&d->block);
+    }
+    mutex_unlock(&virtio_lock);
+
+    for (uint32_t i = 0; i < disk_count; i++) {
+        virtio_blk_print(&disks[i]);
+    }
+    return disk_count > 0;
+}
+
+// Copy counters
+void virtio_blk_get_stats(uint32_t* submitted, uint32_t* kicks, uint32_t* interrupts) {
+    *submitted = stat_submitted;
+    *kicks = stat_kicks;
+    *interrupts = stat_interrupts;
+}
@@ -11,17 +11,24 @@
 #include "string.h"
 #include "io.h"
 #include "memory.h"
+#include "page.h"
 #include "fat12.h"
+#include "workqueue.h"
+#include "taskpool.h"
+#include "spinlock.h"
+#include "block.h"
 
-// External function declarations (from kernel/ata.c)
-bool disk_read_sector(uint32_t lba, uint8_t* buffer);
-bool disk_write_sector(uint32_t lba, uint8_t* buffer);
+#define FAT12_READ_BATCH 16     // Cluster reads queued before waiting
 
 // Filesystem state
+static struct block_device* disk = NULL;  // Volume's block device
 static fat12_bpb_t bpb;
 static bool initialized = false;
 static uint8_t* fat_cache = NULL;  // FAT cache buffer
 static uint8_t* root_dir_cache = NULL;  // Root directory cache
+static rwlock_t fat_lock = RWLOCK_INIT("fat12");  // Readers walk fat_cache, mount writes it
+static volatile uint32_t free_clusters = 0;  // Counted by fat_count_work
+static volatile bool free_clusters_valid = false;
 
 // Local helper function prototypes
 static uint32_t calculate_root_dir_sectors(void);
@@ -29,6 +36,12 @@ static uint32_t calculate_data_start_sector(void);
 static bool read_fat_table(void);
 static bool read_root_directory(void);
 static bool validate_fat12(void);
+static uint32_t count_free_clusters(void);
+static uint16_t fat_entry(const uint8_t* fat, uint16_t cluster);
+static void fat12_count_work(void* arg);
+static bool fat12_wait_bios(struct bio* bios, uint32_t count);
+
+static struct work fat_count_work = WORK_INIT(fat12_count_work, NULL);
 
 // Initialize FAT12 filesystem
 bool fat12_init(void) {
@@ -47,11 +60,20 @@ bool fat12_init(void) {
         return false;
     }
     
-    // Read boot sector
-    if (!disk_read_sector(0, (uint8_t*)&bpb)) {
+    // First registered disk is the boot disk
+    disk = block_first();
+    if (!disk) {
+        print_string("Error: No block device\n");
+        return false;
+    }
+    
+    // Read boot sector (whole sector, BPB is only its start)
+    uint8_t boot_sector[512];
+    if (!block_read(disk, 0, 1, boot_sector)) {
         print_string("Error: Cannot read boot sector\n");
         return false;
     }
+    memcpy(&bpb, boot_sector, sizeof(bpb));
     
     // Validate FAT12
     if (!validate_fat12()) {
@@ -60,7 +82,10 @@ bool fat12_init(void) {
     }
     
     // Read FAT table
-    if (!read_fat_table()) {
+    write_lock(&fat_lock);
+    bool fat_loaded = read_fat_table();
+    write_unlock(&fat_lock);
+    if (!fat_loaded) {
         print_string("Error: Cannot read FAT table\n");
         return false;
     }
@@ -73,6 +98,10 @@ bool fat12_init(void) {
     
     initialized = true;
     
+    // Scan the FAT for free clusters in the background
+    free_clusters_valid = false;
+    schedule_work(&fat_count_work);
+    
     // Print filesystem info
     print_string("FAT12 Filesystem mounted:\n");
     
@@ -133,13 +162,8 @@ static bool validate_fat12(void) {
 static bool read_fat_table(void) {
     uint32_t fat_start = bpb.reserved_sectors;
     
-    for (uint16_t i = 0; i < bpb.sectors_per_fat; i++) {
-        if (!disk_read_sector(fat_start + i, &fat_cache[i * 512])) {
-            return false;
-        }
-    }
-    
-    return true;
+    // Whole FAT in one command
+    return block_read(disk, fat_start, bpb.sectors_per_fat, fat_cache);
 }
 
 // Read root directory into cache
@@ -147,13 +171,8 @@ static bool read_root_directory(void) {
     uint32_t root_dir_start = bpb.reserved_sectors + (bpb.fat_count * bpb.sectors_per_fat);
     uint32_t root_dir_sectors = calculate_root_dir_sectors();
     
-    for (uint32_t i = 0; i < root_dir_sectors; i++) {
-        if (!disk_read_sector(root_dir_start + i, &root_dir_cache[i * 512])) {
-            return false;
-        }
-    }
-    
-    return true;
+    // Whole root directory in one command
+    return block_read(disk, root_dir_start, root_dir_sectors, root_dir_cache);
 }
 
 // Calculate root directory size in sectors
@@ -180,6 +199,11 @@ uint32_t fat12_cluster_to_lba(uint16_t cluster) {
 
 // Get next cluster in chain
 uint16_t fat12_get_next_cluster(uint16_t cluster) {
+    return fat_entry(fat_cache, cluster);
+}
+
+// Decode a FAT entry from a FAT image (the cache or a snapshot of it)
+static uint16_t fat_entry(const uint8_t* fat, uint16_t cluster) {
     if (cluster < 2 || cluster >= 4085) {  // FAT12 max cluster
         return 0xFFF;  // Invalid
     }
@@ -192,10 +216,10 @@ uint16_t fat12_get_next_cluster(uint16_t cluster) {
     
     if (cluster & 0x0001) {
         // Odd cluster: high 12 bits
-        return (fat_cache[fat_offset] >> 4) | (fat_cache[fat_offset + 1] << 4);
+        return (fat[fat_offset] >> 4) | (fat[fat_offset + 1] << 4);
     } else {
         // Even cluster: low 12 bits
-        return (fat_cache[fat_offset] | (fat_cache[fat_offset + 1] << 8)) & 0x0FFF;
+        return (fat[fat_offset] | (fat[fat_offset + 1] << 8)) & 0x0FFF;
     }
 }
 
@@ -385,47 +409,91 @@ bool fat12_read_file(const char* filename, uint8_t* buffer, uint32_t max_size) {
         return false;
     }
     
-    // Follow cluster chain
+    // Queue whole sectors straight into buffer; adjacent clusters merge
     uint16_t cluster = entry.first_cluster;
-    uint32_t bytes_read = 0;
+    uint32_t sectors = entry.file_size / 512;
+    uint32_t tail = entry.file_size % 512;     // Bytes in the last partial sector
+    uint32_t done = 0;
+    uint32_t queued = 0;
+    struct bio bios[FAT12_READ_BATCH];
     uint8_t sector_buffer[512];
+    bool ok = true;
     
-    while (cluster < 0xFF8) {  // Not EOF
+    while (done < sectors || tail) {
+        if (cluster >= 0xFF8) {  // EOF before file_size
+            ok = false;
+            break;
+        }
         if (cluster == 0xFF7) {
             // Bad cluster
             print_string("Error: Bad cluster encountered\n");
-            return false;
+            ok = false;
+            break;
         }
         
         // Read cluster
         uint32_t lba = fat12_cluster_to_lba(cluster);
-        for (int i = 0; i < bpb.sectors_per_cluster; i++) {
-            if (!disk_read_sector(lba + i, sector_buffer)) {
+        uint32_t count = sectors - done;
+        if (count > bpb.sectors_per_cluster) {
+            count = bpb.sectors_per_cluster;
+        }
+        
+        if (count > 0) {
+            bio_init(&bios[queued], lba, count, buffer + done * 512, false, NULL, NULL);
+            if (!block_submit(disk, &bios[queued])) {
                 print_string("Error: Cannot read sector\n");
-                return false;
+                ok = false;
+                break;
             }
-            
-            // Calculate bytes to copy
-            uint32_t to_copy = 512;
-            if (bytes_read + to_copy > entry.file_size) {
-                to_copy = entry.file_size - bytes_read;
+            queued++;
+            done += count;
+        }
+        
+        // Last partial sector lies in this cluster: bounce it
+        if (tail && count < bpb.sectors_per_cluster) {
+            if (!block_read(disk, lba + count, 1, sector_buffer)) {
+                print_string("Error: Cannot read sector\n");
+                ok = false;
+                break;
             }
-            
-            // Copy to buffer
-            memcpy(buffer + bytes_read, sector_buffer, to_copy);
-            bytes_read += to_copy;
-            
-            // Check if done
-            if (bytes_read >= entry.file_size) {
-                return true;
+            memcpy(buffer + done * 512, sector_buffer, tail);
+            tail = 0;
+        }
+        
+        if (queued == FAT12_READ_BATCH) {
+            ok = fat12_wait_bios(bios, queued);
+            queued = 0;
+            if (!ok) {
+                break;
             }
         }
         
         // Get next cluster
+        read_lock(&fat_lock);
         cluster = fat12_get_next_cluster(cluster);
+        read_unlock(&fat_lock);
     }
     
-    return bytes_read == entry.file_size;
+    // Bios live on this stack: always wait for them
+    if (!fat12_wait_bios(bios, queued)) {
+        ok = false;
+    }
+    return ok;
+}
+
+// Wait for queued reads
+static bool fat12_wait_bios(struct bio* bios, uint32_t count) {
+    bool ok = true;
+    
+    for (uint32_t i = 0; i < count; i++) {
+        if (!bio_wait(&bios[i])) {
+            ok = false;
+        }
+    }
+    if (!ok) {
+        print_string("Error: Cannot read sector\n");
+    }
+    return ok;
 }
 
 // Check if filesystem is mounted
@@ -433,23 +501,128 @@ bool fat12_is_mounted(void) {
     return initialized;
 }
 
-// Get free space (simplified - counts free clusters)
+// Count free clusters in FAT (cluster 2 and up)
+static uint32_t count_free_clusters(void) {
+    uint32_t count = 0;
+    
+    read_lock(&fat_lock);
+    for (uint16_t cluster = 2; cluster < 4085; cluster++) {
+        uint16_t fat_entry = fat12_get_next_cluster(cluster);
+        if (fat_entry == 0x000) {  // Free cluster
+            count++;
+        }
+    }
+    read_unlock(&fat_lock);
+    
+    return count;
+}
+
+// Deferred free cluster count (events worker)
+static void fat12_count_work(void* arg) {
+    (void)arg;
+    free_clusters = count_free_clusters();
+    free_clusters_valid = true;
+}
+
+// Get free space (from the cached free cluster count)
 uint32_t fat12_get_free_space(void) {
     if (!initialized) {
         return 0;
     }
     
-    uint32_t free_clusters = 0;
+    // Asked before the worker got to it
+    if (!free_clusters_valid) {
+        free_clusters = count_free_clusters();
+        free_clusters_valid = true;
+    }
     
-    // Count free clusters in FAT (cluster 2 and up)
-    for (uint16_t cluster = 2; cluster < 4085; cluster++) {
-        uint16_t fat_entry = fat12_get_next_cluster(cluster);
-        if (fat_entry == 0x000) {  // Free cluster
-            free_clusters++;
+    return free_clusters * bpb.sectors_per_cluster * bpb.bytes_per_sector;
+}
+
+// Data clusters on the volume (numbered from 2)
+static uint32_t count_data_clusters(void) {
+    uint32_t data_sectors = bpb.total_sectors - calculate_data_start_sector();
+    uint32_t clusters = data_sectors / bpb.sectors_per_cluster;
+    
+    if (clusters > 4085 - 2) {
+        clusters = 4085 - 2;  // FAT12 limit
+    }
+    return clusters;
+}
+
+// Shared state for a parallel chain check (one per call, in its own pages)
+struct chain_check {
+    uint32_t max_cluster;
+    fat12_check_t* result;
+    uint32_t refs[4096 / 32];  // Clusters something links to
+    uint8_t fat[];             // Snapshot of the FAT being checked
+};
+
+// parallel_for body: validate links of clusters [start, end)
+static void check_chain_range(uint32_t start, uint32_t end, void* arg) {
+    struct chain_check* check = (struct chain_check*)arg;
+    uint32_t free = 0, chains = 0, bad = 0, invalid = 0, crosslinked = 0;
+    
+    for (uint32_t cluster = start; cluster < end; cluster++) {
+        uint16_t next = fat_entry(check->fat, cluster);
+        
+        if (next == 0x000) {
+            free++;
+        } else if (next >= 0xFF8) {
+            chains++;
+        } else if (next == 0xFF7) {
+            bad++;
+        } else if (next < 2 || next > check->max_cluster ||
+                   fat_entry(check->fat, next) == 0x000) {
+            invalid++;
+        } else {
+            // Each cluster may be linked to once; bts reports earlier claims
+            uint8_t seen;
+            asm volatile ("lock btsl %2, %0; setc %1"
+                          : "+m"(check->refs[next / 32]), "=q"(seen)
+                          : "r"(next % 32) : "memory", "cc");
+            if (seen) {
+                crosslinked++;
+            }
         }
     }
     
-    return free_clusters * bpb.sectors_per_cluster * bpb.bytes_per_sector;
+    __sync_fetch_and_add(&check->result->free, free);
+    __sync_fetch_and_add(&check->result->chains, chains);
+    __sync_fetch_and_add(&check->result->bad, bad);
+    __sync_fetch_and_add(&check->result->invalid, invalid);
+    __sync_fetch_and_add(&check->result->crosslinked, crosslinked);
+}
+
+// Verify FAT chains
+bool fat12_verify_chains(fat12_check_t* result) {
+    memset(result, 0, sizeof(*result));
+    if (!initialized) {
+        return false;
+    }
+    
+    // Too big for a worker stack
+    uint32_t fat_bytes = bpb.sectors_per_fat * 512;
+    uint32_t pages = (sizeof(struct chain_check) + fat_bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+    struct chain_check* check = (struct chain_check*)page_alloc(pages);
+    if (!check) {
+        return false;
+    }
+    
+    result->clusters = count_data_clusters();
+    check->max_cluster = result->clusters + 1;
+    check->result = result;
+    memset(check->refs, 0, sizeof(check->refs));
+    
+    // Snapshot under the spinning lock; parallel_for may sleep
+    read_lock(&fat_lock);
+    memcpy(check->fat, fat_cache, fat_bytes);
+    read_unlock(&fat_lock);
+    
+    parallel_for(2, check->max_cluster + 1, 64, check_chain_range, check);
+    page_free(check, pages);
+    
+    return result->invalid == 0 && result->crosslinked == 0;
 }
 
 // Get total space
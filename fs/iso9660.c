@@ -0,0 +1,439 @@
+/**************************************************************
+ * ISO9660 Filesystem Driver - BloodG OS
+ * Read-only access to CD volumes: path lookup through an LRU
+ * cache of parsed directories, whole-file reads as large bios
+ **************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "string.h"
+#include "io.h"
+#include "page.h"
+#include "sync.h"
+#include "block.h"
+#include "iso9660.h"
+
+#define ISO9660_SECTOR_RATIO    (ISO9660_SECTOR_SIZE / BLOCK_SECTOR_SIZE)
+#define ISO9660_READ_SECTORS    64      // CD sectors per file bio (128KB)
+
+// One parsed directory
+struct iso9660_dir {
+    uint32_t extent;                    // 0: free slot
+    uint32_t count;
+    uint32_t pages;                     // Backing entries
+    iso9660_entry_t* entries;
+    uint32_t last_used;                 // LRU stamp
+};
+
+// Volume state
+static struct block_device* disc = NULL;
+static bool mounted = false;
+static char volume_label[33];
+static iso9660_entry_t root;
+
+// Directory cache
+static struct iso9660_dir dir_cache[ISO9660_DIR_CACHE];
+static uint32_t cache_clock = 0;
+static uint32_t cache_hits = 0;
+static uint32_t cache_misses = 0;
+
+// Guards everything above and sector_buffer
+static struct mutex iso_lock = MUTEX_INIT;
+static uint8_t sector_buffer[ISO9660_SECTOR_SIZE];
+
+void print_string(const char* str);
+
+// Read CD sectors
+static bool iso9660_read_sectors(uint32_t sector, uint32_t count, uint8_t* buffer) {
+    return block_read(disc, (uint64_t)sector * ISO9660_SECTOR_RATIO,
+                      count * ISO9660_SECTOR_RATIO, buffer);
+}
+
+// Copy a record's identifier without ";version" or a trailing dot
+static void iso9660_copy_name(const iso9660_dir_record_t* record, char* name) {
+    uint32_t len = 0;
+
+    for (uint32_t i = 0; i < record->name_length && len < ISO9660_NAME_MAX - 1; i++) {
+        if (record->name[i] == ';') {
+            break;
+        }
+        name[len++] = record->name[i];
+    }
+    if (len > 0 && name[len - 1] == '.') {
+        len--;
+    }
+    name[len] = '\0';
+}
+
+// Case-insensitive compare of a cached name with len bytes of a path component
+static bool iso9660_name_match(const char* name, const char* component, uint32_t len) {
+    // Accept "FILE.TXT;1" as well as "file.txt"
+    for (uint32_t i = 0; i < len; i++) {
+        if (component[i] == ';') {
+            len = i;
+            break;
+        }
+    }
+    for (uint32_t i = 0; i < len; i++) {
+        if (toupper((unsigned char)name[i]) != toupper((unsigned char)component[i])) {
+            return false;
+        }
+    }
+    return name[len] == '\0';
+}
+
+// Fill an entry from a directory record
+static void iso9660_make_entry(const iso9660_dir_record_t* record, iso9660_entry_t* entry) {
+    iso9660_copy_name(record, entry->name);
+    entry->extent = record->extent + record->ext_attr_length;
+    entry->size = record->size;
+    entry->directory = (record->flags & ISO9660_FLAG_DIRECTORY) != 0;
+}
+
+// Read and parse directory dir into a cache slot (iso_lock held)
+static struct iso9660_dir* iso9660_load_dir(const iso9660_entry_t* dir) {
+    uint32_t sectors = (dir->size + ISO9660_SECTOR_SIZE - 1) / ISO9660_SECTOR_SIZE;
+    uint32_t raw_pages = (sectors * ISO9660_SECTOR_SIZE + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    if (sectors == 0 || dir->size > ISO9660_DIR_MAX_BYTES) {
+        return NULL;
+    }
+
+    // Every record takes at least 34 bytes
+    uint32_t max_entries = dir->size / 34;
+    uint32_t pages = (max_entries * sizeof(iso9660_entry_t) + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (pages == 0) {
+        pages = 1;
+    }
+
+    uint8_t* raw = (uint8_t*)page_alloc(raw_pages);
+    iso9660_entry_t* entries = (iso9660_entry_t*)page_alloc(pages);
+    if (!raw || !entries || !iso9660_read_sectors(dir->extent, sectors, raw)) {
+        if (raw) page_free(raw, raw_pages);
+        if (entries) page_free(entries, pages);
+        return NULL;
+    }
+
+    // Records never cross a sector; a zero length skips to the next one
+    uint32_t count = 0;
+    uint32_t offset = 0;
+    while (offset < dir->size && count < max_entries) {
+        iso9660_dir_record_t* record = (iso9660_dir_record_t*)(raw + offset);
+
+        if (record->length == 0) {
+            offset = (offset / ISO9660_SECTOR_SIZE + 1) * ISO9660_SECTOR_SIZE;
+            continue;
+        }
+        if (record->length < sizeof(*record) + record->name_length ||
+            offset % ISO9660_SECTOR_SIZE + record->length > ISO9660_SECTOR_SIZE) {
+            break;              // Corrupt record
+        }
+        offset += record->length;
+
+        // Skip "." / "..", associated files and continued extents
+        if (record->name_length == 1 && (uint8_t)record->name[0] <= 1) {
+            continue;
+        }
+        if (record->flags & (ISO9660_FLAG_ASSOCIATED | ISO9660_FLAG_MULTI)) {
+            continue;
+        }
+        iso9660_make_entry(record, &entries[count++]);
+    }
+    page_free(raw, raw_pages);
+
+    // Reuse the least recently used slot
+    struct iso9660_dir* slot = &dir_cache[0];
+    for (uint32_t i = 1; i < ISO9660_DIR_CACHE; i++) {
+        if (dir_cache[i].last_used < slot->last_used) {
+            slot = &dir_cache[i];
+        }
+    }
+    if (slot->entries) {
+        page_free(slot->entries, slot->pages);
+    }
+
+    slot->extent = dir->extent;
+    slot->count = count;
+    slot->pages = pages;
+    slot->entries = entries;
+    return slot;
+}
+
+// Cached parsed form of directory dir (iso_lock held)
+static struct iso9660_dir* iso9660_get_dir(const iso9660_entry_t* dir) {
+    struct iso9660_dir* slot = NULL;
+
+    for (uint32_t i = 0; i < ISO9660_DIR_CACHE; i++) {
+        if (dir_cache[i].entries && dir_cache[i].extent == dir->extent) {
+            slot = &dir_cache[i];
+            break;
+        }
+    }
+
+    if (slot) {
+        cache_hits++;
+    } else {
+        cache_misses++;
+        slot = iso9660_load_dir(dir);
+        if (!slot) {
+            return NULL;
+        }
+    }
+    slot->last_used = ++cache_clock;
+    return slot;
+}
+
+// Walk path from the root (iso_lock held)
+static bool iso9660_lookup(const char* path, iso9660_entry_t* result) {
+    iso9660_entry_t current = root;
+
+    while (path && *path) {
+        while (*path == '/') {
+            path++;
+        }
+        if (!*path) {
+            break;
+        }
+
+        const char* end = path;
+        while (*end && *end != '/') {
+            end++;
+        }
+        if (!current.directory) {
+            return false;
+        }
+
+        struct iso9660_dir* dir = iso9660_get_dir(&current);
+        if (!dir) {
+            return false;
+        }
+
+        bool found = false;
+        for (uint32_t i = 0; i < dir->count; i++) {
+            if (iso9660_name_match(dir->entries[i].name, path, end - path)) {
+                current = dir->entries[i];
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+        path = end;
+    }
+
+    *result = current;
+    return true;
+}
+
+// Look for a primary volume descriptor on dev (iso_lock held)
+static bool iso9660_probe(struct block_device* dev) {
+    iso9660_pvd_t* pvd = (iso9660_pvd_t*)sector_buffer;
+
+    disc = dev;
+    for (uint32_t i = 0; i < ISO9660_MAX_VD; i++) {
+        uint32_t sector = ISO9660_FIRST_VD + i;
+
+        if ((uint64_t)(sector + 1) * ISO9660_SECTOR_RATIO > dev->sectors ||
+            !iso9660_read_sectors(sector, 1, sector_buffer)) {
+            return false;
+        }
+        if (memcmp(pvd->id, "CD001", 5) != 0 || pvd->type == ISO9660_VD_TERMINATOR) {
+            return false;
+        }
+        if (pvd->type != ISO9660_VD_PRIMARY) {
+            continue;           // Boot record, Joliet supplementary, ...
+        }
+        if (pvd->block_size != ISO9660_SECTOR_SIZE) {
+            return false;
+        }
+
+        // Label without its space padding
+        memcpy(volume_label, pvd->volume_id, 32);
+        volume_label[32] = '\0';
+        for (int j = 31; j >= 0 && volume_label[j] == ' '; j--) {
+            volume_label[j] = '\0';
+        }
+
+        iso9660_make_entry((iso9660_dir_record_t*)pvd->root, &root);
+        root.name[0] = '\0';
+        root.directory = true;
+        return true;
+    }
+    return false;
+}
+
+// Mount the first ISO9660 volume found
+bool iso9660_init(void) {
+    mutex_lock(&iso_lock);
+    if (mounted) {
+        mutex_unlock(&iso_lock);
+        return true;
+    }
+
+    for (struct block_device* dev = block_first(); dev; dev = dev->next) {
+        if (iso9660_probe(dev)) {
+            mounted = true;
+            break;
+        }
+    }
+
+    // Warm the cache with the root directory
+    if (mounted && !iso9660_get_dir(&root)) {
+        mounted = false;
+    }
+    if (!mounted) {
+        disc = NULL;
+        volume_label[0] = '\0';
+    }
+    bool ok = mounted;
+    mutex_unlock(&iso_lock);
+    return ok;
+}
+
+// Check if mounted
+bool iso9660_is_mounted(void) {
+    return mounted;
+}
+
+// Volume label
+const char* iso9660_volume_label(void) {
+    return volume_label;
+}
+
+// Look up a path
+bool iso9660_find(const char* path, iso9660_entry_t* result) {
+    if (!mounted) {
+        return false;
+    }
+
+    mutex_lock(&iso_lock);
+    bool found = iso9660_lookup(path, result);
+    mutex_unlock(&iso_lock);
+    return found;
+}
+
+// List a directory
+void iso9660_list_directory(const char* path) {
+    char num[16];
+
+    if (!mounted) {
+        print_string("No ISO9660 volume mounted\n");
+        return;
+    }
+
+    mutex_lock(&iso_lock);
+    iso9660_entry_t entry;
+    struct iso9660_dir* dir = NULL;
+    if (iso9660_lookup(path, &entry) && entry.directory) {
+        dir = iso9660_get_dir(&entry);
+    }
+    if (!dir) {
+        mutex_unlock(&iso_lock);
+        print_string("Directory not found\n");
+        return;
+    }
+
+    for (uint32_t i = 0; i < dir->count; i++) {
+        iso9660_entry_t* e = &dir->entries[i];
+
+        print_string(e->directory ? "[DIR]  " : "[FILE] ");
+        print_string(e->name);
+
+        // Align columns
+        size_t name_len = strlen(e->name);
+        while (name_len++ < 24) {
+            print_string(" ");
+        }
+        if (!e->directory) {
+            print_string(utoa(e->size, num, 10));
+            print_string(" bytes");
+        }
+        print_string("\n");
+    }
+    if (dir->count == 0) {
+        print_string("(empty)\n");
+    }
+    mutex_unlock(&iso_lock);
+}
+
+// Wait for queued reads
+static bool iso9660_wait_bios(struct bio* bios, uint32_t count) {
+    bool ok = true;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (!bio_wait(&bios[i])) {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// Read a whole file
+bool iso9660_read_file(const char* path, uint8_t* buffer, uint32_t max_size, uint32_t* size) {
+    if (!mounted) {
+        return false;
+    }
+
+    mutex_lock(&iso_lock);
+    iso9660_entry_t entry;
+    if (!iso9660_lookup(path, &entry) || entry.directory || entry.size > max_size) {
+        mutex_unlock(&iso_lock);
+        return false;
+    }
+
+    // Extents are contiguous: whole sectors go straight into buffer in big bios
+    uint32_t sectors = entry.size / ISO9660_SECTOR_SIZE;
+    uint32_t tail = entry.size % ISO9660_SECTOR_SIZE;
+    struct bio bios[ISO9660_READ_BATCH];
+    uint32_t queued = 0;
+    bool ok = true;
+
+    for (uint32_t done = 0; done < sectors && ok; ) {
+        uint32_t count = sectors - done;
+        if (count > ISO9660_READ_SECTORS) {
+            count = ISO9660_READ_SECTORS;
+        }
+
+        bio_init(&bios[queued], (uint64_t)(entry.extent + done) * ISO9660_SECTOR_RATIO,
+                 count * ISO9660_SECTOR_RATIO, buffer + done * ISO9660_SECTOR_SIZE,
+                 false, NULL, NULL);
+        if (!block_submit(disc, &bios[queued])) {
+            ok = false;
+            break;
+        }
+        queued++;
+        done += count;
+
+        if (queued == ISO9660_READ_BATCH) {
+            ok = iso9660_wait_bios(bios, queued);
+            queued = 0;
+        }
+    }
+
+    // Bios live on this stack: always wait for them
+    if (!iso9660_wait_bios(bios, queued)) {
+        ok = false;
+    }
+
+    // Last partial sector goes through the bounce buffer
+    if (ok && tail) {
+        ok = iso9660_read_sectors(entry.extent + sectors, 1, sector_buffer);
+        if (ok) {
+            memcpy(buffer + sectors * ISO9660_SECTOR_SIZE, sector_buffer, tail);
+        }
+    }
+    mutex_unlock(&iso_lock);
+
+    if (ok && size) {
+        *size = entry.size;
+    }
+    return ok;
+}
+
+// Directory cache counters
+void iso9660_get_cache_stats(uint32_t* hits, uint32_t* misses) {
+    *hits = cache_hits;
+    *misses = cache_misses;
+}
@@ -0,0 +1,130 @@
+/**************************************************************
+ * ACPI Table Header - BloodG OS
+ * RSDP/RSDT discovery and MADT parsing
+ **************************************************************/
+
+#ifndef _ACPI_H
+#define _ACPI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ==================== ACPI STRUCTURES ==================== */
+
+#pragma pack(push, 1)
+
+/**
+ * Root System Description Pointer
+ */
+typedef struct {
+    char     signature[8];      /**< "RSD PTR " */
+    uint8_t  checksum;          /**< Checksum of first 20 bytes */
+    char     oem_id[6];         /**< OEM ID */
+    uint8_t  revision;          /**< 0 = ACPI 1.0, 2 = ACPI 2.0+ */
+    uint32_t rsdt_address;      /**< Physical address of RSDT */
+} acpi_rsdp_t;
+
+/**
+ * Common header of every system description table
+ */
+typedef struct {
+    char     signature[4];      /**< Table signature ("APIC", "HPET", ...) */
+    uint32_t length;            /**< Length including header */
+    uint8_t  revision;          /**< Table revision */
+    uint8_t  checksum;          /**< Whole table sums to 0 */
+    char     oem_id[6];         /**< OEM ID */
+    char     oem_table_id[8];   /**< OEM table ID */
+    uint32_t oem_revision;      /**< OEM revision */
+    uint32_t creator_id;        /**< Creator ID */
+    uint32_t creator_revision;  /**< Creator revision */
+} acpi_sdt_header_t;
+
+/**
+ * Multiple APIC Description Table
+ */
+typedef struct {
+    acpi_sdt_header_t header;   /**< Signature "APIC" */
+    uint32_t lapic_address;     /**< Local APIC physical address */
+    uint32_t flags;             /**< Bit 0: dual 8259 present */
+} acpi_madt_t;
+
+/**
+ * MADT entry header
+ */
+typedef struct {
+    uint8_t type;               /**< ACPI_MADT_* */
+    uint8_t length;             /**< Entry length */
+} acpi_madt_entry_t;
+
+#pragma pack(pop)
+
+/* ==================== MADT ENTRY TYPES ==================== */
+
+#define ACPI_MADT_LAPIC             0
+#define ACPI_MADT_IOAPIC            1
+#define ACPI_MADT_ISO               2   // Interrupt source override
+#define ACPI_MADT_LAPIC_NMI         4
+#define ACPI_MADT_LAPIC_OVERRIDE    5
+
+#define ACPI_MADT_PCAT_COMPAT       0x01
+#define ACPI_LAPIC_ENABLED          0x01
+
+// Interrupt source override flags
+#define ACPI_IRQ_POLARITY_MASK      0x03
+#define ACPI_IRQ_ACTIVE_LOW         0x03
+#define ACPI_IRQ_TRIGGER_MASK       0x0C
+#define ACPI_IRQ_LEVEL              0x0C
+
+/* ==================== PARSED INFORMATION ==================== */
+
+#define ACPI_MAX_CPUS       16
+#define ACPI_MAX_IOAPICS    4
+#define ACPI_ISA_IRQS       16
+
+/**
+ * I/O APIC described by the MADT
+ */
+struct acpi_ioapic {
+    uint8_t  id;                /**< I/O APIC ID */
+    uint32_t address;           /**< MMIO base */
+    uint32_t gsi_base;          /**< First GSI handled */
+};
+
+/**
+ * Interrupt topology from the MADT
+ */
+struct acpi_info {
+    bool     madt_found;                        /**< MADT present */
+    uint32_t lapic_address;                     /**< Local APIC MMIO base */
+    bool     pcat_compat;                       /**< Legacy 8259s present */
+    uint8_t  cpu_count;                         /**< Enabled processors */
+    uint8_t  cpu_apic_ids[ACPI_MAX_CPUS];       /**< Their LAPIC IDs */
+    uint8_t  ioapic_count;                      /**< I/O APICs */
+    struct acpi_ioapic ioapics[ACPI_MAX_IOAPICS];
+    uint32_t isa_gsi[ACPI_ISA_IRQS];            /**< ISA IRQ -> GSI */
+    uint16_t isa_flags[ACPI_ISA_IRQS];          /**< Polarity/trigger */
+};
+
+/* ==================== ACPI FUNCTIONS ==================== */
+
+/**
+ * Locate RSDP/RSDT, reserve the tables' pages and parse the MADT
+ * (call after page_init)
+ * @return true if ACPI tables were found, false otherwise
+ */
+bool acpi_init(void);
+
+/**
+ * Find table by signature
+ * @param signature Four-character signature (e.g. "HPET")
+ * @return Pointer to table, or NULL if not found
+ */
+const acpi_sdt_header_t* acpi_find_table(const char* signature);
+
+/**
+ * Get parsed MADT information
+ * @return Pointer to ACPI information
+ */
+const struct acpi_info* acpi_get_info(void);
+
+#endif /* _ACPI_H */
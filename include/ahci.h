@@ -0,0 +1,195 @@
+/**************************************************************
+ * AHCI (SATA) Driver Header - BloodG OS
+ * HBA registers, command structures and driver interface
+ **************************************************************/
+
+#ifndef _AHCI_H
+#define _AHCI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ==================== AHCI CONSTANTS ==================== */
+
+#define AHCI_MAX_PORTS          32
+#define AHCI_MAX_SLOTS          32      /**< Command slots (and NCQ tags) per port */
+#define AHCI_PRDT_ENTRIES       8       /**< PRDs per command table */
+#define AHCI_PRD_MAX_BYTES      (4 * 1024 * 1024)   /**< One PRD covers up to 4MB */
+#define AHCI_MAX_SECTORS        65536   /**< Per command (count 0 means 65536) */
+
+#define PCI_SUBCLASS_SATA       0x06
+#define AHCI_PROG_IF            0x01
+#define AHCI_BAR                5       /**< ABAR: HBA memory registers */
+
+// HBA capabilities (CAP)
+#define AHCI_CAP_NCS_SHIFT      8       /**< Command slots - 1 (5 bits) */
+#define AHCI_CAP_SNCQ           (1u << 30)  /**< Native command queuing */
+
+// Global HBA control (GHC)
+#define AHCI_GHC_HR             (1u << 0)   /**< HBA reset */
+#define AHCI_GHC_IE             (1u << 1)   /**< Interrupt enable */
+#define AHCI_GHC_AE             (1u << 31)  /**< AHCI enable */
+
+// Port command and status (PxCMD)
+#define AHCI_PORT_CMD_ST        (1u << 0)   /**< Start processing the command list */
+#define AHCI_PORT_CMD_FRE       (1u << 4)   /**< FIS receive enable */
+#define AHCI_PORT_CMD_FR        (1u << 14)  /**< FIS receive running */
+#define AHCI_PORT_CMD_CR        (1u << 15)  /**< Command list running */
+
+// Port interrupt status / enable (PxIS, PxIE)
+#define AHCI_PORT_IS_DHRS       (1u << 0)   /**< D2H register FIS */
+#define AHCI_PORT_IS_PSS        (1u << 1)   /**< PIO setup FIS */
+#define AHCI_PORT_IS_DSS        (1u << 2)   /**< DMA setup FIS */
+#define AHCI_PORT_IS_SDBS       (1u << 3)   /**< Set device bits FIS (NCQ done) */
+#define AHCI_PORT_IS_TFES       (1u << 30)  /**< Task file error */
+#define AHCI_PORT_IS_ERRORS     0x7DC00050  /**< Every error bit */
+
+// Port task file data (PxTFD)
+#define AHCI_TFD_ERR            0x01
+#define AHCI_TFD_DRQ            0x08
+#define AHCI_TFD_BSY            0x80
+
+// SATA status (PxSSTS)
+#define AHCI_SSTS_DET_MASK      0x0F
+#define AHCI_SSTS_DET_PRESENT   0x03    /**< Device present, PHY up */
+
+// Port signatures (PxSIG)
+#define AHCI_SIG_ATA            0x00000101
+#define AHCI_SIG_ATAPI          0xEB140101
+
+// FIS types
+#define AHCI_FIS_REG_H2D        0x27
+#define AHCI_FIS_H2D_COMMAND    0x80    /**< C bit: command register update */
+
+// Command header flags (dword 0)
+#define AHCI_CMD_FIS_LEN        5       /**< H2D register FIS in dwords */
+#define AHCI_CMD_WRITE          (1u << 6)
+#define AHCI_CMD_CLEAR_BUSY     (1u << 10)  /**< C: clear BSY after R_OK */
+#define AHCI_CMD_PRDTL_SHIFT    16
+
+#define AHCI_PRD_IRQ            (1u << 31)
+
+// ATA commands issued over AHCI
+#define AHCI_ATA_READ_DMA_EXT       0x25
+#define AHCI_ATA_WRITE_DMA_EXT      0x35
+#define AHCI_ATA_READ_FPDMA_QUEUED  0x60
+#define AHCI_ATA_WRITE_FPDMA_QUEUED 0x61
+#define AHCI_ATA_FLUSH_CACHE_EXT    0xEA
+#define AHCI_ATA_IDENTIFY           0xEC
+
+/* ==================== AHCI STRUCTURES ==================== */
+
+/**
+ * Port registers (0x80 bytes each, from ABAR + 0x100)
+ */
+struct ahci_port_regs {
+    uint32_t clb;               /**< Command list base (1KB aligned) */
+    uint32_t clbu;
+    uint32_t fb;                /**< Received FIS base (256B aligned) */
+    uint32_t fbu;
+    uint32_t is;                /**< Interrupt status */
+    uint32_t ie;                /**< Interrupt enable */
+    uint32_t cmd;               /**< Command and status */
+    uint32_t reserved0;
+    uint32_t tfd;               /**< Task file data */
+    uint32_t sig;               /**< Device signature */
+    uint32_t ssts;              /**< SATA status */
+    uint32_t sctl;              /**< SATA control */
+    uint32_t serr;              /**< SATA error */
+    uint32_t sact;              /**< NCQ tags outstanding */
+    uint32_t ci;                /**< Command slots issued */
+    uint32_t sntf;
+    uint32_t fbs;
+    uint32_t reserved1[11];
+    uint32_t vendor[4];
+};
+
+/**
+ * HBA memory registers (ABAR)
+ */
+struct ahci_hba_regs {
+    uint32_t cap;               /**< Capabilities */
+    uint32_t ghc;               /**< Global HBA control */
+    uint32_t is;                /**< Interrupt status (bit per port) */
+    uint32_t pi;                /**< Ports implemented */
+    uint32_t vs;                /**< Version */
+    uint32_t ccc_ctl;
+    uint32_t ccc_pts;
+    uint32_t em_loc;
+    uint32_t em_ctl;
+    uint32_t cap2;
+    uint32_t bohc;
+    uint32_t reserved[29];
+    uint32_t vendor[24];
+    struct ahci_port_regs ports[AHCI_MAX_PORTS];
+};
+
+/**
+ * Command list entry (32 bytes, one per slot)
+ */
+struct ahci_cmd_header {
+    uint32_t flags;             /**< FIS length, W, C, PRDT length */
+    volatile uint32_t prdbc;    /**< Bytes transferred */
+    uint32_t ctba;              /**< Command table base (128B aligned) */
+    uint32_t ctbau;
+    uint32_t reserved[4];
+} __attribute__((packed));
+
+/**
+ * Physical region descriptor
+ */
+struct ahci_prd {
+    uint32_t dba;               /**< Data base (word aligned) */
+    uint32_t dbau;
+    uint32_t reserved;
+    uint32_t dbc;               /**< Byte count - 1, bit 31: interrupt */
+} __attribute__((packed));
+
+/**
+ * Command table (128-byte header + PRDT)
+ */
+struct ahci_cmd_table {
+    uint8_t cfis[64];           /**< Command FIS */
+    uint8_t acmd[16];           /**< ATAPI command */
+    uint8_t reserved[48];
+    struct ahci_prd prdt[AHCI_PRDT_ENTRIES];
+} __attribute__((packed));
+
+/**
+ * Host to device register FIS
+ */
+struct ahci_fis_h2d {
+    uint8_t type;               /**< AHCI_FIS_REG_H2D */
+    uint8_t flags;              /**< AHCI_FIS_H2D_COMMAND */
+    uint8_t command;
+    uint8_t feature_low;        /**< NCQ: sector count 7:0 */
+    uint8_t lba0;
+    uint8_t lba1;
+    uint8_t lba2;
+    uint8_t device;
+    uint8_t lba3;
+    uint8_t lba4;
+    uint8_t lba5;
+    uint8_t feature_high;       /**< NCQ: sector count 15:8 */
+    uint8_t count_low;          /**< NCQ: tag << 3 */
+    uint8_t count_high;
+    uint8_t icc;
+    uint8_t control;
+    uint8_t reserved[4];
+} __attribute__((packed));
+
+/* ==================== AHCI FUNCTIONS ==================== */
+
+/**
+ * Find the AHCI controller and register a block device (sdN) per SATA disk
+ * @return true if at least one disk was found, false otherwise
+ */
+bool ahci_init(void);
+
+/**
+ * Get number of SATA disks found
+ * @return Disk count
+ */
+uint32_t ahci_disk_count(void);
+
+#endif /* _AHCI_H */
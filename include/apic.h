@@ -0,0 +1,154 @@
+/**************************************************************
+ * APIC Driver Header - BloodG OS
+ * Local APIC, I/O APIC and LAPIC timer
+ **************************************************************/
+
+#ifndef _APIC_H
+#define _APIC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ==================== LOCAL APIC REGISTERS ==================== */
+
+#define LAPIC_DEFAULT_BASE      0xFEE00000
+
+#define LAPIC_REG_ID            0x020
+#define LAPIC_REG_VERSION       0x030
+#define LAPIC_REG_TPR           0x080   // Task priority
+#define LAPIC_REG_EOI           0x0B0
+#define LAPIC_REG_SVR           0x0F0   // Spurious vector
+#define LAPIC_REG_ESR           0x280   // Error status
+#define LAPIC_REG_ICR_LOW       0x300   // Interrupt command
+#define LAPIC_REG_ICR_HIGH      0x310
+#define LAPIC_REG_LVT_TIMER     0x320
+#define LAPIC_REG_LVT_LINT0     0x350
+#define LAPIC_REG_LVT_LINT1     0x360
+#define LAPIC_REG_LVT_ERROR     0x370
+#define LAPIC_REG_TIMER_INIT    0x380   // Timer initial count
+#define LAPIC_REG_TIMER_CURRENT 0x390   // Timer current count
+#define LAPIC_REG_TIMER_DIVIDE  0x3E0
+
+#define LAPIC_SVR_ENABLE        0x100
+#define LAPIC_LVT_MASKED        0x10000
+#define LAPIC_LVT_NMI           0x400
+#define LAPIC_TIMER_ONESHOT     0x00000
+#define LAPIC_TIMER_PERIODIC    0x20000
+#define LAPIC_TIMER_DIV16       0x3
+
+// Interrupt command register (low word)
+#define LAPIC_ICR_FIXED         0x00000
+#define LAPIC_ICR_INIT          0x00500
+#define LAPIC_ICR_STARTUP       0x00600
+#define LAPIC_ICR_PENDING       0x01000 // Delivery status: send pending
+#define LAPIC_ICR_ASSERT        0x04000
+
+/* ==================== APIC VECTORS ==================== */
+
+#define APIC_LOCAL_VECTOR_BASE  0xF0    // LAPIC-sourced vectors, EOI'd by dispatch
+#define APIC_TIMER_VECTOR       0xF0
+#define APIC_ERROR_VECTOR       0xFE
+#define APIC_SPURIOUS_VECTOR    0xFF    // Never EOI'd
+
+// Longest LAPIC one-shot we arm (TSC keeps time in between)
+#define LAPIC_TIMER_MAX_NS      1000000000ULL
+
+/* ==================== APIC FUNCTIONS ==================== */
+
+/**
+ * Switch from the 8259 to LAPIC/IOAPIC if the MADT describes them
+ * (call after acpi_init and before any irq_register_handler)
+ * @return true if APIC mode is active, false if still on the 8259
+ */
+bool apic_init(void);
+
+/**
+ * Check if interrupts are routed through the APICs
+ * @return true if APIC mode is active
+ */
+bool apic_enabled(void);
+
+/**
+ * Read local APIC register
+ * @param reg Register offset
+ * @return Register value
+ */
+uint32_t lapic_read(uint32_t reg);
+
+/**
+ * Write local APIC register
+ * @param reg Register offset
+ * @param value Value to write
+ */
+void lapic_write(uint32_t reg, uint32_t value);
+
+/**
+ * Signal end of interrupt to the local APIC
+ */
+void lapic_eoi(void);
+
+/**
+ * Get local APIC ID of this CPU
+ * @return APIC ID
+ */
+uint8_t lapic_id(void);
+
+/**
+ * Enable the local APIC of an application processor
+ * (same setup as the BSP, without touching the I/O APICs)
+ */
+void lapic_init_ap(void);
+
+/**
+ * Send inter-processor interrupt and wait until the LAPIC accepts it
+ * @param apic_id Destination local APIC ID
+ * @param icr_low Delivery mode and vector (LAPIC_ICR_*)
+ */
+void lapic_send_ipi(uint8_t apic_id, uint32_t icr_low);
+
+/**
+ * Program ISA IRQ as level-triggered, active low from now on (PCI INTx
+ * lines routed onto ISA pins without an MADT override)
+ * @param irq ISA IRQ number (0-15)
+ */
+void ioapic_set_pci_irq(uint8_t irq);
+
+/**
+ * Route ISA IRQ through the I/O APIC and unmask it
+ * (always delivered to the BSP)
+ * @param irq ISA IRQ number (0-15)
+ */
+void ioapic_enable_irq(uint8_t irq);
+
+/**
+ * Mask ISA IRQ at the I/O APIC
+ * @param irq ISA IRQ number (0-15)
+ */
+void ioapic_disable_irq(uint8_t irq);
+
+/* ==================== LAPIC TIMER ==================== */
+
+/**
+ * Check if the LAPIC timer is calibrated and usable
+ * @return true if available
+ */
+bool lapic_timer_available(void);
+
+/**
+ * Fire APIC_TIMER_VECTOR once after a delay
+ * @param delta_ns Delay in nanoseconds (clamped to LAPIC_TIMER_MAX_NS)
+ */
+void lapic_timer_oneshot(uint64_t delta_ns);
+
+/**
+ * Cancel an armed LAPIC one-shot
+ */
+void lapic_timer_stop(void);
+
+/**
+ * Get LAPIC timer rate
+ * @return Timer counts per millisecond, or 0 if not calibrated
+ */
+uint32_t lapic_timer_khz(void);
+
+#endif /* _APIC_H */
@@ -7,6 +7,8 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "sync.h"
+#include "workqueue.h"
 
 /* ==================== ATA REGISTERS ==================== */
 
@@ -36,6 +38,9 @@
 #define ATA_SECONDARY_STATUS    0x177
 #define ATA_SECONDARY_ALT_STATUS 0x376
 
+#define ATA_CHANNELS            2
+#define ATA_MAX_DRIVES          4       /**< Master and slave on each channel */
+
 /* ==================== ATA STATUS BITS ==================== */
 
 #define ATA_SR_BSY      0x80    /**< Busy */
@@ -71,6 +76,61 @@
 #define ATA_CMD_CACHE_FLUSH     0xE7
 #define ATA_CMD_CACHE_FLUSH_EXT 0xEA
 #define ATA_CMD_IDENTIFY        0xEC
+#define ATA_CMD_READ_MULTIPLE   0xC4
+#define ATA_CMD_WRITE_MULTIPLE  0xC5
+#define ATA_CMD_SET_MULTIPLE    0xC6
+#define ATA_CMD_READ_MULTIPLE_EXT  0x29
+#define ATA_CMD_WRITE_MULTIPLE_EXT 0x39
+#define ATA_CMD_PACKET          0xA0
+#define ATA_CMD_IDENTIFY_PACKET 0xA1
+
+#define ATA_MAX_SECTORS         256     /**< Per LBA28 command (count 0) */
+#define ATA_MAX_SECTORS_EXT     65536   /**< Per LBA48 command (count 0) */
+#define ATA_LBA28_LIMIT         0x10000000ULL   /**< First LBA28 can't reach */
+
+/* ==================== BUS MASTER IDE ==================== */
+
+// Registers (offsets from PCI BAR4; secondary channel at +8)
+#define ATA_BM_CHANNEL_STRIDE   8
+#define ATA_BM_COMMAND          0x00
+#define ATA_BM_STATUS           0x02
+#define ATA_BM_PRDT             0x04
+
+#define ATA_BM_CMD_START        0x01    /**< Start/stop transfer */
+#define ATA_BM_CMD_READ         0x08    /**< Device to memory */
+
+#define ATA_BM_SR_ACTIVE        0x01    /**< Transfer in progress */
+#define ATA_BM_SR_ERR           0x02    /**< DMA error (write 1 to clear) */
+#define ATA_BM_SR_IRQ           0x04    /**< Drive interrupted (write 1 to clear) */
+#define ATA_BM_SR_DRV0_DMA      0x20    /**< Master is DMA capable */
+#define ATA_BM_SR_DRV1_DMA      0x40    /**< Slave is DMA capable */
+
+#define ATA_PRD_EOT             0x8000  /**< Last PRD entry */
+#define ATA_PRD_MAX             512     /**< Entries per table (one page) */
+#define ATA_DMA_MAX_SECTORS     ((ATA_PRD_MAX - 1) * 128)   /**< 64KB per entry, one spare for misalignment */
+
+#define ATA_PROG_IF_BUS_MASTER  0x80    /**< IDE function supports bus mastering */
+
+/* ==================== ATAPI ==================== */
+
+// IDENTIFY signature left in LBA mid/high by PACKET devices
+#define ATAPI_SIG_MID           0x14
+#define ATAPI_SIG_HIGH          0xEB
+
+#define ATAPI_SECTOR_SIZE       2048
+#define ATAPI_SECTOR_RATIO      4       /**< 512-byte block layer sectors per CD sector */
+#define ATAPI_PACKET_SIZE       12      /**< SCSI command bytes */
+#define ATAPI_BYTE_LIMIT        0xF800  /**< Bytes per DRQ block (31 CD sectors) */
+#define ATAPI_MAX_BLOCKS        64      /**< CD sectors per READ(10) */
+
+// SCSI commands sent in the packet
+#define ATAPI_CMD_READ_CAPACITY 0x25
+#define ATAPI_CMD_READ_10       0x28
+
+/* ==================== DEVICE CONTROL ==================== */
+
+#define ATA_CTL_NIEN            0x02    /**< Mask the drive's INTRQ */
+#define ATA_CTL_SRST            0x04    /**< Software reset */
 
 /* ==================== ATA DRIVE SELECTION ==================== */
 
@@ -78,16 +138,102 @@
 #define ATA_DRIVE_SLAVE         0xB0
 #define ATA_LBA_MODE            0x40
 
+/* ==================== ATA REQUESTS ==================== */
+
+struct ata_request;
+
+/**
+ * Async completion callback (runs in the kblockd worker thread)
+ * @param req Finished request; req->ok holds the result
+ */
+typedef void (*ata_callback_t)(struct ata_request* req);
+
+/**
+ * Queued disk request. Owned by the caller, who must keep it alive
+ * until the callback runs or ata_request_wait returns.
+ */
+struct ata_request {
+    uint32_t drive;             /**< 0-3: channel * 2 + slave */
+    uint64_t lba;               /**< First sector (ATAPI: multiple of 4) */
+    uint32_t count;             /**< Sectors (0 with write: cache flush only; ATAPI: multiple of 4) */
+    uint8_t* buffer;            /**< Data, count * 512 bytes */
+    bool write;                 /**< Direction */
+    ata_callback_t callback;    /**< NULL: wait with ata_request_wait */
+    void* arg;                  /**< For the callback */
+    volatile bool ok;           /**< Result, valid once finished */
+    
+    // Driver private
+    volatile bool finished;
+    uint32_t done;              // Sectors of finished commands
+    uint32_t chunk;             // Sectors in the command on the wire
+    uint32_t moved;             // PIO: sectors of chunk moved so far (ATAPI: bytes)
+    uint8_t state;
+    bool dma;
+    struct completion completion;
+    struct work work;
+    struct ata_request* next;
+};
+
 /* ==================== ATA FUNCTIONS ==================== */
 
 /**
- * Initialize ATA controller
- * @return true if successful, false otherwise
+ * Probe both channels for master and slave drives (ATA disks become hdN,
+ * ATAPI CD/DVD drives read-only cdN block devices)
+ * @return true if at least one drive was found, false otherwise
  */
 bool ata_init(void);
 
 /**
- * Read sector from disk (LBA addressing)
+ * Prepare a request
+ * @param req Request
+ * @param drive Drive number (0-3)
+ * @param lba First sector
+ * @param count Number of sectors
+ * @param buffer Data buffer
+ * @param write true to write, false to read
+ * @param callback Async completion, or NULL to wait with ata_request_wait
+ * @param arg Passed through in req->arg
+ */
+void ata_request_init(struct ata_request* req, uint32_t drive, uint64_t lba, uint32_t count,
+                      uint8_t* buffer, bool write, ata_callback_t callback, void* arg);
+
+/**
+ * Queue request on its drive's channel (returns at once; the channel
+ * interrupt drives it, and the two channels run independently)
+ * @param req Initialized request
+ * @return true if queued, false if no drive (callback is not called)
+ */
+bool ata_submit(struct ata_request* req);
+
+/**
+ * Sleep until a callback-less request finishes (cancels it on timeout)
+ * @param req Submitted request
+ * @return true if successful, false otherwise
+ */
+bool ata_request_wait(struct ata_request* req);
+
+/**
+ * Read sectors from a drive
+ * @param drive Drive number (0-3)
+ * @param lba Starting LBA
+ * @param count Number of sectors to read
+ * @param buffer Destination buffer
+ * @return true if successful, false otherwise
+ */
+bool ata_read(uint32_t drive, uint64_t lba, uint32_t count, uint8_t* buffer);
+
+/**
+ * Write sectors to a drive (left in the drive's write cache; see ata_flush_cache)
+ * @param drive Drive number (0-3)
+ * @param lba Starting LBA
+ * @param count Number of sectors to write
+ * @param buffer Source buffer
+ * @return true if successful, false otherwise
+ */
+bool ata_write(uint32_t drive, uint64_t lba, uint32_t count, uint8_t* buffer);
+
+/**
+ * Read sector from the boot drive (LBA addressing)
  * @param lba Logical Block Address
  * @param buffer Destination buffer (must be at least 512 bytes)
  * @return true if successful, false otherwise
@@ -95,7 +241,7 @@ bool ata_init(void);
 bool disk_read_sector(uint32_t lba, uint8_t* buffer);
 
 /**
- * Write sector to disk (LBA addressing)
+ * Write sector to the boot drive (LBA addressing, no cache flush)
  * @param lba Logical Block Address
  * @param buffer Source buffer (must be at least 512 bytes)
  * @return true if successful, false otherwise
@@ -103,22 +249,23 @@ bool disk_read_sector(uint32_t lba, uint8_t* buffer);
 bool disk_write_sector(uint32_t lba, uint8_t* buffer);
 
 /**
- * Read multiple sectors
+ * Read multiple sectors from the boot drive (LBA48 commands past 128GiB or above
+ * ATA_MAX_SECTORS, when the drive has them)
  * @param lba Starting LBA
  * @param count Number of sectors to read
  * @param buffer Destination buffer
  * @return true if successful, false otherwise
  */
-bool disk_read_sectors(uint32_t lba, uint8_t count, uint8_t* buffer);
+bool disk_read_sectors(uint64_t lba, uint32_t count, uint8_t* buffer);
 
 /**
- * Write multiple sectors
+ * Write multiple sectors to the boot drive (no cache flush)
  * @param lba Starting LBA
  * @param count Number of sectors to write
  * @param buffer Source buffer
  * @return true if successful, false otherwise
  */
-bool disk_write_sectors(uint32_t lba, uint8_t count, uint8_t* buffer);
+bool disk_write_sectors(uint64_t lba, uint32_t count, uint8_t* buffer);
 
 /**
  * Identify ATA device
@@ -128,10 +275,24 @@ bool disk_write_sectors(uint32_t lba, uint8_t count, uint8_t* buffer);
 bool ata_identify(uint16_t* buffer);
 
 /**
- * Check if drive is ready
+ * Check if drive is present
+ * @param drive Drive number (0-3)
  * @return true if ready, false otherwise
  */
-bool ata_drive_ready(void);
+bool ata_drive_ready(uint32_t drive);
+
+/**
+ * Get a drive's block device name
+ * @param drive Drive number (0-3)
+ * @return "hdN" or "cdN" (ATAPI), NULL if no drive
+ */
+const char* ata_drive_name(uint32_t drive);
+
+/**
+ * Get the drive behind the disk_* calls (first one found)
+ * @return Drive number, or -1 if none
+ */
+int ata_boot_drive(void);
 
 /**
  * Wait for drive to be ready
@@ -147,17 +308,38 @@ bool ata_wait_data_request(void);
 
 /**
  * Flush drive cache
+ * @param drive Drive number (0-3)
  * @return true if successful, false otherwise
  */
-bool ata_flush_cache(void);
+bool ata_flush_cache(uint32_t drive);
+
+/**
+ * Check if bus-master DMA was set up at init
+ * @return true if DMA transfers are possible
+ */
+bool ata_dma_available(void);
+
+/**
+ * Choose DMA or PIO for later transfers
+ * @param enable true for DMA (ignored if unavailable)
+ * @return true if DMA is now in use
+ */
+bool ata_set_dma(bool enable);
+
+/**
+ * Check if transfers currently use DMA
+ * @return true if DMA is in use
+ */
+bool ata_dma_enabled(void);
 
 /**
  * Get drive information
+ * @param drive Drive number (0-3)
  * @param model Output: model string (41 characters max)
  * @param serial Output: serial string (20 characters max)
  * @param sectors Output: total sectors
  * @return true if successful, false otherwise
  */
-bool ata_get_drive_info(char* model, char* serial, uint32_t* sectors);
+bool ata_get_drive_info(uint32_t drive, char* model, char* serial, uint64_t* sectors);
 
 #endif // _ATA_H
@@ -0,0 +1,268 @@
+/**************************************************************
+ * Block Device Header - BloodG OS
+ * Controller-independent sector I/O with an elevator queue
+ **************************************************************/
+
+#ifndef _BLOCK_H
+#define _BLOCK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "spinlock.h"
+#include "sync.h"
+#include "workqueue.h"
+
+/* ==================== BLOCK CONSTANTS ==================== */
+
+#define BLOCK_SECTOR_SIZE   512
+#define BLOCK_NAME_LEN      8
+#define BLOCK_BOUNCE_SECTORS 128    // Largest merge of scattered buffers (64KB)
+#define BLOCK_MAX_TAGS      32      // Commands in flight per device (NCQ limit)
+#define BLOCK_TIMEOUT_NS    (5ULL * 1000000000ULL)  // In-flight limit before abort
+#define BLOCK_WAIT_RETRIES  3       // Timeouts a still-queued bio waits before it fails
+
+/* ==================== BLOCK TYPES ==================== */
+
+struct bio;
+struct block_device;
+
+/**
+ * Completion callback (runs in the driver's completion context,
+ * usually a work queue thread; must not wait for other bios)
+ */
+typedef void (*bio_end_t)(struct bio* bio);
+
+/**
+ * One contiguous sector transfer submitted by a filesystem
+ */
+struct bio {
+    uint64_t sector;            /**< First sector */
+    uint32_t count;             /**< Sectors */
+    uint8_t* buffer;            /**< count * BLOCK_SECTOR_SIZE bytes */
+    bool write;                 /**< Direction */
+    bool flush;                 /**< Cache flush + barrier (count 0) */
+    bio_end_t end_io;           /**< Called when done (NULL: use bio_wait) */
+    void* private;              /**< For end_io */
+    bool ok;                    /**< Result, valid once finished */
+
+    // Block layer private
+    volatile bool finished;
+    uint32_t epoch;             /**< Barriers submitted before this bio */
+    struct block_device* dev;
+    struct completion completion;
+    struct bio* next;           /**< Queue / in-flight chain link */
+};
+
+/**
+ * Driver entry points
+ */
+struct block_ops {
+    /**
+     * Start one transfer; the driver calls block_complete() with the same
+     * tag (0 to queue_depth - 1) when it ends
+     * @return false if it could not be started (no block_complete follows)
+     */
+    bool (*submit)(struct block_device* dev, uint32_t tag, uint64_t sector,
+                   uint32_t count, uint8_t* buffer, bool write);
+
+    /**
+     * Start a write cache flush, completed like submit (optional:
+     * without it flushes only order the queue)
+     */
+    bool (*flush)(struct block_device* dev, uint32_t tag);
+
+    /**
+     * Kill a transfer in flight (optional: without it, or when it fails,
+     * the bios fail anyway and the tag is held until block_complete)
+     * @return true if it was killed (no block_complete follows for tag)
+     */
+    bool (*abort)(struct block_device* dev, uint32_t tag);
+
+    /**
+     * Tell the device about the commands just started (optional: lets a
+     * driver notify once per dispatch burst instead of once per command)
+     */
+    void (*kick)(struct block_device* dev);
+};
+
+/**
+ * Queue statistics
+ */
+struct block_stats {
+    uint32_t bios;              /**< Bios submitted */
+    uint32_t requests;          /**< Commands sent to the driver */
+    uint32_t merged;            /**< Bios folded into another bio's command */
+    uint32_t bounced;           /**< Commands that went through the bounce buffer */
+    uint32_t flushes;           /**< Cache flushes sent */
+    uint32_t errors;            /**< Failed commands */
+    uint32_t aborted;           /**< Commands killed after BLOCK_TIMEOUT_NS */
+    uint32_t max_depth;         /**< Most bios ever waiting */
+    uint32_t max_in_flight;     /**< Most commands ever in flight at once */
+    uint64_t depth_sum;         /**< Queue depth seen by each submit (for the average) */
+    uint64_t sectors;           /**< Sectors transferred */
+};
+
+/**
+ * Command handed to the driver
+ */
+struct block_cmd {
+    struct bio* bios;           /**< Merged bios (NULL: tag free unless orphaned) */
+    uint64_t ns;                /**< When it was sent */
+    bool bounced;               /**< Data went through bounce */
+    bool flush;                 /**< Cache flush (runs alone) */
+    bool orphaned;              /**< Bios failed after abort did not work; the tag
+                                     stays busy until the driver completes it */
+};
+
+/**
+ * Disk (or partition) registered by a driver
+ */
+struct block_device {
+    char name[BLOCK_NAME_LEN];      /**< e.g. "hd0" */
+    const struct block_ops* ops;    /**< Driver entry points */
+    void* private;                  /**< Driver data */
+    uint64_t sectors;               /**< Capacity */
+    uint32_t max_sectors;           /**< Merges stop at this size (drivers split bigger bios) */
+    uint32_t queue_depth;           /**< Commands the driver takes at once (0 means 1) */
+
+    // Block layer private
+    spinlock_t lock;                /**< Guards the queue and the in-flight state */
+    struct bio* queue;              /**< Waiting bios, sorted by sector */
+    uint32_t depth;                 /**< Bios in queue */
+    struct block_cmd cmds[BLOCK_MAX_TAGS];  /**< Commands in flight, by tag */
+    uint32_t busy_tags;             /**< Bit per tag in use */
+    uint32_t in_flight;             /**< Commands in flight */
+    uint32_t active_epoch;          /**< Epoch of the commands in flight */
+    bool flushing;                  /**< A flush is in flight (runs alone) */
+    bool bounce_busy;               /**< A command owns the bounce buffer */
+    uint64_t position;              /**< Sector after the last command (elevator) */
+    uint32_t epoch;                 /**< Barriers submitted so far */
+    uint8_t* bounce;                /**< BLOCK_BOUNCE_SECTORS sectors, or NULL */
+    struct block_stats stats;
+    volatile uint32_t registered;
+    struct block_device* next;      /**< Device list link */
+};
+
+/* ==================== BLOCK FUNCTIONS ==================== */
+
+/**
+ * Add device to the device list (name, ops, sectors, max_sectors and
+ * queue_depth set)
+ * @param dev Device
+ * @return true if registered (or already was)
+ */
+bool block_register(struct block_device* dev);
+
+/**
+ * Find device by name
+ * @param name Device name
+ * @return Device, or NULL if none
+ */
+struct block_device* block_get(const char* name);
+
+/**
+ * Get first registered device (the boot disk registers first)
+ * @return Device, or NULL if none
+ */
+struct block_device* block_first(void);
+
+/**
+ * Prepare a bio
+ * @param bio Bio
+ * @param sector First sector
+ * @param count Number of sectors
+ * @param buffer Data buffer
+ * @param write true to write, false to read
+ * @param end_io Callback, or NULL to wait with bio_wait()
+ * @param private Passed through to end_io
+ */
+void bio_init(struct bio* bio, uint64_t sector, uint32_t count, uint8_t* buffer,
+              bool write, bio_end_t end_io, void* private);
+
+/**
+ * Prepare a flush bio: a barrier that also empties the drive's write cache.
+ * Bios submitted before it complete before it starts; bios submitted after
+ * it start after it completes.
+ * @param bio Bio
+ * @param end_io Callback, or NULL to wait with bio_wait()
+ * @param private Passed through to end_io
+ */
+void bio_init_flush(struct bio* bio, bio_end_t end_io, void* private);
+
+/**
+ * Queue bio (sorted by sector between barriers, merged with neighbours at
+ * dispatch). Writes complete once the drive has them, possibly only in its
+ * write cache: use a flush where ordering on the medium matters.
+ * @param dev Device
+ * @param bio Bio
+ * @return true if queued, false if out of range
+ */
+bool block_submit(struct block_device* dev, struct bio* bio);
+
+/**
+ * Block until a callback-less bio finishes (fails it once it has been
+ * stuck for a few BLOCK_TIMEOUT_NS periods)
+ * @param bio Bio
+ * @return true if successful, false otherwise
+ */
+bool bio_wait(struct bio* bio);
+
+/**
+ * Queue a driver's completion work on kblockd, the block layer's own
+ * worker (never events/0: shell commands there sleep in bio_wait)
+ * @param work Work item that ends up calling block_complete()
+ * @return true if queued, false if it was already pending
+ */
+bool block_schedule(struct work* work);
+
+/**
+ * Called by the driver when a command started by ops->submit/flush ends
+ * (process context, normally kblockd: it may start the next command)
+ * @param dev Device
+ * @param tag Tag passed to ops->submit/flush
+ * @param ok Result
+ */
+void block_complete(struct block_device* dev, uint32_t tag, bool ok);
+
+/**
+ * Synchronous read
+ * @param dev Device
+ * @param sector First sector
+ * @param count Number of sectors
+ * @param buffer Destination buffer
+ * @return true if successful, false otherwise
+ */
+bool block_read(struct block_device* dev, uint64_t sector, uint32_t count, uint8_t* buffer);
+
+/**
+ * Synchronous write
+ * @param dev Device
+ * @param sector First sector
+ * @param count Number of sectors
+ * @param buffer Source buffer
+ * @return true if successful, false otherwise
+ */
+bool block_write(struct block_device* dev, uint64_t sector, uint32_t count, uint8_t* buffer);
+
+/**
+ * Wait for everything submitted so far and flush the drive's write cache
+ * @param dev Device
+ * @return true if successful, false otherwise
+ */
+bool block_flush(struct block_device* dev);
+
+/**
+ * Snapshot of a device's counters
+ * @param dev Device
+ * @return Statistics
+ */
+struct block_stats block_get_stats(struct block_device* dev);
+
+/**
+ * Zero a device's counters
+ * @param dev Device
+ */
+void block_reset_stats(struct block_device* dev);
+
+#endif /* _BLOCK_H */
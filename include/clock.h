@@ -0,0 +1,84 @@
+/**************************************************************
+ * Monotonic Clock Header - BloodG OS
+ * TSC-based nanosecond clock calibrated against HPET or PIT
+ **************************************************************/
+
+#ifndef _CLOCK_H
+#define _CLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ==================== CLOCK CONSTANTS ==================== */
+
+#define NSEC_PER_USEC       1000U
+#define NSEC_PER_MSEC       1000000U
+#define NSEC_PER_SEC        1000000000U
+
+#define CLOCK_CALIBRATE_MS  10      // Length of one calibration window
+#define CLOCK_CALIBRATE_RUNS 3      // Best of N windows
+
+/* ==================== CLOCK FUNCTIONS ==================== */
+
+/**
+ * Detect TSC and calibrate it against PIT channel 2
+ * @return true if the TSC is used, false if falling back to timer ticks
+ */
+bool clock_init(void);
+
+/**
+ * Get monotonic time since clock_init()
+ * @return Nanoseconds
+ */
+uint64_t clock_ns(void);
+
+/**
+ * Get monotonic time since clock_init()
+ * @return Microseconds
+ */
+uint64_t clock_us(void);
+
+/**
+ * Get monotonic time since clock_init()
+ * @return Milliseconds
+ */
+uint64_t clock_ms(void);
+
+/**
+ * Convert TSC cycles to nanoseconds
+ * @param cycles Cycle count
+ * @return Nanoseconds
+ */
+uint64_t clock_cycles_to_ns(uint64_t cycles);
+
+/**
+ * Get calibrated TSC frequency
+ * @return Frequency in kHz (0 if no TSC)
+ */
+uint32_t clock_tsc_khz(void);
+
+/**
+ * Check if TSC rate is constant across P/C-states
+ * @return true if invariant TSC is reported by CPUID
+ */
+bool clock_tsc_invariant(void);
+
+/**
+ * Check if clock_ns() has sub-tick resolution (TSC or HPET)
+ * @return true if high resolution, false if derived from timer ticks
+ */
+bool clock_highres(void);
+
+/* ==================== UTILITY FUNCTIONS ==================== */
+
+/**
+ * Read Time Stamp Counter
+ * @return Current TSC value
+ */
+static inline uint64_t rdtsc(void) {
+    uint32_t low, high;
+    asm volatile ("rdtsc" : "=a"(low), "=d"(high));
+    return ((uint64_t)high << 32) | low;
+}
+
+#endif /* _CLOCK_H */
@@ -143,4 +143,23 @@ uint32_t fat12_get_total_space(void);
  */
 bool fat12_get_fs_info(uint32_t* total_clusters, uint32_t* free_clusters, uint32_t* used_clusters);
 
+/**
+ * FAT consistency check results
+ */
+typedef struct {
+    uint32_t clusters;      // Data clusters checked
+    uint32_t free;          // Free clusters
+    uint32_t chains;        // End-of-chain markers (one per file/directory)
+    uint32_t bad;           // Clusters marked bad
+    uint32_t invalid;       // Links out of range or into free clusters
+    uint32_t crosslinked;   // Clusters linked from more than one place
+} fat12_check_t;
+
+/**
+ * Verify every FAT chain link (split across CPUs with parallel_for)
+ * @param result Output: check results
+ * @return true if no invalid or cross-linked clusters were found
+ */
+bool fat12_verify_chains(fat12_check_t* result);
+
 #endif // _FAT12_H
@@ -0,0 +1,96 @@
+/**************************************************************
+ * HPET Driver Header - BloodG OS
+ * High Precision Event Timer counter and timer 0 events
+ **************************************************************/
+
+#ifndef _HPET_H
+#define _HPET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ==================== HPET REGISTERS ==================== */
+
+#define HPET_REG_CAPS           0x000   // Capabilities and ID
+#define HPET_REG_CONFIG         0x010   // General configuration
+#define HPET_REG_INT_STATUS     0x020   // General interrupt status
+#define HPET_REG_COUNTER        0x0F0   // Main counter
+#define HPET_REG_TIMER_CONFIG(n)  (0x100 + 0x20 * (n))
+#define HPET_REG_TIMER_CMP(n)     (0x108 + 0x20 * (n))
+
+// Capabilities
+#define HPET_CAP_COUNT_64       (1 << 13)
+#define HPET_CAP_LEGACY_ROUTE   (1 << 15)
+
+// General configuration
+#define HPET_CFG_ENABLE         (1 << 0)
+#define HPET_CFG_LEGACY         (1 << 1)    // Timer 0 -> IRQ0, timer 1 -> IRQ8
+
+// Timer configuration
+#define HPET_TN_INT_ENABLE      (1 << 2)
+#define HPET_TN_PERIODIC        (1 << 3)
+#define HPET_TN_PERIODIC_CAP    (1 << 4)
+#define HPET_TN_VAL_SET         (1 << 6)
+#define HPET_TN_32BIT           (1 << 8)    // Compare against low 32 bits
+
+// Longest one-shot we arm (keeps the 32-bit comparator far from wrap)
+#define HPET_ONESHOT_MAX_NS     1000000000ULL
+
+/* ==================== HPET FUNCTIONS ==================== */
+
+/**
+ * Find HPET through ACPI and start its main counter
+ * (call after acpi_init)
+ * @return true if a usable HPET was found, false otherwise
+ */
+bool hpet_init(void);
+
+/**
+ * Check if HPET is present and running
+ * @return true if available
+ */
+bool hpet_available(void);
+
+/**
+ * Read main counter
+ * @return Counter value
+ */
+uint64_t hpet_counter(void);
+
+/**
+ * Get counter frequency
+ * @return Frequency in Hz, or 0 if not available
+ */
+uint32_t hpet_frequency(void);
+
+/**
+ * Convert counter value to nanoseconds
+ * @param count Counter ticks
+ * @return Nanoseconds
+ */
+uint64_t hpet_ticks_to_ns(uint64_t count);
+
+/**
+ * Check if timer 0 can drive IRQ0 in place of the PIT
+ * @return true if legacy replacement and periodic mode are supported
+ */
+bool hpet_event_available(void);
+
+/**
+ * Route timer 0 to IRQ0 (disconnects PIT channel 0)
+ */
+void hpet_event_enable(void);
+
+/**
+ * Fire IRQ0 periodically
+ * @param period_ns Period in nanoseconds
+ */
+void hpet_event_periodic(uint64_t period_ns);
+
+/**
+ * Fire IRQ0 once after a delay
+ * @param delta_ns Delay in nanoseconds (clamped to HPET_ONESHOT_MAX_NS)
+ */
+void hpet_event_oneshot(uint64_t delta_ns);
+
+#endif /* _HPET_H */
@@ -0,0 +1,61 @@
+/**************************************************************
+ * Idle Loop Header - BloodG OS
+ * hlt-based idle with idle/busy accounting
+ **************************************************************/
+
+#ifndef _IDLE_H
+#define _IDLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ==================== IDLE STATISTICS ==================== */
+
+/**
+ * Idle accounting (measured with the monotonic clock)
+ */
+struct idle_stats {
+    uint64_t idle_ns;       /**< Time spent halted */
+    uint64_t busy_ns;       /**< Time spent running */
+    uint32_t halts;         /**< Number of times the CPU was halted */
+    uint32_t wakeups;       /**< Halts skipped because work was pending */
+};
+
+/* ==================== IDLE FUNCTIONS ==================== */
+
+/**
+ * Halt until the next interrupt, unless work was queued since the last call
+ * (yields instead when other threads are ready)
+ */
+void idle_wait(void);
+
+/**
+ * Halt once with idle accounting (used by the scheduler when every
+ * thread is blocked; interrupts must be off, and are off again on return)
+ */
+void idle_halt(void);
+
+/**
+ * Mark work as pending so the next idle_wait() does not halt
+ * (safe to call from interrupt handlers)
+ */
+void idle_kick(void);
+
+/**
+ * Check if the CPU is currently halted in idle_wait()
+ * @return true if idle, false otherwise
+ */
+bool idle_is_idle(void);
+
+/**
+ * Get idle accounting
+ * @return Idle statistics
+ */
+struct idle_stats idle_get_stats(void);
+
+/**
+ * Reset idle accounting
+ */
+void idle_reset_stats(void);
+
+#endif /* _IDLE_H */
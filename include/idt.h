@@ -0,0 +1,169 @@
+/**************************************************************
+ * Interrupt Descriptor Table Header - BloodG OS
+ * IDT setup, exception and IRQ dispatch
+ **************************************************************/
+
+#ifndef _IDT_H
+#define _IDT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ==================== IDT CONSTANTS ==================== */
+
+#define IDT_ENTRIES         256
+#define IDT_KERNEL_CS       0x08    // Code selector set up by boot.asm
+#define IDT_KERNEL_DS       0x10    // Data selector set up by boot.asm
+#define IDT_GATE_INT32      0x8E    // Present, DPL 0, 32-bit interrupt gate
+
+#define EXCEPTION_COUNT     32      // Vectors 0-31 are CPU exceptions
+
+/* ==================== IRQ NUMBERS ==================== */
+
+#define IRQ_BASE            0x20    // IRQ 0 is remapped to this vector
+#define IRQ_COUNT           16
+#define IRQ_VECTOR(irq)     (IRQ_BASE + (irq))
+
+#define IRQ_TIMER           0
+#define IRQ_KEYBOARD        1
+#define IRQ_CASCADE         2
+#define IRQ_COM2            3
+#define IRQ_COM1            4
+#define IRQ_RTC             8
+#define IRQ_ATA_PRIMARY     14
+#define IRQ_ATA_SECONDARY   15
+
+#define IRQ_SHARED_MAX      8       // Handlers on shared PCI lines, all lines
+
+/* ==================== INTERRUPT FRAME ==================== */
+
+/**
+ * Register state pushed by boot/interrupts.asm
+ */
+struct interrupt_frame {
+    uint32_t ds;                                    /**< Saved data segment */
+    uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax; /**< pusha */
+    uint32_t vector;                                /**< Interrupt vector */
+    uint32_t error_code;                            /**< Error code or 0 */
+    uint32_t eip, cs, eflags;                       /**< Pushed by CPU */
+};
+
+/**
+ * Per-vector statistics
+ */
+struct interrupt_stats {
+    uint32_t count;             /**< Times the vector fired */
+    uint32_t spurious;          /**< Spurious IRQ7/15 or LAPIC spurious */
+    uint32_t handled;           /**< Times a handler ran timed (TSC present) */
+    uint64_t total_cycles;      /**< Handler TSC cycles (for average) */
+    uint32_t min_cycles;        /**< Fastest handler run */
+    uint32_t max_cycles;        /**< Slowest handler run */
+};
+
+/**
+ * Interrupt handler callback
+ */
+typedef void (*interrupt_handler_t)(struct interrupt_frame* frame);
+
+/* ==================== IDT FUNCTIONS ==================== */
+
+/**
+ * Build and load the IDT (all 256 vectors point to assembly stubs)
+ */
+void idt_init(void);
+
+/**
+ * Load the shared IDT on the calling CPU (application processors)
+ */
+void idt_load(void);
+
+/**
+ * Register handler for any vector
+ * @param vector Interrupt vector (0-255)
+ * @param handler Handler function
+ * @return true if registered, false if vector already taken
+ */
+bool interrupt_register_handler(uint8_t vector, interrupt_handler_t handler);
+
+/**
+ * Remove handler for vector
+ * @param vector Interrupt vector (0-255)
+ */
+void interrupt_unregister_handler(uint8_t vector);
+
+/**
+ * Register handler for hardware IRQ and unmask it
+ * @param irq IRQ number (0-15)
+ * @param handler Handler function
+ * @return true if registered, false otherwise
+ */
+bool irq_register_handler(uint8_t irq, interrupt_handler_t handler);
+
+/**
+ * Add handler to a shared PCI INTx line; the first one programs the line
+ * level-triggered, active low and unmasks it. Every handler on the line
+ * runs for each interrupt and must check its own device for work.
+ * @param irq IRQ number (0-15)
+ * @param handler Handler function
+ * @return true if registered, false if the line is held exclusively
+ *         or no slot is free
+ */
+bool irq_register_shared(uint8_t irq, interrupt_handler_t handler);
+
+/**
+ * Mask hardware IRQ and remove its handler (all of them if shared)
+ * @param irq IRQ number (0-15)
+ */
+void irq_unregister_handler(uint8_t irq);
+
+/**
+ * Unmask hardware IRQ (I/O APIC if active, 8259 otherwise)
+ * @param irq IRQ number (0-15)
+ */
+void irq_enable(uint8_t irq);
+
+/**
+ * Mask hardware IRQ (I/O APIC if active, 8259 otherwise)
+ * @param irq IRQ number (0-15)
+ */
+void irq_disable(uint8_t irq);
+
+/**
+ * Send end of interrupt (LAPIC if active, 8259 otherwise)
+ * @param irq IRQ number (0-15)
+ */
+void irq_send_eoi(uint8_t irq);
+
+/**
+ * Get number of times a vector has fired
+ * @param vector Interrupt vector (0-255)
+ * @return Interrupt count since boot
+ */
+uint32_t interrupt_get_count(uint8_t vector);
+
+/**
+ * Get statistics for a vector
+ * @param vector Interrupt vector (0-255)
+ * @return Snapshot of the vector's counters
+ */
+struct interrupt_stats interrupt_get_stats(uint8_t vector);
+
+/**
+ * Get source name of a vector (exception, IRQ or LAPIC source)
+ * @param vector Interrupt vector (0-255)
+ * @return Name string
+ */
+const char* interrupt_name(uint8_t vector);
+
+/**
+ * Reset all per-vector counters
+ */
+void interrupt_reset_counts(void);
+
+/**
+ * Common C entry point (called from boot/interrupts.asm)
+ * @param frame Saved register state
+ */
+void interrupt_dispatch(struct interrupt_frame* frame);
+
+#endif /* _IDT_H */
@@ -37,6 +37,22 @@ uint16_t inw(uint16_t port);
  */
 void outw(uint16_t port, uint16_t value);
 
+/**
+ * Read words from port into buffer (rep insw)
+ * @param port Port address
+ * @param buffer Destination buffer
+ * @param count Number of words
+ */
+void insw(uint16_t port, void* buffer, uint32_t count);
+
+/**
+ * Write words from buffer to port (rep outsw)
+ * @param port Port address
+ * @param buffer Source buffer
+ * @param count Number of words
+ */
+void outsw(uint16_t port, const void* buffer, uint32_t count);
+
 /**
  * Read double word from port
  * @param port Port address
@@ -149,8 +165,22 @@ void sti(void);
  */
 void halt(void);
 
+/**
+ * Disable interrupts and save previous state
+ * @return Previous EFLAGS (pass to irq_restore)
+ */
+uint32_t irq_save(void);
+
+/**
+ * Restore interrupt state saved by irq_save
+ * @param flags Value returned by irq_save
+ */
+void irq_restore(uint32_t flags);
+
 /* ==================== CPU CONTROL ==================== */
 
+#define EFLAGS_IF 0x200  // Interrupt enable flag
+
 /**
  * CPU wait (short delay for I/O)
  */
@@ -167,4 +197,28 @@ void memory_barrier(void);
  */
 uint32_t read_eflags(void);
 
+/**
+ * Execute CPUID (subleaf 0)
+ * @param leaf CPUID leaf
+ * @param eax Output EAX
+ * @param ebx Output EBX
+ * @param ecx Output ECX
+ * @param edx Output EDX
+ */
+void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx);
+
+/**
+ * Read model-specific register
+ * @param msr MSR index
+ * @return MSR value
+ */
+uint64_t read_msr(uint32_t msr);
+
+/**
+ * Write model-specific register
+ * @param msr MSR index
+ * @param value Value to write
+ */
+void write_msr(uint32_t msr, uint64_t value);
+
 #endif // _IO_H
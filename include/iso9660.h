@@ -0,0 +1,149 @@
+/**************************************************************
+ * ISO9660 Filesystem Header - BloodG OS
+ * Read-only CD filesystem with a directory cache
+ **************************************************************/
+
+#ifndef _ISO9660_H
+#define _ISO9660_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ==================== ISO9660 CONSTANTS ==================== */
+
+#define ISO9660_SECTOR_SIZE     2048
+#define ISO9660_FIRST_VD        16      /**< Volume descriptors start here */
+#define ISO9660_MAX_VD          16      /**< Descriptors scanned for the primary one */
+#define ISO9660_NAME_MAX        32      /**< Level 1/2 identifiers plus NUL */
+#define ISO9660_DIR_CACHE       8       /**< Parsed directories kept */
+#define ISO9660_DIR_MAX_BYTES   (64 * 1024)     /**< Larger directories are refused */
+#define ISO9660_READ_BATCH      16      /**< File bios queued before waiting */
+
+// Volume descriptor types
+#define ISO9660_VD_PRIMARY      1
+#define ISO9660_VD_TERMINATOR   255
+
+// Directory record flags
+#define ISO9660_FLAG_HIDDEN     0x01
+#define ISO9660_FLAG_DIRECTORY  0x02
+#define ISO9660_FLAG_ASSOCIATED 0x04
+#define ISO9660_FLAG_MULTI      0x80    /**< File continues in the next record */
+
+/* ==================== ISO9660 STRUCTURES ==================== */
+
+#pragma pack(push, 1)
+
+/**
+ * Directory record (numbers are stored both little and big endian)
+ */
+typedef struct {
+    uint8_t  length;            /**< Record length (0: rest of sector unused) */
+    uint8_t  ext_attr_length;   /**< Extended attribute sectors */
+    uint32_t extent;            /**< First sector (LE) */
+    uint32_t extent_be;
+    uint32_t size;              /**< Data length in bytes (LE) */
+    uint32_t size_be;
+    uint8_t  date[7];           /**< Recording date and time */
+    uint8_t  flags;             /**< ISO9660_FLAG_* */
+    uint8_t  unit_size;         /**< Interleaved files only */
+    uint8_t  gap_size;
+    uint16_t volume_seq;        /**< Volume sequence number (LE) */
+    uint16_t volume_seq_be;
+    uint8_t  name_length;       /**< Identifier length */
+    char     name[];            /**< Identifier ("\0" self, "\1" parent) */
+} iso9660_dir_record_t;
+
+/**
+ * Primary volume descriptor (first 190 bytes)
+ */
+typedef struct {
+    uint8_t  type;              /**< ISO9660_VD_PRIMARY */
+    char     id[5];             /**< "CD001" */
+    uint8_t  version;           /**< 1 */
+    uint8_t  unused0;
+    char     system_id[32];
+    char     volume_id[32];     /**< Volume label (space padded) */
+    uint8_t  unused1[8];
+    uint32_t volume_blocks;     /**< Volume size in logical blocks (LE) */
+    uint32_t volume_blocks_be;
+    uint8_t  unused2[32];
+    uint16_t set_size;
+    uint16_t set_size_be;
+    uint16_t sequence;
+    uint16_t sequence_be;
+    uint16_t block_size;        /**< Logical block size (LE, 2048) */
+    uint16_t block_size_be;
+    uint32_t path_table_size;
+    uint32_t path_table_size_be;
+    uint32_t path_table_l;
+    uint32_t path_table_l_opt;
+    uint32_t path_table_m;
+    uint32_t path_table_m_opt;
+    uint8_t  root[34];          /**< Root directory record */
+} iso9660_pvd_t;
+
+#pragma pack(pop)
+
+/**
+ * Parsed directory entry
+ */
+typedef struct {
+    char     name[ISO9660_NAME_MAX];    /**< Without ";1" version or trailing dot */
+    uint32_t extent;            /**< First 2048-byte sector */
+    uint32_t size;              /**< Bytes */
+    bool     directory;
+} iso9660_entry_t;
+
+/* ==================== ISO9660 FUNCTIONS ==================== */
+
+/**
+ * Mount the first block device holding an ISO9660 volume (and cache its
+ * root directory)
+ * @return true if successful, false otherwise
+ */
+bool iso9660_init(void);
+
+/**
+ * Check if an ISO9660 volume is mounted
+ * @return true if mounted, false otherwise
+ */
+bool iso9660_is_mounted(void);
+
+/**
+ * Get the volume label
+ * @return Label, empty if not mounted
+ */
+const char* iso9660_volume_label(void);
+
+/**
+ * Look up a path ("/" separated, case-insensitive, version optional)
+ * @param path File or directory path
+ * @param result Output: entry found
+ * @return true if found, false otherwise
+ */
+bool iso9660_find(const char* path, iso9660_entry_t* result);
+
+/**
+ * List a directory
+ * @param path Directory path (NULL or "" for the root)
+ */
+void iso9660_list_directory(const char* path);
+
+/**
+ * Read a whole file, queueing its sectors as a few large bios
+ * @param path File path
+ * @param buffer Destination buffer
+ * @param max_size Buffer size
+ * @param size Output: file size (may be NULL)
+ * @return true if successful, false otherwise
+ */
+bool iso9660_read_file(const char* path, uint8_t* buffer, uint32_t max_size, uint32_t* size);
+
+/**
+ * Get directory cache counters
+ * @param hits Output: lookups served from the cache
+ * @param misses Output: directories read from the disc
+ */
+void iso9660_get_cache_stats(uint32_t* hits, uint32_t* misses);
+
+#endif /* _ISO9660_H */
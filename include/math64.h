@@ -0,0 +1,44 @@
+/**************************************************************
+ * 64-bit Arithmetic Helpers - BloodG OS
+ * We link without libgcc, so 64-bit '/' and '%' are unavailable
+ **************************************************************/
+
+#ifndef _MATH64_H
+#define _MATH64_H
+
+#include <stdint.h>
+
+/**
+ * Divide 64-bit value by 32-bit divisor
+ * @param dividend Value to divide
+ * @param divisor Divisor (must be non-zero)
+ * @param remainder Output: remainder (may be NULL)
+ * @return Quotient
+ */
+static inline uint64_t div_u64_rem(uint64_t dividend, uint32_t divisor, uint32_t* remainder) {
+    uint32_t high = (uint32_t)(dividend >> 32);
+    uint32_t low = (uint32_t)dividend;
+    uint32_t q_high = high / divisor;
+    uint32_t rem = high % divisor;
+    uint32_t q_low;
+
+    // rem < divisor, so the 64/32 divl cannot overflow
+    asm ("divl %2" : "=a"(q_low), "=d"(rem) : "rm"(divisor), "a"(low), "d"(rem));
+
+    if (remainder) {
+        *remainder = rem;
+    }
+    return ((uint64_t)q_high << 32) | q_low;
+}
+
+/**
+ * Divide 64-bit value by 32-bit divisor
+ * @param dividend Value to divide
+ * @param divisor Divisor (must be non-zero)
+ * @return Quotient
+ */
+static inline uint64_t div_u64(uint64_t dividend, uint32_t divisor) {
+    return div_u64_rem(dividend, divisor, 0);
+}
+
+#endif /* _MATH64_H */
@@ -128,6 +128,7 @@ void memory_fill_pattern(void* ptr, size_t size, uint8_t pattern);
 
 /**
  * Calculate checksum of memory block
+ * (split across CPUs with parallel_for for large blocks)
  * @param ptr Pointer to memory
  * @param size Size in bytes
  * @return Checksum byte
@@ -0,0 +1,58 @@
+/**************************************************************
+ * Page Allocator Header - BloodG OS
+ * Bitmap allocator for 4KB physical pages
+ **************************************************************/
+
+#ifndef _PAGE_H
+#define _PAGE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* ==================== PAGE CONSTANTS ==================== */
+
+#define PAGE_SIZE           4096
+#define PAGE_SHIFT          12
+#define PAGE_MAX_MEMORY     (256 * 1024 * 1024)  // Highest address we manage
+
+/* ==================== PAGE FUNCTIONS ==================== */
+
+/**
+ * Size memory from CMOS and mark everything below the kernel end as used
+ */
+void page_init(void);
+
+/**
+ * Allocate physically contiguous pages
+ * @param count Number of pages
+ * @return Page-aligned address, or NULL if out of memory
+ */
+void* page_alloc(uint32_t count);
+
+/**
+ * Free pages returned by page_alloc
+ * @param addr Address returned by page_alloc
+ * @param count Number of pages
+ */
+void page_free(void* addr, uint32_t count);
+
+/**
+ * Mark a physical range as in use (firmware tables, MMIO)
+ * @param addr Start address
+ * @param size Size in bytes
+ */
+void page_reserve(uint32_t addr, uint32_t size);
+
+/**
+ * Get number of free pages
+ * @return Free page count
+ */
+uint32_t page_free_count(void);
+
+/**
+ * Get number of managed pages
+ * @return Total page count (including reserved)
+ */
+uint32_t page_total_count(void);
+
+#endif /* _PAGE_H */
@@ -0,0 +1,131 @@
+/**************************************************************
+ * PCI Header - BloodG OS
+ * Configuration space access (mechanism #1) and device lookup
+ **************************************************************/
+
+#ifndef _PCI_H
+#define _PCI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ==================== PCI REGISTERS ==================== */
+
+#define PCI_CONFIG_ADDRESS      0xCF8
+#define PCI_CONFIG_DATA         0xCFC
+
+// Configuration space offsets
+#define PCI_VENDOR_ID           0x00
+#define PCI_DEVICE_ID           0x02
+#define PCI_COMMAND             0x04
+#define PCI_STATUS              0x06
+#define PCI_PROG_IF             0x09
+#define PCI_SUBCLASS            0x0A
+#define PCI_CLASS               0x0B
+#define PCI_HEADER_TYPE         0x0E
+#define PCI_BAR(n)              (0x10 + 4 * (n))
+#define PCI_INTERRUPT_LINE      0x3C
+
+// Command register
+#define PCI_CMD_IO              (1 << 0)
+#define PCI_CMD_MEMORY          (1 << 1)
+#define PCI_CMD_BUS_MASTER      (1 << 2)
+
+// BAR bits
+#define PCI_BAR_IO              0x01
+#define PCI_BAR_IO_MASK         0xFFFFFFFC
+#define PCI_BAR_MEM_MASK        0xFFFFFFF0
+
+#define PCI_HEADER_MULTIFUNC    0x80
+#define PCI_VENDOR_NONE         0xFFFF
+
+// Classes we look for
+#define PCI_CLASS_STORAGE       0x01
+#define PCI_SUBCLASS_IDE        0x01
+
+/* ==================== PCI TYPES ==================== */
+
+/**
+ * Location and identity of one PCI function
+ */
+struct pci_device {
+    uint8_t bus;
+    uint8_t slot;
+    uint8_t func;
+    uint16_t vendor;
+    uint16_t device;
+    uint8_t class_code;
+    uint8_t subclass;
+    uint8_t prog_if;
+};
+
+/* ==================== PCI FUNCTIONS ==================== */
+
+/**
+ * Read 32-bit configuration register
+ * @param dev Device
+ * @param offset Register offset (dword aligned)
+ * @return Register value
+ */
+uint32_t pci_config_read32(const struct pci_device* dev, uint8_t offset);
+
+/**
+ * Read 16-bit configuration register
+ * @param dev Device
+ * @param offset Register offset (word aligned)
+ * @return Register value
+ */
+uint16_t pci_config_read16(const struct pci_device* dev, uint8_t offset);
+
+/**
+ * Read 8-bit configuration register
+ * @param dev Device
+ * @param offset Register offset
+ * @return Register value
+ */
+uint8_t pci_config_read8(const struct pci_device* dev, uint8_t offset);
+
+/**
+ * Write 32-bit configuration register
+ * @param dev Device
+ * @param offset Register offset (dword aligned)
+ * @param value Value to write
+ */
+void pci_config_write32(const struct pci_device* dev, uint8_t offset, uint32_t value);
+
+/**
+ * Write 16-bit configuration register
+ * @param dev Device
+ * @param offset Register offset (word aligned)
+ * @param value Value to write
+ */
+void pci_config_write16(const struct pci_device* dev, uint8_t offset, uint16_t value);
+
+/**
+ * Find the index'th function with the given class and subclass
+ * @param class_code Base class
+ * @param subclass Subclass
+ * @param index 0 for the first match, 1 for the second...
+ * @param dev Output: device found
+ * @return true if found, false otherwise
+ */
+bool pci_find_class(uint8_t class_code, uint8_t subclass, uint32_t index, struct pci_device* dev);
+
+/**
+ * Find the index'th function with the given vendor and device ID
+ * @param vendor Vendor ID
+ * @param device Device ID
+ * @param index 0 for the first match, 1 for the second...
+ * @param dev Output: device found
+ * @return true if found, false otherwise
+ */
+bool pci_find_device(uint16_t vendor, uint16_t device, uint32_t index, struct pci_device* dev);
+
+/**
+ * Set bits in the command register (e.g. PCI_CMD_BUS_MASTER)
+ * @param dev Device
+ * @param bits Command bits to enable
+ */
+void pci_enable(const struct pci_device* dev, uint16_t bits);
+
+#endif /* _PCI_H */
@@ -0,0 +1,95 @@
+/**************************************************************
+ * PIC (8259) Driver Header - BloodG OS
+ * Legacy interrupt controller interface
+ **************************************************************/
+
+#ifndef _PIC_H
+#define _PIC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ==================== PIC CONSTANTS ==================== */
+
+#define PIC1_OFFSET         0x20  // IRQ 0-7 -> INT 0x20-0x27
+#define PIC2_OFFSET         0x28  // IRQ 8-15 -> INT 0x28-0x2F
+
+/* ==================== PIC FUNCTIONS ==================== */
+
+/**
+ * Initialize PIC and remap IRQs to PIC1_OFFSET/PIC2_OFFSET
+ */
+void pic_init(void);
+
+/**
+ * Send End of Interrupt
+ * @param irq IRQ number (0-15)
+ */
+void pic_send_eoi(uint8_t irq);
+
+/**
+ * Disable PIC (mask all interrupts)
+ */
+void pic_disable(void);
+
+/**
+ * Unmask specific IRQ
+ * @param irq IRQ number (0-15)
+ */
+void pic_enable_irq(uint8_t irq);
+
+/**
+ * Mask specific IRQ
+ * @param irq IRQ number (0-15)
+ */
+void pic_disable_irq(uint8_t irq);
+
+/**
+ * Make IRQ level-triggered in the ELCR (PCI INTx lines only;
+ * IRQ 0, 1, 2, 8 and 13 must stay edge)
+ * @param irq IRQ number (0-15)
+ */
+void pic_set_level(uint8_t irq);
+
+/**
+ * Get Interrupt Request Register
+ * @return IRR of both PICs (PIC2 in high byte)
+ */
+uint16_t pic_get_irr(void);
+
+/**
+ * Get In-Service Register
+ * @return ISR of both PICs (PIC2 in high byte)
+ */
+uint16_t pic_get_isr(void);
+
+/**
+ * Check if IRQ7/IRQ15 is spurious (line dropped before acknowledge)
+ * @param irq IRQ number (0-15)
+ * @return true if spurious (must not be acknowledged with EOI)
+ */
+bool pic_is_spurious(uint8_t irq);
+
+/**
+ * Mask all interrupts except cascade (IRQ2)
+ */
+void pic_mask_all(void);
+
+/**
+ * Unmask all interrupts
+ */
+void pic_unmask_all(void);
+
+/**
+ * Get interrupt mask
+ * @return Mask of both PICs (PIC2 in high byte)
+ */
+uint16_t pic_get_mask(void);
+
+/**
+ * Set interrupt mask
+ * @param mask Mask of both PICs (PIC2 in high byte)
+ */
+void pic_set_mask(uint16_t mask);
+
+#endif /* _PIC_H */
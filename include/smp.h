@@ -0,0 +1,100 @@
+/**************************************************************
+ * SMP Header - BloodG OS
+ * Application processor bring-up and per-CPU data
+ **************************************************************/
+
+#ifndef _SMP_H
+#define _SMP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "acpi.h"
+
+/* ==================== SMP CONSTANTS ==================== */
+
+#define SMP_MAX_CPUS            ACPI_MAX_CPUS
+#define SMP_TRAMPOLINE_ADDR     0x8000  // Must match boot/trampoline.asm
+#define SMP_AP_STACK_PAGES      2       // 8KB per AP
+#define SMP_STARTUP_TIMEOUT_MS  200     // Per AP, after the second SIPI
+
+// Per-CPU GDT layout (same selectors on every CPU)
+#define GDT_KERNEL_CS           0x08
+#define GDT_KERNEL_DS           0x10
+#define GDT_PERCPU              0x18    // GS: base is this CPU's struct cpu
+#define GDT_ENTRIES             4
+
+// IPI that only ends an AP's hlt
+#define APIC_WAKEUP_VECTOR      0xF1
+
+/**
+ * Per-CPU data, reached through GS
+ */
+struct cpu {
+    struct cpu* self;               /**< Linear address of this struct (must be first) */
+    uint32_t index;                 /**< Logical CPU number (BSP is 0) */
+    uint8_t apic_id;                /**< Local APIC ID */
+    volatile bool online;           /**< Finished bring-up */
+    void* stack;                    /**< AP stack pages (NULL for BSP) */
+    volatile uint32_t wakeups;      /**< Wakeup IPIs received */
+    uint64_t gdt[GDT_ENTRIES];      /**< This CPU's GDT */
+};
+
+/* ==================== SMP FUNCTIONS ==================== */
+
+/**
+ * Load CPU 0's GDT and GS on the BSP (call early, before smp_this_cpu)
+ */
+void smp_early_init(void);
+
+/**
+ * Start every application processor listed in the MADT
+ * (call after apic_init, with interrupts still off)
+ * @return Number of CPUs online, including the BSP
+ */
+uint32_t smp_init(void);
+
+/**
+ * Get number of CPUs online
+ * @return Online CPU count
+ */
+uint32_t smp_cpu_count(void);
+
+/**
+ * Get online CPU bitmap (bit n = CPU index n)
+ * @return Online mask
+ */
+uint32_t smp_online_mask(void);
+
+/**
+ * Get CPU by index
+ * @param index CPU index (0 to SMP_MAX_CPUS-1)
+ * @return CPU, or NULL if it never came online
+ */
+struct cpu* smp_get_cpu(uint32_t index);
+
+/**
+ * Interrupt a halted CPU
+ * @param index Target CPU index
+ * @param vector Interrupt vector
+ */
+void smp_send_ipi(uint32_t index, uint8_t vector);
+
+/**
+ * Get the calling CPU's data
+ * @return This CPU
+ */
+static inline struct cpu* smp_this_cpu(void) {
+    struct cpu* cpu;
+    asm volatile ("mov %%gs:0, %0" : "=r"(cpu));
+    return cpu;
+}
+
+/**
+ * Get the calling CPU's index
+ * @return CPU index (0 for the BSP)
+ */
+static inline uint32_t smp_cpu_index(void) {
+    return smp_this_cpu()->index;
+}
+
+#endif /* _SMP_H */
@@ -0,0 +1,331 @@
+/**************************************************************
+ * Spinlock Header - BloodG OS
+ * Ticket spinlocks, reader-writer locks and seqlocks with
+ * per-lock contention statistics
+ **************************************************************/
+
+#ifndef _SPINLOCK_H
+#define _SPINLOCK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "io.h"
+
+/* ==================== LOCK STATISTICS ==================== */
+
+/**
+ * Lock kinds (for lockstat)
+ */
+enum lock_type {
+    LOCK_SPIN = 0,
+    LOCK_RW,
+    LOCK_SEQ,
+};
+
+/**
+ * Per-lock counters (registered on first acquisition)
+ */
+struct lock_stats {
+    const char* name;               /**< Shown by lockstat */
+    enum lock_type type;            /**< Lock kind */
+    volatile uint32_t registered;   /**< On the lockstat list */
+    uint32_t acquisitions;          /**< Times taken (writes for RW/seq) */
+    uint32_t contended;             /**< Acquisitions that had to spin */
+    uint64_t spins;                 /**< Total pause iterations */
+    uint32_t reads;                 /**< RW: read acquisitions (seq: not counted) */
+    uint32_t read_retries;          /**< RW: contended reads; seq: retried reads */
+    struct lock_stats* next;        /**< lockstat list link */
+};
+
+#define LOCK_STATS_INIT(name, type)     { name, type, 0, 0, 0, 0, 0, 0, NULL }
+
+/**
+ * Add lock to the lockstat list (called once per lock)
+ * @param stats Lock statistics
+ */
+void lockstat_register(struct lock_stats* stats);
+
+/**
+ * Get first registered lock
+ * @return Lock statistics, or NULL if none
+ */
+struct lock_stats* lockstat_first(void);
+
+/**
+ * Zero the counters of every registered lock
+ */
+void lockstat_reset(void);
+
+// Register on first use (cheap flag test afterwards)
+static inline void lockstat_touch(struct lock_stats* stats) {
+    if (!stats->registered) {
+        lockstat_register(stats);
+    }
+}
+
+static inline void cpu_relax(void) {
+    asm volatile ("pause" ::: "memory");
+}
+
+static inline void compiler_barrier(void) {
+    asm volatile ("" ::: "memory");
+}
+
+/* ==================== TICKET SPINLOCK ==================== */
+
+/**
+ * FIFO spinlock: take a ticket, wait until it is served
+ */
+typedef struct {
+    volatile uint16_t owner;        /**< Ticket being served */
+    volatile uint16_t next;         /**< Next ticket to hand out */
+    struct lock_stats stats;
+} spinlock_t;
+
+#define SPINLOCK_INIT(name)     { 0, 0, LOCK_STATS_INIT(name, LOCK_SPIN) }
+
+/**
+ * Initialize spinlock
+ * @param lock Lock
+ * @param name Name shown by lockstat
+ */
+static inline void spin_lock_init(spinlock_t* lock, const char* name) {
+    spinlock_t init = SPINLOCK_INIT(name);
+    *lock = init;
+}
+
+/**
+ * Acquire spinlock (interrupts untouched)
+ * @param lock Lock
+ */
+static inline void spin_lock(spinlock_t* lock) {
+    uint16_t ticket = __sync_fetch_and_add(&lock->next, 1);
+    uint32_t spins = 0;
+
+    while (lock->owner != ticket) {
+        cpu_relax();
+        spins++;
+    }
+
+    // Counters are protected by the lock itself
+    lockstat_touch(&lock->stats);
+    lock->stats.acquisitions++;
+    if (spins) {
+        lock->stats.contended++;
+        lock->stats.spins += spins;
+    }
+}
+
+/**
+ * Try to acquire spinlock without spinning
+ * @param lock Lock
+ * @return true if acquired
+ */
+static inline bool spin_trylock(spinlock_t* lock) {
+    uint16_t ticket = lock->next;
+    if (lock->owner != ticket ||
+        !__sync_bool_compare_and_swap(&lock->next, ticket, (uint16_t)(ticket + 1))) {
+        return false;
+    }
+
+    lockstat_touch(&lock->stats);
+    lock->stats.acquisitions++;
+    return true;
+}
+
+/**
+ * Release spinlock
+ * @param lock Lock
+ */
+static inline void spin_unlock(spinlock_t* lock) {
+    compiler_barrier();
+    lock->owner++;              // Only the holder writes owner; x86 stores release
+}
+
+/**
+ * Disable interrupts, then acquire spinlock
+ * @param lock Lock
+ * @return Saved EFLAGS for spin_unlock_irqrestore
+ */
+static inline uint32_t spin_lock_irqsave(spinlock_t* lock) {
+    uint32_t flags = irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+/**
+ * Release spinlock, then restore interrupts
+ * @param lock Lock
+ * @param flags Value returned by spin_lock_irqsave
+ */
+static inline void spin_unlock_irqrestore(spinlock_t* lock, uint32_t flags) {
+    spin_unlock(lock);
+    irq_restore(flags);
+}
+
+/* ==================== READER-WRITER LOCK ==================== */
+
+/**
+ * Many readers or one writer; waiting writers hold off new readers
+ */
+typedef struct {
+    volatile int32_t count;         /**< Readers inside, or -1 for a writer */
+    volatile uint32_t writers;      /**< Writers waiting */
+    struct lock_stats stats;
+} rwlock_t;
+
+#define RWLOCK_INIT(name)       { 0, 0, LOCK_STATS_INIT(name, LOCK_RW) }
+
+/**
+ * Initialize RW lock
+ * @param lock Lock
+ * @param name Name shown by lockstat
+ */
+static inline void rwlock_init(rwlock_t* lock, const char* name) {
+    rwlock_t init = RWLOCK_INIT(name);
+    *lock = init;
+}
+
+/**
+ * Acquire for reading
+ * @param lock Lock
+ */
+static inline void read_lock(rwlock_t* lock) {
+    bool waited = false;
+
+    while (1) {
+        int32_t count = lock->count;
+        if (count >= 0 && !lock->writers &&
+            __sync_bool_compare_and_swap(&lock->count, count, count + 1)) {
+            break;
+        }
+        waited = true;
+        cpu_relax();
+    }
+
+    // Readers run concurrently, so their counters need atomics
+    lockstat_touch(&lock->stats);
+    __sync_fetch_and_add(&lock->stats.reads, 1);
+    if (waited) {
+        __sync_fetch_and_add(&lock->stats.read_retries, 1);
+    }
+}
+
+/**
+ * Release read hold
+ * @param lock Lock
+ */
+static inline void read_unlock(rwlock_t* lock) {
+    __sync_fetch_and_sub(&lock->count, 1);
+}
+
+/**
+ * Acquire for writing
+ * @param lock Lock
+ */
+static inline void write_lock(rwlock_t* lock) {
+    uint32_t spins = 0;
+
+    __sync_fetch_and_add(&lock->writers, 1);
+    while (!__sync_bool_compare_and_swap(&lock->count, 0, -1)) {
+        cpu_relax();
+        spins++;
+    }
+    __sync_fetch_and_sub(&lock->writers, 1);
+
+    lockstat_touch(&lock->stats);
+    lock->stats.acquisitions++;
+    if (spins) {
+        lock->stats.contended++;
+        lock->stats.spins += spins;
+    }
+}
+
+/**
+ * Release write hold
+ * @param lock Lock
+ */
+static inline void write_unlock(rwlock_t* lock) {
+    compiler_barrier();
+    lock->count = 0;
+}
+
+/* ==================== SEQLOCK ==================== */
+
+/**
+ * Writers bump an odd/even sequence; readers never block a writer and
+ * retry if the sequence moved while they read
+ */
+typedef struct {
+    volatile uint32_t sequence;     /**< Odd while a write is in progress */
+    spinlock_t writer;              /**< Serializes writers */
+} seqlock_t;
+
+#define SEQLOCK_INIT(name)      { 0, { 0, 0, LOCK_STATS_INIT(name, LOCK_SEQ) } }
+
+/**
+ * Initialize seqlock
+ * @param lock Lock
+ * @param name Name shown by lockstat
+ */
+static inline void seqlock_init(seqlock_t* lock, const char* name) {
+    seqlock_t init = SEQLOCK_INIT(name);
+    *lock = init;
+}
+
+/**
+ * Begin write section (safe from interrupt handlers if every writer
+ * runs with interrupts off)
+ * @param lock Lock
+ */
+static inline void write_seqlock(seqlock_t* lock) {
+    spin_lock(&lock->writer);
+    lock->sequence++;
+    compiler_barrier();
+}
+
+/**
+ * End write section
+ * @param lock Lock
+ */
+static inline void write_sequnlock(seqlock_t* lock) {
+    compiler_barrier();
+    lock->sequence++;
+    spin_unlock(&lock->writer);
+}
+
+/**
+ * Begin read section
+ * @param lock Lock
+ * @return Sequence to pass to read_seqretry
+ */
+static inline uint32_t read_seqbegin(const seqlock_t* lock) {
+    uint32_t sequence;
+
+    while ((sequence = lock->sequence) & 1) {
+        cpu_relax();
+    }
+    compiler_barrier();     // x86 keeps loads in order; stop the compiler hoisting
+    return sequence;
+}
+
+/**
+ * End read section
+ * @param lock Lock
+ * @param start Value from read_seqbegin
+ * @return true if a writer interfered and the read must be repeated
+ */
+static inline bool read_seqretry(seqlock_t* lock, uint32_t start) {
+    compiler_barrier();
+    bool retry = lock->sequence != start;
+
+    // Readers write nothing shared; a retry already means a writer
+    // (which registered the lock) pulled the line away
+    if (retry) {
+        __sync_fetch_and_add(&lock->writer.stats.read_retries, 1);
+    }
+    return retry;
+}
+
+#endif /* _SPINLOCK_H */
@@ -0,0 +1,195 @@
+/**************************************************************
+ * Synchronization Header - BloodG OS
+ * Wait queues, mutexes, semaphores and completions
+ **************************************************************/
+
+#ifndef _SYNC_H
+#define _SYNC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "io.h"
+
+struct thread;
+
+/* ==================== WAIT QUEUES ==================== */
+
+/**
+ * FIFO of threads blocked on an event
+ */
+struct wait_queue {
+    struct thread* head;        /**< First waiter */
+    struct thread* tail;        /**< Last waiter */
+};
+
+#define WAIT_QUEUE_INIT     { NULL, NULL }
+
+/**
+ * Initialize wait queue
+ * @param wq Wait queue
+ */
+void wait_queue_init(struct wait_queue* wq);
+
+/**
+ * Block until woken (interrupts must be off; re-check the condition after)
+ * Before threads exist this just halts until the next interrupt.
+ * @param wq Wait queue
+ */
+void wait_queue_sleep(struct wait_queue* wq);
+
+/**
+ * Block until woken or timeout (interrupts must be off)
+ * If no timer is free it only yields once and reports a timeout, so
+ * callers must re-check their condition and deadline in a loop.
+ * @param wq Wait queue
+ * @param timeout_ns Timeout in nanoseconds
+ * @return true if woken, false on timeout (or no timer)
+ */
+bool wait_queue_sleep_timeout(struct wait_queue* wq, uint64_t timeout_ns);
+
+/**
+ * Wake the first waiter (safe from interrupt handlers)
+ * @param wq Wait queue
+ * @return true if a thread was woken
+ */
+bool wait_queue_wake_one(struct wait_queue* wq);
+
+/**
+ * Wake all waiters (safe from interrupt handlers)
+ * @param wq Wait queue
+ * @return Number of threads woken
+ */
+uint32_t wait_queue_wake_all(struct wait_queue* wq);
+
+/**
+ * Block until condition is true (condition re-checked after each wakeup)
+ */
+#define wait_event(wq, condition)                   \
+    do {                                            \
+        uint32_t _wait_flags = irq_save();          \
+        while (!(condition)) {                      \
+            wait_queue_sleep(wq);                   \
+        }                                           \
+        irq_restore(_wait_flags);                   \
+    } while (0)
+
+/* ==================== MUTEX ==================== */
+
+/**
+ * Sleeping lock with owner (thread context only)
+ */
+struct mutex {
+    volatile bool locked;       /**< Held */
+    struct thread* owner;       /**< Holder (NULL before threads exist) */
+    struct wait_queue waiters;  /**< Threads waiting to acquire */
+};
+
+#define MUTEX_INIT          { false, NULL, WAIT_QUEUE_INIT }
+
+/**
+ * Initialize mutex
+ * @param m Mutex
+ */
+void mutex_init(struct mutex* m);
+
+/**
+ * Acquire mutex, sleeping while it is held
+ * @param m Mutex
+ */
+void mutex_lock(struct mutex* m);
+
+/**
+ * Try to acquire mutex without sleeping
+ * @param m Mutex
+ * @return true if acquired
+ */
+bool mutex_trylock(struct mutex* m);
+
+/**
+ * Release mutex and wake one waiter
+ * @param m Mutex
+ */
+void mutex_unlock(struct mutex* m);
+
+/* ==================== SEMAPHORE ==================== */
+
+/**
+ * Counting semaphore (post is safe from interrupt handlers)
+ */
+struct semaphore {
+    volatile uint32_t count;    /**< Available units */
+    struct wait_queue waiters;  /**< Threads waiting for a unit */
+};
+
+/**
+ * Initialize semaphore
+ * @param sem Semaphore
+ * @param count Initial count
+ */
+void sem_init(struct semaphore* sem, uint32_t count);
+
+/**
+ * Take one unit, sleeping while none are available
+ * @param sem Semaphore
+ */
+void sem_wait(struct semaphore* sem);
+
+/**
+ * Take one unit if available
+ * @param sem Semaphore
+ * @return true if taken
+ */
+bool sem_trywait(struct semaphore* sem);
+
+/**
+ * Return one unit and wake one waiter
+ * @param sem Semaphore
+ */
+void sem_post(struct semaphore* sem);
+
+/* ==================== COMPLETION ==================== */
+
+#define COMPLETION_ALL      0xFFFFFFFF  // done value after complete_all
+
+/**
+ * One-shot event signalled by an interrupt handler or another thread
+ */
+struct completion {
+    volatile uint32_t done;     /**< Pending completions */
+    struct wait_queue waiters;  /**< Threads waiting */
+};
+
+/**
+ * Initialize completion (not done)
+ * @param c Completion
+ */
+void completion_init(struct completion* c);
+
+/**
+ * Wait until completed
+ * @param c Completion
+ */
+void wait_for_completion(struct completion* c);
+
+/**
+ * Wait until completed or timeout
+ * @param c Completion
+ * @param timeout_ns Timeout in nanoseconds
+ * @return true if completed, false on timeout
+ */
+bool wait_for_completion_timeout(struct completion* c, uint64_t timeout_ns);
+
+/**
+ * Signal completion to one waiter (safe from interrupt handlers)
+ * @param c Completion
+ */
+void complete(struct completion* c);
+
+/**
+ * Signal completion to every current and future waiter
+ * @param c Completion
+ */
+void complete_all(struct completion* c);
+
+#endif /* _SYNC_H */
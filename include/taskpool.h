@@ -0,0 +1,75 @@
+/**************************************************************
+ * Task Pool Header - BloodG OS
+ * Work-stealing parallel_for across all online CPUs
+ **************************************************************/
+
+#ifndef _TASKPOOL_H
+#define _TASKPOOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ==================== TASK POOL CONSTANTS ==================== */
+
+#define TASKPOOL_MAX_TASKS  256     // Tasks per parallel_for (power of two)
+#define TASKPOOL_DEQUE_SIZE TASKPOOL_MAX_TASKS
+
+/**
+ * Loop body: handles indices [start, end)
+ */
+typedef void (*parallel_for_fn)(uint32_t start, uint32_t end, void* arg);
+
+/**
+ * Per-CPU scheduling counters
+ */
+struct taskpool_stats {
+    uint32_t executed;          /**< Tasks run on this CPU */
+    uint32_t steals;            /**< Tasks taken from another CPU */
+    uint32_t steal_failures;    /**< Steal attempts that found nothing or lost a race */
+};
+
+/* ==================== TASK POOL FUNCTIONS ==================== */
+
+/**
+ * Use every online CPU (call after smp_init)
+ */
+void taskpool_init(void);
+
+/**
+ * Run fn over [start, end) in chunks of at least grain indices
+ * Ranges are split in half until they reach the grain; the halves
+ * go onto the running CPU's deque where idle CPUs steal them.
+ * Thread context only, and fn must not call parallel_for itself.
+ * @param start First index
+ * @param end One past the last index
+ * @param grain Smallest chunk worth a task (0 picks one)
+ * @param fn Loop body (may run on any CPU, concurrently)
+ * @param arg Argument passed to fn
+ */
+void parallel_for(uint32_t start, uint32_t end, uint32_t grain, parallel_for_fn fn, void* arg);
+
+/**
+ * Limit the CPUs that take part (for scaling benchmarks)
+ * @param count CPUs to use (clamped to 1..online count)
+ */
+void taskpool_set_workers(uint32_t count);
+
+/**
+ * Get number of CPUs taking part
+ * @return Worker count
+ */
+uint32_t taskpool_workers(void);
+
+/**
+ * Get counters for one CPU
+ * @param cpu CPU index
+ * @return Statistics
+ */
+struct taskpool_stats taskpool_get_stats(uint32_t cpu);
+
+/**
+ * Steal and run tasks forever (AP main loop, halts while there is no job)
+ */
+void taskpool_worker(void) __attribute__((noreturn));
+
+#endif /* _TASKPOOL_H */
@@ -0,0 +1,136 @@
+/**************************************************************
+ * Kernel Thread Header - BloodG OS
+ * Preemptive round-robin kernel threads
+ **************************************************************/
+
+#ifndef _THREAD_H
+#define _THREAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct wait_queue;
+
+/* ==================== THREAD CONSTANTS ==================== */
+
+#define THREAD_MAX          16
+#define THREAD_NAME_LEN     16
+#define THREAD_STACK_PAGES  2                       // 8KB per thread
+#define THREAD_SLICE_NS     (10ULL * 1000000ULL)    // 10ms round-robin slice
+
+/**
+ * Thread states
+ */
+enum thread_state {
+    THREAD_UNUSED = 0,      /**< Free slot */
+    THREAD_READY,           /**< On the run queue */
+    THREAD_RUNNING,         /**< Owns the CPU */
+    THREAD_SLEEPING,        /**< Waiting for a timer */
+    THREAD_BLOCKED,         /**< Waiting for an event */
+    THREAD_ZOMBIE,          /**< Exited, stack not yet freed */
+};
+
+/**
+ * Thread entry point
+ */
+typedef void (*thread_entry_t)(void* arg);
+
+/**
+ * Thread control block
+ */
+struct thread {
+    uint32_t esp;                   /**< Saved stack pointer (must be first) */
+    int tid;                        /**< Thread ID */
+    char name[THREAD_NAME_LEN];     /**< Name shown by ps */
+    enum thread_state state;        /**< Current state */
+    thread_entry_t entry;           /**< Entry point */
+    void* arg;                      /**< Entry argument */
+    void* stack;                    /**< Stack pages (NULL for boot thread) */
+    uint64_t runtime_ns;            /**< CPU time consumed */
+    uint64_t last_run_ns;           /**< When it was last switched in */
+    uint32_t switches;              /**< Times switched in */
+    struct wait_queue* wait_queue;  /**< Queue it is blocked on */
+    int wait_timer;                 /**< Pending wait timeout, -1 if none */
+    bool timed_out;                 /**< Last wait ended by timeout */
+    struct thread* next;            /**< Run/wait queue link */
+};
+
+/* ==================== THREAD FUNCTIONS ==================== */
+
+/**
+ * Turn the boot stack into thread 0 ("main") and enable the scheduler
+ */
+void thread_init(void);
+
+/**
+ * Create a thread and put it on the run queue
+ * @param name Thread name
+ * @param entry Entry point (returning from it exits the thread)
+ * @param arg Argument passed to entry
+ * @return Thread ID, or -1 if no slot or stack is available
+ */
+int thread_create(const char* name, thread_entry_t entry, void* arg);
+
+/**
+ * Terminate the calling thread
+ */
+void thread_exit(void) __attribute__((noreturn));
+
+/**
+ * Give up the CPU to the next ready thread
+ */
+void thread_yield(void);
+
+/**
+ * Sleep the calling thread
+ * @param milliseconds Time to sleep
+ */
+void thread_sleep_ms(uint32_t milliseconds);
+
+/**
+ * Get the calling thread
+ * @return Current thread
+ */
+struct thread* thread_current(void);
+
+/**
+ * Get thread by slot (for ps)
+ * @param slot Slot index (0 to THREAD_MAX-1)
+ * @return Thread, or NULL if slot is unused
+ */
+const struct thread* thread_get(int slot);
+
+/**
+ * Get number of threads waiting on the run queue
+ * @return Ready thread count
+ */
+uint32_t thread_ready_count(void);
+
+/**
+ * Get state name
+ * @param state Thread state
+ * @return Name string
+ */
+const char* thread_state_name(enum thread_state state);
+
+/* ==================== SCHEDULER INTERNALS ==================== */
+
+/**
+ * Block the calling thread until thread_wake (interrupts must be off)
+ * @param state THREAD_SLEEPING or THREAD_BLOCKED
+ */
+void thread_block(enum thread_state state);
+
+/**
+ * Make a sleeping/blocked thread ready (safe from interrupt handlers)
+ * @param thread Thread to wake
+ */
+void thread_wake(struct thread* thread);
+
+/**
+ * Switch threads if a slice expired or a wakeup is pending
+ * (called by interrupt_dispatch after EOI)
+ */
+void thread_preempt(void);
+
+#endif /* _THREAD_H */
@@ -7,6 +7,8 @@
 #define _TIMER_H
 
 #include <stdint.h>
+#include <stdbool.h>
+#include "timer_wheel.h"
 
 /* ==================== TIMER CONSTANTS ==================== */
 
@@ -29,10 +31,30 @@ void timer_init(uint32_t frequency);
 void timer_handler(void);
 
 /**
- * Get current tick count
+ * Switch between periodic ticks and tickless one-shot mode
+ * @param enable true for tickless (needs TSC or HPET timekeeping)
+ * @return true if mode was set, false otherwise
+ */
+bool timer_set_tickless(bool enable);
+
+/**
+ * Check if tickless mode is active
+ * @return true if tickless, false if periodic
+ */
+bool timer_is_tickless(void);
+
+/**
+ * Re-arm the tickless one-shot if a new timer expires before it
+ * (called by the timer wheel, interrupts disabled)
+ * @param expires_ns Monotonic expiry time of the new timer
+ */
+void timer_clockevent_update(uint64_t expires_ns);
+
+/**
+ * Get current tick count (safe from any CPU, never wraps)
  * @return Number of ticks since boot
  */
-uint32_t timer_get_ticks(void);
+uint64_t timer_get_ticks(void);
 
 /**
  * Get timer frequency
@@ -45,23 +67,23 @@ uint32_t timer_get_frequency(void);
  * @param ticks Number of ticks
  * @return Milliseconds
  */
-uint32_t timer_ticks_to_ms(uint32_t ticks);
+uint64_t timer_ticks_to_ms(uint64_t ticks);
 
 /**
  * Convert ticks to microseconds
  * @param ticks Number of ticks
  * @return Microseconds
  */
-uint32_t timer_ticks_to_us(uint32_t ticks);
+uint64_t timer_ticks_to_us(uint64_t ticks);
 
 /**
- * Sleep for specified milliseconds (busy wait)
+ * Sleep for specified milliseconds (halts between ticks)
  * @param milliseconds Milliseconds to sleep
  */
 void timer_sleep_ms(uint32_t milliseconds);
 
 /**
- * Sleep for specified microseconds (busy wait)
+ * Sleep for specified microseconds (halts between ticks)
  * @param microseconds Microseconds to sleep
  */
 void timer_sleep_us(uint32_t microseconds);
@@ -70,7 +92,7 @@ void timer_sleep_us(uint32_t microseconds);
  * Get current time in milliseconds
  * @return Milliseconds since boot
  */
-uint32_t timer_get_ms(void);
+uint64_t timer_get_ms(void);
 
 /**
  * Get current time in microseconds
@@ -85,8 +107,8 @@ uint64_t timer_get_us(void);
 void delay_io(uint32_t count);
 
 /**
- * Calibrate timer (returns configured frequency)
- * @return Timer frequency in Hz
+ * Calibrate timer (measures IRQ0 rate against the TSC clock)
+ * @return Measured frequency in Hz (configured frequency if unavailable)
  */
 uint32_t timer_calibrate(void);
 
@@ -0,0 +1,71 @@
+/**************************************************************
+ * Timer Wheel Header - BloodG OS
+ * Hierarchical timer wheel for kernel software timers
+ **************************************************************/
+
+#ifndef _TIMER_WHEEL_H
+#define _TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ==================== TIMER WHEEL CONSTANTS ==================== */
+
+#define TIMER_WHEEL_SHIFT   20      // Jiffy = 2^20 ns (~1.05ms)
+#define TIMER_WHEEL_LEVELS  5       // 64^5 jiffies (~13 days) range
+#define TIMER_WHEEL_BITS    6       // 64 slots per level
+#define TIMER_MAX_EVENTS    64      // Timers that can be pending at once (max 256)
+
+#define TIMER_NO_EXPIRY     (~0ULL)
+
+/**
+ * Software timer callback (runs in interrupt context)
+ */
+typedef void (*timer_callback_t)(void* arg);
+
+/* ==================== TIMER FUNCTIONS ==================== */
+
+/**
+ * Run callback after a delay (O(1) insert)
+ * @param delay_ns Delay in nanoseconds (rounded up to a jiffy)
+ * @param callback Function to call (interrupt context)
+ * @param arg Argument passed to callback
+ * @return Timer id (cancelling it after the callback ran is a no-op),
+ *         or -1 if none free
+ */
+int timer_add(uint64_t delay_ns, timer_callback_t callback, void* arg);
+
+/**
+ * Cancel a pending callback (O(1))
+ * @param id Timer id from timer_add
+ * @return true if it was still pending, false otherwise
+ */
+bool timer_cancel(int id);
+
+/**
+ * Get number of pending timers
+ * @return Pending timer count
+ */
+uint32_t timer_pending(void);
+
+/* ==================== WHEEL DRIVER ==================== */
+
+/**
+ * Reset the wheel (called from timer_init)
+ * @param now_ns Current monotonic time
+ */
+void timer_wheel_init(uint64_t now_ns);
+
+/**
+ * Run all timers due at or before now (called from timer_handler)
+ * @param now_ns Current monotonic time
+ */
+void timer_wheel_run(uint64_t now_ns);
+
+/**
+ * Get time the wheel next needs servicing
+ * @return Monotonic time in ns, or TIMER_NO_EXPIRY if nothing is pending
+ */
+uint64_t timer_wheel_next_expiry(void);
+
+#endif /* _TIMER_WHEEL_H */
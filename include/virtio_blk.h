@@ -0,0 +1,123 @@
+/**************************************************************
+ * Virtio Block Driver Header - BloodG OS
+ * Legacy virtio-pci registers, split virtqueue layout and
+ * driver interface
+ **************************************************************/
+
+#ifndef _VIRTIO_BLK_H
+#define _VIRTIO_BLK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ==================== VIRTIO CONSTANTS ==================== */
+
+#define VIRTIO_PCI_VENDOR           0x1AF4
+#define VIRTIO_PCI_DEVICE_BLK       0x1001  /**< Transitional (legacy interface) block device */
+
+// Legacy registers (offsets from BAR0, I/O space)
+#define VIRTIO_REG_DEVICE_FEATURES  0x00
+#define VIRTIO_REG_GUEST_FEATURES   0x04
+#define VIRTIO_REG_QUEUE_PFN        0x08    /**< Queue address >> 12 */
+#define VIRTIO_REG_QUEUE_SIZE       0x0C
+#define VIRTIO_REG_QUEUE_SELECT     0x0E
+#define VIRTIO_REG_QUEUE_NOTIFY     0x10
+#define VIRTIO_REG_DEVICE_STATUS    0x12
+#define VIRTIO_REG_ISR_STATUS       0x13    /**< Read clears */
+#define VIRTIO_REG_CONFIG           0x14    /**< Device config (no MSI-X) */
+
+// Block device config (offsets from VIRTIO_REG_CONFIG)
+#define VIRTIO_BLK_CFG_CAPACITY     0x00    /**< 64-bit, 512-byte sectors */
+
+// Device status
+#define VIRTIO_STATUS_ACKNOWLEDGE   0x01
+#define VIRTIO_STATUS_DRIVER        0x02
+#define VIRTIO_STATUS_DRIVER_OK     0x04
+#define VIRTIO_STATUS_FAILED        0x80
+
+#define VIRTIO_ISR_QUEUE            0x01
+
+// Feature bits
+#define VIRTIO_BLK_F_RO             (1u << 5)
+#define VIRTIO_BLK_F_FLUSH          (1u << 9)
+#define VIRTIO_RING_F_EVENT_IDX     (1u << 29)
+
+// Request types and status
+#define VIRTIO_BLK_T_IN             0
+#define VIRTIO_BLK_T_OUT            1
+#define VIRTIO_BLK_T_FLUSH          4
+#define VIRTIO_BLK_S_OK             0
+
+// Descriptor flags
+#define VRING_DESC_F_NEXT           1
+#define VRING_DESC_F_WRITE          2   /**< Device writes this buffer */
+
+#define VRING_USED_F_NO_NOTIFY      1
+#define VIRTIO_QUEUE_ALIGN          4096
+#define VIRTIO_BLK_DESCS            3   /**< Header, data, status */
+#define VIRTIO_BLK_MAX_SECTORS      2048    /**< Per request (one data descriptor) */
+
+/* ==================== VIRTQUEUE LAYOUT ==================== */
+
+/**
+ * Descriptor table entry
+ */
+struct vring_desc {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed));
+
+/**
+ * Driver -> device ring (followed by used_event)
+ */
+struct vring_avail {
+    uint16_t flags;
+    volatile uint16_t idx;
+    uint16_t ring[];
+};
+
+/**
+ * Used ring entry
+ */
+struct vring_used_elem {
+    uint32_t id;                /**< Head descriptor of the chain */
+    uint32_t len;               /**< Bytes written by the device */
+};
+
+/**
+ * Device -> driver ring (followed by avail_event)
+ */
+struct vring_used {
+    volatile uint16_t flags;
+    volatile uint16_t idx;
+    struct vring_used_elem ring[];
+};
+
+/**
+ * Block request header
+ */
+struct virtio_blk_header {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} __attribute__((packed));
+
+/* ==================== VIRTIO BLOCK FUNCTIONS ==================== */
+
+/**
+ * Find legacy virtio-blk devices and register a block device (vdN) for each
+ * @return true if at least one device was found, false otherwise
+ */
+bool virtio_blk_init(void);
+
+/**
+ * Get notification counters (how well event index suppression works)
+ * @param submitted Output: requests made available to the device
+ * @param kicks Output: queue notifications sent
+ * @param interrupts Output: queue interrupts taken
+ */
+void virtio_blk_get_stats(uint32_t* submitted, uint32_t* kicks, uint32_t* interrupts);
+
+#endif /* _VIRTIO_BLK_H */
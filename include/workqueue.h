@@ -0,0 +1,123 @@
+/**************************************************************
+ * Work Queue Header - BloodG OS
+ * Deferred work run by kernel worker threads (bottom halves)
+ **************************************************************/
+
+#ifndef _WORKQUEUE_H
+#define _WORKQUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "sync.h"
+
+/* ==================== WORK QUEUE CONSTANTS ==================== */
+
+#define WORKQUEUE_MAX       8       // Queues that can exist at once
+#define WORKQUEUE_NAME_LEN  16
+
+/**
+ * Deferred function
+ */
+typedef void (*work_func_t)(void* arg);
+
+/**
+ * Work item (owned by the caller; queued at most once at a time)
+ */
+struct work {
+    work_func_t func;           /**< Function to run in the worker */
+    void* arg;                  /**< Argument passed to func */
+    volatile bool pending;      /**< Queued and not yet started */
+    uint64_t queued_ns;         /**< When it was queued */
+    struct work* next;          /**< Queue link */
+};
+
+#define WORK_INIT(func, arg)    { func, arg, false, 0, NULL }
+
+/**
+ * Per-queue statistics
+ */
+struct work_queue_stats {
+    uint32_t queued;            /**< Items queued */
+    uint32_t coalesced;         /**< queue_work calls on an already pending item */
+    uint32_t completed;         /**< Items run */
+    uint32_t depth;             /**< Items waiting now */
+    uint32_t max_depth;         /**< Most items ever waiting */
+    uint64_t total_wait_ns;     /**< Sum of queue-to-start latency */
+    uint64_t min_wait_ns;       /**< Shortest latency */
+    uint64_t max_wait_ns;       /**< Longest latency */
+    uint64_t total_run_ns;      /**< Time spent in work functions */
+    uint64_t max_run_ns;        /**< Longest work function */
+};
+
+/**
+ * Work queue served by one worker thread
+ */
+struct work_queue {
+    char name[WORKQUEUE_NAME_LEN];  /**< Name (also the worker thread name) */
+    struct work* head;              /**< Oldest pending item */
+    struct work* tail;              /**< Newest pending item */
+    struct wait_queue idle;         /**< Worker sleeps here when empty */
+    int worker;                     /**< Worker thread ID */
+    struct work_queue_stats stats;  /**< Latency statistics */
+};
+
+/* ==================== WORK QUEUE FUNCTIONS ==================== */
+
+/**
+ * Create the system queue (needs the scheduler running)
+ */
+void workqueue_init(void);
+
+/**
+ * Initialize work item
+ * @param work Work item
+ * @param func Function to run
+ * @param arg Argument passed to func
+ */
+void work_init(struct work* work, work_func_t func, void* arg);
+
+/**
+ * Initialize queue and start its worker thread
+ * @param wq Work queue
+ * @param name Queue name
+ * @return true on success, false if no thread or queue slot is free
+ */
+bool work_queue_init(struct work_queue* wq, const char* name);
+
+/**
+ * Queue work (safe from interrupt handlers)
+ * @param wq Work queue
+ * @param work Work item
+ * @return true if queued, false if it was already pending
+ */
+bool queue_work(struct work_queue* wq, struct work* work);
+
+/**
+ * Queue work on the system queue of this CPU
+ * @param work Work item
+ * @return true if queued, false if already pending or before workqueue_init
+ */
+bool schedule_work(struct work* work);
+
+/**
+ * Get queue by index (for workq)
+ * @param index Index (0 to WORKQUEUE_MAX-1)
+ * @return Work queue, or NULL if none
+ */
+struct work_queue* work_queue_get(int index);
+
+/**
+ * Get consistent copy of queue statistics
+ * @param wq Work queue
+ * @return Statistics
+ */
+struct work_queue_stats work_queue_get_stats(struct work_queue* wq);
+
+/**
+ * Reset queue statistics
+ * @param wq Work queue
+ */
+void work_queue_reset_stats(struct work_queue* wq);
+
+#endif /* _WORKQUEUE_H */
@@ -0,0 +1,508 @@
+/**************************************************************
+ * Block Device Layer - BloodG OS
+ * Per-device bio queue: C-LOOK ordering between flush barriers,
+ * merging of adjacent bios into one command, bounce buffer for
+ * scattered merges, up to 32 tagged commands in flight
+ **************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "io.h"
+#include "string.h"
+#include "clock.h"
+#include "page.h"
+#include "workqueue.h"
+#include "block.h"
+
+// Registered devices, in registration order (never removed)
+static struct block_device* device_list = NULL;
+static spinlock_t device_list_lock = SPINLOCK_INIT("blkdev");
+
+// Completion worker, started with the first device
+static struct work_queue block_queue;
+static volatile bool block_queue_ready = false;
+static struct mutex block_queue_lock = MUTEX_INIT;
+
+void print_string(const char* str);
+
+// Start kblockd once
+static void block_queue_start(void) {
+    mutex_lock(&block_queue_lock);
+    if (!block_queue_ready) {
+        block_queue_ready = work_queue_init(&block_queue, "kblockd");
+        if (!block_queue_ready) {
+            print_string("Block: Cannot start kblockd\n");
+        }
+    }
+    mutex_unlock(&block_queue_lock);
+}
+
+// Queue driver completion work
+bool block_schedule(struct work* work) {
+    if (!block_queue_ready) {
+        return schedule_work(work);     // Boot-time I/O only: thread 0 waits
+    }
+    return queue_work(&block_queue, work);
+}
+
+// Add device to list
+bool block_register(struct block_device* dev) {
+    if (!__sync_bool_compare_and_swap(&dev->registered, 0, 1)) {
+        return true;
+    }
+    block_queue_start();
+
+    spin_lock_init(&dev->lock, dev->name);
+    dev->queue = NULL;
+    dev->depth = 0;
+    dev->in_flight = 0;
+    dev->busy_tags = 0;
+    dev->flushing = false;
+    dev->bounce_busy = false;
+    dev->position = 0;
+    dev->epoch = 0;
+    memset(dev->cmds, 0, sizeof(dev->cmds));
+    if (dev->queue_depth > BLOCK_MAX_TAGS) {
+        dev->queue_depth = BLOCK_MAX_TAGS;
+    }
+    memset(&dev->stats, 0, sizeof(dev->stats));
+
+    // Without it only bios with adjacent buffers merge
+    dev->bounce = (uint8_t*)page_alloc(BLOCK_BOUNCE_SECTORS * BLOCK_SECTOR_SIZE / PAGE_SIZE);
+
+    uint32_t flags = spin_lock_irqsave(&device_list_lock);
+    struct block_device** link = &device_list;
+    while (*link) {
+        link = &(*link)->next;
+    }
+    dev->next = NULL;
+    *link = dev;
+    spin_unlock_irqrestore(&device_list_lock, flags);
+    return true;
+}
+
+// Find device by name
+struct block_device* block_get(const char* name) {
+    for (struct block_device* dev = device_list; dev; dev = dev->next) {
+        if (strcmp(dev->name, name) == 0) {
+            return dev;
+        }
+    }
+    return NULL;
+}
+
+// Get first device
+struct block_device* block_first(void) {
+    return device_list;
+}
+
+// Fill in a bio
+void bio_init(struct bio* bio, uint64_t sector, uint32_t count, uint8_t* buffer,
+              bool write, bio_end_t end_io, void* private) {
+    bio->sector = sector;
+    bio->count = count;
+    bio->buffer = buffer;
+    bio->write = write;
+    bio->flush = false;
+    bio->end_io = end_io;
+    bio->private = private;
+    bio->ok = false;
+    bio->finished = false;
+    bio->epoch = 0;
+    bio->dev = NULL;
+    bio->next = NULL;
+    completion_init(&bio->completion);
+}
+
+// Fill in a flush bio
+void bio_init_flush(struct bio* bio, bio_end_t end_io, void* private) {
+    bio_init(bio, 0, 0, NULL, true, end_io, private);
+    bio->flush = true;
+}
+
+// Hand every bio of a finished command back to its owner
+static void block_end_bios(struct bio* bio, bool ok) {
+    while (bio) {
+        struct bio* next = bio->next;   // Owner may reuse bio once finished
+
+        bio->next = NULL;
+        bio->ok = ok;
+        bio->finished = true;
+        if (bio->end_io) {
+            bio->end_io(bio);
+        } else {
+            complete(&bio->completion);
+        }
+        bio = next;
+    }
+}
+
+// Free tag (lock held)
+static void block_release_tag(struct block_device* dev, uint32_t tag) {
+    struct block_cmd* cmd = &dev->cmds[tag];
+
+    cmd->bios = NULL;
+    cmd->orphaned = false;
+    dev->busy_tags &= ~(1u << tag);
+    dev->in_flight--;
+    if (cmd->bounced) {
+        dev->bounce_busy = false;
+    }
+    if (cmd->flush) {
+        dev->flushing = false;
+    }
+}
+
+// Retire the command with this tag
+static void block_end_cmd(struct block_device* dev, uint32_t tag, bool ok) {
+    struct block_cmd* cmd = &dev->cmds[tag];
+
+    uint32_t flags = spin_lock_irqsave(&dev->lock);
+    struct bio* bios = cmd->bios;
+    bool bounced = cmd->bounced;
+
+    // Its bios already failed: the late completion only frees the tag
+    if (cmd->orphaned) {
+        block_release_tag(dev, tag);
+        spin_unlock_irqrestore(&dev->lock, flags);
+        return;
+    }
+    spin_unlock_irqrestore(&dev->lock, flags);
+
+    if (!bios) {
+        return;
+    }
+
+    // Still busy, so no new command can claim the bounce buffer yet
+    uint32_t sectors = 0;
+    uint8_t* data = dev->bounce;
+    for (struct bio* bio = bios; bio; bio = bio->next) {
+        if (bounced && ok && !bio->write) {
+            memcpy(bio->buffer, data, bio->count * BLOCK_SECTOR_SIZE);
+        }
+        data += bio->count * BLOCK_SECTOR_SIZE;
+        sectors += bio->count;
+    }
+
+    flags = spin_lock_irqsave(&dev->lock);
+    block_release_tag(dev, tag);
+    if (ok) {
+        dev->stats.sectors += sectors;
+    } else {
+        dev->stats.errors++;
+    }
+    spin_unlock_irqrestore(&dev->lock, flags);
+
+    block_end_bios(bios, ok);
+}
+
+// Claim a free tag for bios (lock held)
+static uint32_t block_start_cmd(struct block_device* dev, struct bio* bios, bool bounced) {
+    uint32_t tag = __builtin_ctz(~dev->busy_tags);
+    struct block_cmd* cmd = &dev->cmds[tag];
+
+    cmd->bios = bios;
+    cmd->bounced = bounced;
+    cmd->flush = bios->flush;
+    cmd->orphaned = false;
+    cmd->ns = clock_ns();
+    dev->busy_tags |= 1u << tag;
+    dev->in_flight++;
+    dev->active_epoch = bios->epoch;
+    if (dev->in_flight > dev->stats.max_in_flight) {
+        dev->stats.max_in_flight = dev->in_flight;
+    }
+    return tag;
+}
+
+// Start queued bios until the driver's queue is full or a barrier blocks
+static void block_dispatch(struct block_device* dev) {
+    bool started = false;
+
+    for (;;) {
+        uint32_t flags = spin_lock_irqsave(&dev->lock);
+        struct bio* head = dev->queue;
+        uint32_t depth = dev->queue_depth ? dev->queue_depth : 1;
+
+        // Commands in flight together must share an epoch; flushes run alone
+        if (!head || dev->in_flight >= depth ||
+            (dev->in_flight && (dev->flushing || head->flush || head->epoch != dev->active_epoch))) {
+            spin_unlock_irqrestore(&dev->lock, flags);
+            if (started && dev->ops->kick) {
+                dev->ops->kick(dev);
+            }
+            return;
+        }
+
+        // The queue head holds the oldest epoch; its flush sorts last
+        uint32_t epoch = head->epoch;
+        if (head->flush) {
+            dev->queue = head->next;
+            head->next = NULL;
+            dev->depth--;
+            dev->flushing = true;
+            dev->stats.flushes++;
+            uint32_t tag = block_start_cmd(dev, head, false);
+            spin_unlock_irqrestore(&dev->lock, flags);
+
+            if (!dev->ops->flush) {
+                block_end_cmd(dev, tag, true);
+            } else if (!dev->ops->flush(dev, tag)) {
+                block_end_cmd(dev, tag, false);
+            } else {
+                started = true;
+            }
+            continue;
+        }
+
+        // C-LOOK within the epoch: keep sweeping upward, then wrap
+        struct bio** link = &dev->queue;
+        while (*link && (*link)->epoch == epoch && !(*link)->flush &&
+               (*link)->sector < dev->position) {
+            link = &(*link)->next;
+        }
+        if (!*link || (*link)->epoch != epoch || (*link)->flush) {
+            link = &dev->queue;
+        }
+
+        struct bio* first = *link;
+        struct bio* last = first;
+        uint32_t count = first->count;
+        uint32_t taken = 1;
+        bool contiguous = true;
+
+        // Back-merge queued neighbours: same direction, next sector up
+        uint32_t bounce_limit = (dev->bounce && !dev->bounce_busy) ? BLOCK_BOUNCE_SECTORS : 0;
+        if (bounce_limit > dev->max_sectors) bounce_limit = dev->max_sectors;
+
+        while (last->next) {
+            struct bio* next = last->next;
+            if (next->epoch != epoch || next->flush || next->write != first->write ||
+                next->sector != last->sector + last->count) {
+                break;
+            }
+
+            bool adjacent = contiguous &&
+                next->buffer == last->buffer + last->count * BLOCK_SECTOR_SIZE;
+            uint32_t limit = adjacent ? dev->max_sectors : bounce_limit;
+            if (count + next->count > limit) {
+                break;
+            }
+
+            contiguous = adjacent;
+            count += next->count;
+            taken++;
+            last = next;
+        }
+
+        *link = last->next;
+        last->next = NULL;
+
+        dev->depth -= taken;
+        dev->position = first->sector + count;
+        dev->stats.requests++;
+        dev->stats.merged += taken - 1;
+        if (!contiguous) {
+            dev->bounce_busy = true;
+            dev->stats.bounced++;
+        }
+        uint32_t tag = block_start_cmd(dev, first, !contiguous);
+        spin_unlock_irqrestore(&dev->lock, flags);
+
+        uint8_t* buffer = first->buffer;
+        if (!contiguous) {
+            buffer = dev->bounce;
+            if (first->write) {
+                uint8_t* data = buffer;
+                for (struct bio* bio = first; bio; bio = bio->next) {
+                    memcpy(data, bio->buffer, bio->count * BLOCK_SECTOR_SIZE);
+                    data += bio->count * BLOCK_SECTOR_SIZE;
+                }
+            }
+        }
+
+        if (!dev->ops->submit(dev, tag, first->sector, count, buffer, first->write)) {
+            block_end_cmd(dev, tag, false);
+        } else {
+            started = true;
+        }
+    }
+}
+
+// Bio a sorts at or before bio b
+static bool block_sorts_before(struct bio* a, struct bio* b) {
+    if (a->epoch != b->epoch) {
+        return a->epoch < b->epoch;
+    }
+    if (b->flush) {
+        return true;            // Barrier goes after its epoch's data
+    }
+    return !a->flush && a->sector <= b->sector;
+}
+
+// Queue bio in (epoch, sector) order
+bool block_submit(struct block_device* dev, struct bio* bio) {
+    if (!dev) {
+        return false;
+    }
+    if (!bio->flush && (bio->count == 0 || bio->sector + bio->count > dev->sectors)) {
+        return false;
+    }
+
+    bio->dev = dev;
+    bio->ok = false;
+    bio->finished = false;
+
+    uint32_t flags = spin_lock_irqsave(&dev->lock);
+
+    // Nothing crosses a barrier; equal sectors keep submission order
+    bio->epoch = dev->epoch;
+    if (bio->flush) {
+        dev->epoch++;
+    }
+    struct bio** link = &dev->queue;
+    while (*link && block_sorts_before(*link, bio)) {
+        link = &(*link)->next;
+    }
+    bio->next = *link;
+    *link = bio;
+
+    dev->depth++;
+    dev->stats.bios++;
+    dev->stats.depth_sum += dev->depth;
+    if (dev->depth > dev->stats.max_depth) {
+        dev->stats.max_depth = dev->depth;
+    }
+    spin_unlock_irqrestore(&dev->lock, flags);
+
+    block_dispatch(dev);
+    return true;
+}
+
+// Driver finished a command
+void block_complete(struct block_device* dev, uint32_t tag, bool ok) {
+    block_end_cmd(dev, tag, ok);
+    block_dispatch(dev);
+}
+
+// Fail the bios of a stuck command the driver could not kill; the
+// tag stays busy until the driver's own block_complete arrives
+static void block_orphan_cmd(struct block_device* dev, uint32_t tag, struct bio* bios) {
+    struct block_cmd* cmd = &dev->cmds[tag];
+
+    uint32_t flags = spin_lock_irqsave(&dev->lock);
+    if (cmd->bios != bios) {
+        spin_unlock_irqrestore(&dev->lock, flags);
+        return;                 // Completed after all
+    }
+    cmd->bios = NULL;
+    cmd->orphaned = true;
+    dev->stats.aborted++;
+    spin_unlock_irqrestore(&dev->lock, flags);
+
+    block_end_bios(bios, false);
+}
+
+// Kill commands in flight that have been stuck too long
+static void block_abort_stuck(struct block_device* dev) {
+    for (uint32_t tag = 0; tag < BLOCK_MAX_TAGS; tag++) {
+        uint32_t flags = spin_lock_irqsave(&dev->lock);
+        struct bio* bios = dev->cmds[tag].bios;
+        bool stuck = bios && clock_ns() - dev->cmds[tag].ns >= BLOCK_TIMEOUT_NS;
+        spin_unlock_irqrestore(&dev->lock, flags);
+
+        if (!stuck) {
+            continue;
+        }
+        if (!dev->ops->abort || !dev->ops->abort(dev, tag)) {
+            block_orphan_cmd(dev, tag, bios);
+            continue;
+        }
+
+        flags = spin_lock_irqsave(&dev->lock);
+        dev->stats.aborted++;
+        spin_unlock_irqrestore(&dev->lock, flags);
+        block_complete(dev, tag, false);
+    }
+}
+
+// Take bio back out of the queue if it was never started
+static bool block_cancel_queued(struct block_device* dev, struct bio* bio) {
+    uint32_t flags = spin_lock_irqsave(&dev->lock);
+
+    for (struct bio** link = &dev->queue; *link; link = &(*link)->next) {
+        if (*link == bio) {
+            *link = bio->next;
+            bio->next = NULL;
+            dev->depth--;
+            dev->stats.errors++;
+            spin_unlock_irqrestore(&dev->lock, flags);
+            block_end_bios(bio, false);
+            return true;
+        }
+    }
+    spin_unlock_irqrestore(&dev->lock, flags);
+    return false;
+}
+
+// Wait for bio, aborting commands that never finish
+bool bio_wait(struct bio* bio) {
+    for (uint32_t waits = 1; !wait_for_completion_timeout(&bio->completion, BLOCK_TIMEOUT_NS); waits++) {
+        block_abort_stuck(bio->dev);
+
+        // Stuck behind tags that never come back: give up on it
+        if (waits >= BLOCK_WAIT_RETRIES && block_cancel_queued(bio->dev, bio)) {
+            break;
+        }
+    }
+    return bio->ok;
+}
+
+// Synchronous transfer
+static bool block_transfer(struct block_device* dev, uint64_t sector, uint32_t count,
+                           uint8_t* buffer, bool write) {
+    struct bio bio;
+
+    bio_init(&bio, sector, count, buffer, write, NULL, NULL);
+    if (!block_submit(dev, &bio)) {
+        return false;
+    }
+    return bio_wait(&bio);
+}
+
+// Read sectors
+bool block_read(struct block_device* dev, uint64_t sector, uint32_t count, uint8_t* buffer) {
+    return block_transfer(dev, sector, count, buffer, false);
+}
+
+// Write sectors
+bool block_write(struct block_device* dev, uint64_t sector, uint32_t count, uint8_t* buffer) {
+    return block_transfer(dev, sector, count, buffer, true);
+}
+
+// Barrier + cache flush
+bool block_flush(struct block_device* dev) {
+    struct bio bio;
+
+    bio_init_flush(&bio, NULL, NULL);
+    if (!block_submit(dev, &bio)) {
+        return false;
+    }
+    return bio_wait(&bio);
+}
+
+// Copy counters
+struct block_stats block_get_stats(struct block_device* dev) {
+    uint32_t flags = spin_lock_irqsave(&dev->lock);
+    struct block_stats stats = dev->stats;
+    spin_unlock_irqrestore(&dev->lock, flags);
+    return stats;
+}
+
+// Zero counters
+void block_reset_stats(struct block_device* dev) {
+    uint32_t flags = spin_lock_irqsave(&dev->lock);
+    memset(&dev->stats, 0, sizeof(dev->stats));
+    spin_unlock_irqrestore(&dev->lock, flags);
+}
@@ -0,0 +1,90 @@
+/**************************************************************
+ * Idle Loop - BloodG OS
+ * Sleeps on hlt between interrupts instead of busy polling
+ **************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "io.h"
+#include "clock.h"
+#include "idle.h"
+#include "thread.h"
+
+// Idle state
+static volatile bool work_pending = false;
+static volatile bool cpu_idle = false;
+static volatile struct idle_stats stats = {0};
+static uint64_t stats_start_ns = 0;
+
+// Halt until an interrupt arrives
+void idle_wait(void) {
+    cli();
+
+    // Work was queued after the caller last checked - don't sleep
+    if (work_pending) {
+        work_pending = false;
+        stats.wakeups++;
+        sti();
+        return;
+    }
+
+    // Other threads have work: run them instead of halting
+    if (thread_ready_count()) {
+        thread_yield();
+        sti();
+        return;
+    }
+
+    idle_halt();
+    work_pending = false;
+    sti();
+}
+
+// Halt once (interrupts off on entry and on return)
+void idle_halt(void) {
+    cpu_idle = true;
+    stats.halts++;
+    uint64_t start = clock_ns();
+
+    // sti takes effect after the next instruction, so no interrupt
+    // can slip in between enabling and halting
+    asm volatile ("sti; hlt; cli");
+
+    stats.idle_ns += clock_ns() - start;
+    cpu_idle = false;
+}
+
+// Mark work as pending
+void idle_kick(void) {
+    work_pending = true;
+}
+
+// Check if CPU is halted
+bool idle_is_idle(void) {
+    return cpu_idle;
+}
+
+// Get idle accounting
+struct idle_stats idle_get_stats(void) {
+    struct idle_stats copy;
+
+    uint32_t flags = irq_save();
+    uint64_t total_ns = clock_ns() - stats_start_ns;
+    copy.idle_ns = stats.idle_ns;
+    copy.busy_ns = total_ns > stats.idle_ns ? total_ns - stats.idle_ns : 0;
+    copy.halts = stats.halts;
+    copy.wakeups = stats.wakeups;
+    irq_restore(flags);
+
+    return copy;
+}
+
+// Reset idle accounting
+void idle_reset_stats(void) {
+    uint32_t flags = irq_save();
+    stats_start_ns = clock_ns();
+    stats.idle_ns = 0;
+    stats.halts = 0;
+    stats.wakeups = 0;
+    irq_restore(flags);
+}
@@ -0,0 +1,381 @@
+/**************************************************************
+ * Interrupt Descriptor Table - BloodG OS
+ * Exception and IRQ dispatch with per-vector counters
+ **************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "io.h"
+#include "pic.h"
+#include "apic.h"
+#include "clock.h"
+#include "thread.h"
+#include "idt.h"
+
+#pragma pack(push, 1)
+
+// IDT gate descriptor
+struct idt_entry {
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t  zero;
+    uint8_t  type_attr;
+    uint16_t offset_high;
+};
+
+// Operand for lidt
+struct idt_pointer {
+    uint16_t limit;
+    uint32_t base;
+};
+
+#pragma pack(pop)
+
+// Stub addresses from boot/interrupts.asm
+extern uint32_t isr_stub_table[IDT_ENTRIES];
+
+// Kernel functions
+void print_string(const char* str);
+void kernel_panic(const char* message, const char* file, int line);
+
+// IDT state
+static struct idt_entry idt[IDT_ENTRIES] __attribute__((aligned(8)));
+static interrupt_handler_t handlers[IDT_ENTRIES];
+static volatile struct interrupt_stats stats[IDT_ENTRIES];
+
+// Handler chains for shared PCI lines
+struct irq_action {
+    interrupt_handler_t handler;
+    struct irq_action* next;
+};
+static struct irq_action irq_actions[IRQ_SHARED_MAX];
+static struct irq_action* irq_chains[IRQ_COUNT];
+
+// Exception names (vectors 0-31)
+static const char* exception_names[EXCEPTION_COUNT] = {
+    "Divide Error",
+    "Debug",
+    "Non-Maskable Interrupt",
+    "Breakpoint",
+    "Overflow",
+    "Bound Range Exceeded",
+    "Invalid Opcode",
+    "Device Not Available",
+    "Double Fault",
+    "Coprocessor Segment Overrun",
+    "Invalid TSS",
+    "Segment Not Present",
+    "Stack-Segment Fault",
+    "General Protection Fault",
+    "Page Fault",
+    "Reserved",
+    "x87 Floating-Point Error",
+    "Alignment Check",
+    "Machine Check",
+    "SIMD Floating-Point Error",
+    "Virtualization Exception",
+    "Control Protection Exception",
+    "Reserved", "Reserved", "Reserved", "Reserved", "Reserved", "Reserved",
+    "Hypervisor Injection Exception",
+    "VMM Communication Exception",
+    "Security Exception",
+    "Reserved",
+};
+
+// Legacy IRQ sources (ISA assignments)
+static const char* irq_names[IRQ_COUNT] = {
+    "Timer", "Keyboard", "Cascade", "COM2", "COM1", "LPT2", "Floppy", "LPT1",
+    "RTC", "ACPI", "IRQ10", "IRQ11", "PS/2 Mouse", "FPU", "ATA Primary", "ATA Secondary",
+};
+
+// Fill one gate
+static void idt_set_gate(uint8_t vector, uint32_t offset, uint16_t selector, uint8_t type_attr) {
+    idt[vector].offset_low = offset & 0xFFFF;
+    idt[vector].selector = selector;
+    idt[vector].zero = 0;
+    idt[vector].type_attr = type_attr;
+    idt[vector].offset_high = (offset >> 16) & 0xFFFF;
+}
+
+// Build and load IDT
+void idt_init(void) {
+    for (int i = 0; i < IDT_ENTRIES; i++) {
+        idt_set_gate(i, isr_stub_table[i], IDT_KERNEL_CS, IDT_GATE_INT32);
+        handlers[i] = NULL;
+    }
+    interrupt_reset_counts();
+    idt_load();
+
+    print_string("IDT: Loaded 256 vectors\n");
+}
+
+// Load IDT on this CPU
+void idt_load(void) {
+    struct idt_pointer idtr;
+    idtr.limit = sizeof(idt) - 1;
+    idtr.base = (uint32_t)idt;
+
+    asm volatile ("lidt %0" : : "m"(idtr));
+}
+
+// Register handler for any vector
+bool interrupt_register_handler(uint8_t vector, interrupt_handler_t handler) {
+    if (!handler || handlers[vector]) {
+        return false;
+    }
+
+    handlers[vector] = handler;
+    return true;
+}
+
+// Remove handler for vector
+void interrupt_unregister_handler(uint8_t vector) {
+    handlers[vector] = NULL;
+}
+
+// Register IRQ handler and unmask the line
+bool irq_register_handler(uint8_t irq, interrupt_handler_t handler) {
+    if (irq >= IRQ_COUNT) {
+        return false;
+    }
+
+    if (!interrupt_register_handler(IRQ_VECTOR(irq), handler)) {
+        return false;
+    }
+
+    irq_enable(irq);
+    return true;
+}
+
+// Run every handler chained on a shared line
+static void irq_shared_dispatch(struct interrupt_frame* frame) {
+    struct irq_action* action = irq_chains[frame->vector - IRQ_BASE];
+
+    for (; action; action = action->next) {
+        action->handler(frame);
+    }
+}
+
+// Chain handler onto a PCI line, programming it level/active low once
+bool irq_register_shared(uint8_t irq, interrupt_handler_t handler) {
+    if (irq >= IRQ_COUNT || !handler) {
+        return false;
+    }
+
+    uint32_t flags = irq_save();
+    interrupt_handler_t owner = handlers[IRQ_VECTOR(irq)];
+    struct irq_action* action = NULL;
+
+    if (!owner || owner == irq_shared_dispatch) {
+        for (int i = 0; i < IRQ_SHARED_MAX; i++) {
+            if (!irq_actions[i].handler) {
+                action = &irq_actions[i];
+                break;
+            }
+        }
+    }
+    if (!action) {
+        irq_restore(flags);
+        return false;
+    }
+
+    // Append so a dispatch in progress always sees a valid list
+    struct irq_action** link = &irq_chains[irq];
+    while (*link) {
+        link = &(*link)->next;
+    }
+    action->handler = handler;
+    action->next = NULL;
+    *link = action;
+    handlers[IRQ_VECTOR(irq)] = irq_shared_dispatch;
+    irq_restore(flags);
+
+    if (!owner) {
+        pic_set_level(irq);
+        ioapic_set_pci_irq(irq);
+        irq_enable(irq);
+    }
+    return true;
+}
+
+// Mask IRQ and remove its handler
+void irq_unregister_handler(uint8_t irq) {
+    if (irq >= IRQ_COUNT) {
+        return;
+    }
+
+    irq_disable(irq);
+    interrupt_unregister_handler(IRQ_VECTOR(irq));
+
+    // Release a shared chain too
+    while (irq_chains[irq]) {
+        struct irq_action* action = irq_chains[irq];
+        irq_chains[irq] = action->next;
+        action->handler = NULL;
+    }
+}
+
+// Unmask IRQ at whichever controller is active
+void irq_enable(uint8_t irq) {
+    if (apic_enabled()) {
+        ioapic_enable_irq(irq);
+    } else {
+        pic_enable_irq(irq);
+    }
+}
+
+// Mask IRQ at whichever controller is active
+void irq_disable(uint8_t irq) {
+    if (apic_enabled()) {
+        ioapic_disable_irq(irq);
+    } else {
+        pic_disable_irq(irq);
+    }
+}
+
+// Acknowledge IRQ at whichever controller is active
+void irq_send_eoi(uint8_t irq) {
+    if (apic_enabled()) {
+        lapic_eoi();
+    } else {
+        pic_send_eoi(irq);
+    }
+}
+
+// Get interrupt count for vector
+uint32_t interrupt_get_count(uint8_t vector) {
+    return stats[vector].count;
+}
+
+// Get statistics snapshot for vector
+struct interrupt_stats interrupt_get_stats(uint8_t vector) {
+    struct interrupt_stats copy;
+
+    uint32_t flags = irq_save();
+    copy.count = stats[vector].count;
+    copy.spurious = stats[vector].spurious;
+    copy.handled = stats[vector].handled;
+    copy.total_cycles = stats[vector].total_cycles;
+    copy.min_cycles = stats[vector].min_cycles;
+    copy.max_cycles = stats[vector].max_cycles;
+    irq_restore(flags);
+
+    return copy;
+}
+
+// Reset all counters
+void interrupt_reset_counts(void) {
+    uint32_t flags = irq_save();
+
+    for (int i = 0; i < IDT_ENTRIES; i++) {
+        stats[i].count = 0;
+        stats[i].spurious = 0;
+        stats[i].handled = 0;
+        stats[i].total_cycles = 0;
+        stats[i].min_cycles = ~0U;
+        stats[i].max_cycles = 0;
+    }
+
+    irq_restore(flags);
+}
+
+// Get human-readable source of a vector
+const char* interrupt_name(uint8_t vector) {
+    if (vector < EXCEPTION_COUNT) {
+        return exception_names[vector];
+    }
+    if (vector >= IRQ_BASE && vector < IRQ_BASE + IRQ_COUNT) {
+        return irq_names[vector - IRQ_BASE];
+    }
+
+    switch (vector) {
+    case APIC_TIMER_VECTOR:     return "LAPIC Timer";
+    case APIC_ERROR_VECTOR:     return "LAPIC Error";
+    case APIC_SPURIOUS_VECTOR:  return "LAPIC Spurious";
+    default:                    return "Software";
+    }
+}
+
+// Run handler and record how many cycles it took
+static void interrupt_run(volatile struct interrupt_stats* stat,
+                          interrupt_handler_t handler,
+                          struct interrupt_frame* frame) {
+    if (!handler) {
+        return;
+    }
+
+    // No usable TSC (pre-Pentium, or before clock_init): run untimed
+    if (!clock_tsc_khz()) {
+        handler(frame);
+        return;
+    }
+
+    uint64_t start = rdtsc();
+    handler(frame);
+    uint32_t cycles = (uint32_t)(rdtsc() - start);
+
+    stat->handled++;
+    stat->total_cycles += cycles;
+    if (cycles < stat->min_cycles) {
+        stat->min_cycles = cycles;
+    }
+    if (cycles > stat->max_cycles) {
+        stat->max_cycles = cycles;
+    }
+}
+
+// Common interrupt entry (called from isr_common)
+void interrupt_dispatch(struct interrupt_frame* frame) {
+    uint8_t vector = frame->vector;
+    interrupt_handler_t handler = handlers[vector];
+    volatile struct interrupt_stats* stat = &stats[vector];
+
+    stat->count++;
+
+    // Hardware IRQ
+    if (vector >= IRQ_BASE && vector < IRQ_BASE + IRQ_COUNT) {
+        uint8_t irq = vector - IRQ_BASE;
+
+        // 8259 spurious IRQ7/15: nothing in service, so no EOI (the master
+        // still saw the cascade for IRQ15)
+        if (!apic_enabled() && pic_is_spurious(irq)) {
+            stat->spurious++;
+            if (irq >= 8) {
+                pic_send_eoi(IRQ_CASCADE);
+            }
+            return;
+        }
+
+        interrupt_run(stat, handler, frame);
+        irq_send_eoi(irq);
+
+        // Acknowledged, so switching away cannot hold up this line
+        thread_preempt();
+        return;
+    }
+
+    // LAPIC spurious vector must not be acknowledged
+    if (vector == APIC_SPURIOUS_VECTOR) {
+        stat->spurious++;
+        return;
+    }
+
+    // LAPIC timer/error
+    if (vector >= APIC_LOCAL_VECTOR_BASE) {
+        interrupt_run(stat, handler, frame);
+        lapic_eoi();
+        thread_preempt();
+        return;
+    }
+
+    if (handler) {
+        interrupt_run(stat, handler, frame);
+        return;
+    }
+
+    // Unhandled CPU exception is fatal
+    if (vector < EXCEPTION_COUNT) {
+        kernel_panic(exception_names[vector], __FILE__, __LINE__);
+    }
+}
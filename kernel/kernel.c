@@ -5,6 +5,27 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include "idt.h"
+#include "pic.h"
+#include "acpi.h"
+#include "apic.h"
+#include "hpet.h"
+#include "timer.h"
+#include "idle.h"
+#include "clock.h"
+#include "math64.h"
+#include "page.h"
+#include "thread.h"
+#include "workqueue.h"
+#include "smp.h"
+#include "taskpool.h"
+#include "fat12.h"
+#include "spinlock.h"
+#include "ata.h"
+#include "block.h"
+#include "ahci.h"
+#include "virtio_blk.h"
+#include "iso9660.h"
 
 // VGA constants
 #define VGA_WIDTH 80
@@ -22,6 +43,23 @@ static uint16_t* terminal_buffer;
 static char input_buffer[INPUT_BUFFER_SIZE];
 static size_t buffer_index = 0;
 
+// Scancode queue (filled by IRQ1, drained by keyboard_handler)
+#define SCANCODE_QUEUE_SIZE 64
+
+// Parallel benchmark working set
+#define PBENCH_BYTES (4 * 1024 * 1024)
+
+// Disk benchmark read size
+#define DISKBENCH_SECTORS 2048
+
+// Sectors rewritten by writebench (one bio each)
+#define WRITEBENCH_SECTORS 256
+static volatile uint8_t scancode_queue[SCANCODE_QUEUE_SIZE];
+static volatile uint8_t scancode_head = 0;
+static volatile uint8_t scancode_tail = 0;
+static void keyboard_work_run(void* arg);
+static struct work keyboard_work = WORK_INIT(keyboard_work_run, NULL);
+
 // Filesystem status
 static bool filesystem_ready = false;
 
@@ -53,6 +91,7 @@ void terminal_clear(void);
 void print_string(const char* str);
 void keyboard_init(void);
 void keyboard_handler(void);
+void keyboard_process_scancode(uint8_t scancode);
 void process_command(const char* cmd);
 
 // Command functions
@@ -66,6 +105,22 @@ void mem_command(void);
 void about_command(void);
 void ls_command(const char* args);
 void cat_command(const char* args);
+void cdls_command(const char* args);
+void cdcat_command(const char* args);
+void rescan_command(void);
+void idle_command(void);
+void uptime_command(void);
+void irqstat_command(const char* args);
+void ps_command(void);
+void workq_command(const char* args);
+void cpus_command(void);
+void pbench_command(void);
+void fsck_command(void);
+void lockstat_command(const char* args);
+void diskbench_command(const char* args);
+void disks_command(void);
+void blkstat_command(const char* args);
+void writebench_command(const char* args);
 
 // External functions
 extern void loading_show(void);
@@ -73,8 +128,10 @@ extern uint8_t inb(uint16_t port);
 extern void outb(uint16_t port, uint8_t value);
 extern void fat12_list_directory(void);
 extern bool fat12_read_file(const char* filename, uint8_t* buffer, uint32_t max_size);
-extern bool ata_init(void);
 extern bool fat12_init(void);
+extern void sti(void);
+extern char* utoa(uint32_t value, char* str, int base);
+extern uint8_t memory_checksum(void* ptr, size_t size);
 
 // Command structure
 struct command {
@@ -98,6 +155,22 @@ static struct command commands[] = {
     {"dir", "List directory", ls_command},
     {"cat", "Show file contents", cat_command},
     {"type", "Show file contents", cat_command},
+    {"cdls", "List CD directory", cdls_command},
+    {"cdcat", "Show CD file contents", cdcat_command},
+    {"rescan", "Re-probe disks and mount", (void(*)(const char*))rescan_command},
+    {"idle", "CPU idle statistics", (void(*)(const char*))idle_command},
+    {"uptime", "Time since boot", (void(*)(const char*))uptime_command},
+    {"irqstat", "Interrupt statistics", irqstat_command},
+    {"ps", "List kernel threads", (void(*)(const char*))ps_command},
+    {"workq", "Work queue latency", workq_command},
+    {"cpus", "List online CPUs", (void(*)(const char*))cpus_command},
+    {"pbench", "Parallel scaling benchmark", (void(*)(const char*))pbench_command},
+    {"fsck", "Verify FAT chains", (void(*)(const char*))fsck_command},
+    {"lockstat", "Lock contention statistics", lockstat_command},
+    {"diskbench", "Disk PIO vs DMA throughput", diskbench_command},
+    {"disks", "List ATA drives", (void(*)(const char*))disks_command},
+    {"blkstat", "Block queue depth and merges", blkstat_command},
+    {"writebench", "Disk write flush batching", writebench_command},
 };
 
 #define COMMAND_COUNT (sizeof(commands) / sizeof(commands[0]))
@@ -262,6 +335,15 @@ void about_command(void) {
     print_string("╚══════════════════════════════════════╝\n");
 }
 
+// Bring up the disk controllers; true once any block device exists
+// (boot and rescan only: ATA re-probing IDENTIFYs drives that may be mounted)
+static bool storage_init(void) {
+    ata_init();
+    ahci_init();
+    virtio_blk_init();
+    return block_first() != NULL;
+}
+
 // Filesystem commands
 void ls_command(const char* args) {
     (void)args; // Not using args for now
@@ -273,9 +355,9 @@ void ls_command(const char* args) {
         print_string("Filesystem not initialized.\n");
         print_string("Trying to initialize...\n");
         
-        if (!ata_init() || !fat12_init()) {
+        if (!fat12_init()) {
             print_string("Failed to initialize filesystem.\n");
-            print_string("Make sure a FAT12 disk is present.\n");
+            print_string("Make sure a FAT12 disk is present ('rescan' after attaching one).\n");
             return;
         }
         filesystem_ready = true;
@@ -296,7 +378,7 @@ void cat_command(const char* args) {
         return;
     }
     
-    uint8_t buffer[4096];  // 4KB buffer for files
+    static uint8_t buffer[4096];  // 4KB buffer for files (too big for a worker stack)
     
     print_string("\n");
     print_string("File: ");
@@ -318,43 +400,809 @@ void cat_command(const char* args) {
     print_string("\n");
 }
 
-// Keyboard handling (unchanged)
+// Mount the CD volume on first use (disks found at boot or by rescan)
+static bool cdrom_ready(void) {
+    if (iso9660_is_mounted()) {
+        return true;
+    }
+    if (!iso9660_init()) {
+        print_string("No ISO9660 volume found.\n");
+        return false;
+    }
+    return true;
+}
+
+// Probe the controllers again and mount whatever is not mounted yet
+void rescan_command(void) {
+    print_string("\n");
+    if (!storage_init()) {
+        print_string("No block device found.\n");
+        return;
+    }
+    
+    if (!filesystem_ready && fat12_init()) {
+        filesystem_ready = true;
+    }
+    if (!iso9660_is_mounted()) {
+        iso9660_init();
+    }
+    
+    print_string("Filesystem: ");
+    print_string(filesystem_ready ? "FAT12 (Ready)\n" : "Not available\n");
+    if (iso9660_is_mounted()) {
+        print_string("CD-ROM: ISO9660 (");
+        print_string(iso9660_volume_label());
+        print_string(")\n");
+    }
+}
+
+// ISO9660 directory listing
+void cdls_command(const char* args) {
+    char num[16];
+    uint32_t hits, misses;
+    
+    if (!cdrom_ready()) {
+        return;
+    }
+    
+    print_string("\nVolume ");
+    print_string(iso9660_volume_label());
+    print_string(": /");
+    print_string(args && args[0] == '/' ? args + 1 : (args ? args : ""));
+    print_string("\n");
+    iso9660_list_directory(args);
+    
+    iso9660_get_cache_stats(&hits, &misses);
+    print_string("Directory cache: ");
+    print_string(utoa(hits, num, 10));
+    print_string(" hits, ");
+    print_string(utoa(misses, num, 10));
+    print_string(" misses\n");
+}
+
+// ISO9660 file contents
+void cdcat_command(const char* args) {
+    static uint8_t buffer[16384];   // Too big for a worker stack
+    uint32_t size;
+    
+    if (!args || !args[0]) {
+        print_string("Usage: cdcat <path>\n");
+        return;
+    }
+    if (!cdrom_ready()) {
+        return;
+    }
+    
+    print_string("\n");
+    if (!iso9660_read_file(args, buffer, sizeof(buffer), &size)) {
+        print_string("Error: Cannot read file '");
+        print_string(args);
+        print_string("'\n");
+        print_string("File may not exist or is too large.\n");
+        return;
+    }
+    for (uint32_t i = 0; i < size; i++) {
+        terminal_putchar(buffer[i]);
+    }
+    print_string("\n");
+}
+
+// Idle accounting
+void idle_command(void) {
+    struct idle_stats stats = idle_get_stats();
+    uint32_t idle_ms = (uint32_t)div_u64(stats.idle_ns, NSEC_PER_MSEC);
+    uint32_t busy_ms = (uint32_t)div_u64(stats.busy_ns, NSEC_PER_MSEC);
+    uint32_t total_ms = idle_ms + busy_ms;
+    char num[16];
+    
+    print_string("\nCPU Idle Statistics:\n");
+    print_string("====================\n");
+    
+    print_string("Idle time:  ");
+    print_string(utoa(idle_ms, num, 10));
+    print_string(" ms\nBusy time:  ");
+    print_string(utoa(busy_ms, num, 10));
+    print_string(" ms\nHalts:      ");
+    print_string(utoa(stats.halts, num, 10));
+    print_string("\nWakeups:    ");
+    print_string(utoa(stats.wakeups, num, 10));
+    print_string("\nTimer IRQs: ");
+    print_string(utoa(interrupt_get_count(IRQ_VECTOR(IRQ_TIMER)) +
+                      interrupt_get_count(APIC_TIMER_VECTOR), num, 10));
+    print_string(timer_is_tickless() ? " (tickless)\n" : " (periodic)\n");
+    
+    if (total_ms > 0) {
+        print_string("Idle:       ");
+        print_string(utoa((uint32_t)div_u64((uint64_t)idle_ms * 100, total_ms), num, 10));
+        print_string("%\n");
+    }
+}
+
+// Monotonic clock
+void uptime_command(void) {
+    uint32_t ms = (uint32_t)clock_ms();
+    uint32_t frac = ms % 1000;
+    char num[16];
+    
+    print_string("Uptime: ");
+    print_string(utoa(ms / 1000, num, 10));
+    print_string(".");
+    if (frac < 100) print_string("0");
+    if (frac < 10) print_string("0");
+    print_string(utoa(frac, num, 10));
+    print_string(" s\n");
+    
+    if (clock_tsc_khz()) {
+        print_string("Clock:  TSC ");
+        print_string(utoa(clock_tsc_khz(), num, 10));
+        print_string(" kHz");
+        print_string(clock_tsc_invariant() ? " (invariant)\n" : "\n");
+    } else {
+        print_string(hpet_available() ? "Clock:  HPET\n" : "Clock:  PIT ticks\n");
+    }
+}
+
+// Print string left-aligned in a fixed-width column
+static void print_padded(const char* str, size_t width) {
+    size_t len = strlen(str);
+    print_string(str);
+    while (len++ < width) print_string(" ");
+}
+
+// Per-vector interrupt statistics
+void irqstat_command(const char* args) {
+    char num[16];
+    
+    if (args && strcmp(args, "reset") == 0) {
+        interrupt_reset_counts();
+        print_string("Interrupt statistics reset\n");
+        return;
+    }
+    
+    print_string("\nInterrupt Statistics (handler time in TSC cycles):\n");
+    print_padded("Vec", 5);
+    print_padded("Source", 16);
+    print_padded("Count", 10);
+    print_padded("Spur", 6);
+    print_padded("Min", 8);
+    print_padded("Avg", 8);
+    print_padded("Max", 9);
+    print_string("Total ms\n");
+    
+    for (int vector = 0; vector < IDT_ENTRIES; vector++) {
+        struct interrupt_stats stats = interrupt_get_stats(vector);
+        if (stats.count == 0) continue;
+        
+        uint32_t avg = stats.handled ? (uint32_t)div_u64(stats.total_cycles, stats.handled) : 0;
+        
+        print_string("0x");
+        print_padded(utoa(vector, num, 16), 3);
+        print_padded(interrupt_name(vector), 16);
+        print_padded(utoa(stats.count, num, 10), 10);
+        print_padded(utoa(stats.spurious, num, 10), 6);
+        print_padded(utoa(stats.handled ? stats.min_cycles : 0, num, 10), 8);
+        print_padded(utoa(avg, num, 10), 8);
+        print_padded(utoa(stats.max_cycles, num, 10), 9);
+        if (clock_tsc_khz()) {
+            print_string(utoa((uint32_t)div_u64(clock_cycles_to_ns(stats.total_cycles), NSEC_PER_MSEC), num, 10));
+        } else {
+            print_string("-");
+        }
+        print_string("\n");
+    }
+}
+
+// Kernel thread list
+void ps_command(void) {
+    char num[16];
+    uint64_t now = clock_ns();
+    
+    print_string("\n");
+    print_padded("TID", 5);
+    print_padded("State", 10);
+    print_padded("CPU ms", 10);
+    print_padded("Switches", 10);
+    print_string("Name\n");
+    
+    for (int slot = 0; slot < THREAD_MAX; slot++) {
+        const struct thread* t = thread_get(slot);
+        if (!t) continue;
+        
+        // Include the slice the running thread is in right now
+        uint64_t runtime = t->runtime_ns;
+        if (t->state == THREAD_RUNNING) {
+            runtime += now - t->last_run_ns;
+        }
+        
+        print_padded(utoa(t->tid, num, 10), 5);
+        print_padded(thread_state_name(t->state), 10);
+        print_padded(utoa((uint32_t)div_u64(runtime, NSEC_PER_MSEC), num, 10), 10);
+        print_padded(utoa(t->switches, num, 10), 10);
+        print_string(t->name);
+        print_string("\n");
+    }
+}
+
+// Online CPU list
+void cpus_command(void) {
+    char num[16];
+    
+    print_string("\n");
+    print_padded("CPU", 5);
+    print_padded("APIC", 6);
+    print_padded("Wakeups", 10);
+    print_string("Role\n");
+    
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        struct cpu* cpu = smp_get_cpu(i);
+        if (!cpu) continue;
+        
+        print_padded(utoa(cpu->index, num, 10), 5);
+        print_padded(utoa(cpu->apic_id, num, 10), 6);
+        print_padded(utoa(cpu->wakeups, num, 10), 10);
+        print_string(i == 0 ? "BSP\n" : "AP\n");
+    }
+    
+    print_string("Online mask: 0x");
+    print_string(utoa(smp_online_mask(), num, 16));
+    print_string("\n");
+}
+
+// Print hundredths as "N.NN"
+static void print_fixed2(uint32_t hundredths) {
+    char num[16];
+    print_string(utoa(hundredths / 100, num, 10));
+    print_string(".");
+    if (hundredths % 100 < 10) print_string("0");
+    print_string(utoa(hundredths % 100, num, 10));
+}
+
+// Time parallel checksum and FAT check on 1, 2, 4... CPUs
+void pbench_command(void) {
+    char num[16];
+    uint32_t online = smp_cpu_count();
+    uint32_t saved = taskpool_workers();
+    
+    if (!clock_highres()) {
+        print_string("pbench: Needs TSC or HPET for timing\n");
+        return;
+    }
+    
+    uint8_t* data = (uint8_t*)page_alloc(PBENCH_BYTES / PAGE_SIZE);
+    if (!data) {
+        print_string("pbench: Not enough memory\n");
+        return;
+    }
+    for (uint32_t i = 0; i < PBENCH_BYTES; i++) {
+        data[i] = (uint8_t)(i * 31 + 7);
+    }
+    
+    print_string("\nChecksum of 4MB, FAT chain check:\n");
+    print_padded("CPUs", 6);
+    print_padded("Sum us", 10);
+    print_padded("Speedup", 9);
+    print_string(filesystem_ready ? "FAT us\n" : "\n");
+    
+    uint64_t base_ns = 0;
+    uint32_t workers = 1;
+    while (1) {
+        taskpool_set_workers(workers);
+        
+        uint64_t start = clock_ns();
+        memory_checksum(data, PBENCH_BYTES);
+        uint64_t elapsed = clock_ns() - start;
+        if (!base_ns) base_ns = elapsed;
+        
+        print_padded(utoa(workers, num, 10), 6);
+        print_padded(utoa((uint32_t)div_u64(elapsed, NSEC_PER_USEC), num, 10), 10);
+        print_fixed2(elapsed ? (uint32_t)div_u64(base_ns * 100, (uint32_t)elapsed) : 0);
+        print_string("x    ");
+        
+        if (filesystem_ready) {
+            fat12_check_t check;
+            start = clock_ns();
+            fat12_verify_chains(&check);
+            print_string(utoa((uint32_t)div_u64(clock_ns() - start, NSEC_PER_USEC), num, 10));
+        }
+        print_string("\n");
+        
+        // 1, 2, 4... and finally every online CPU
+        if (workers == online) break;
+        workers = workers * 2 > online ? online : workers * 2;
+    }
+    
+    taskpool_set_workers(saved);
+    page_free(data, PBENCH_BYTES / PAGE_SIZE);
+}
+
+// Time one sequential read, return microseconds (0 on failure)
+static uint32_t diskbench_read(uint32_t drive, uint8_t* buffer, uint32_t sectors) {
+    uint64_t start = clock_ns();
+    if (!ata_read(drive, 0, sectors, buffer)) {
+        return 0;
+    }
+    uint32_t elapsed_us = (uint32_t)div_u64(clock_ns() - start, NSEC_PER_USEC);
+    return elapsed_us ? elapsed_us : 1;
+}
+
+// Time the same read on two drives at once, return microseconds (0 on failure)
+static uint32_t diskbench_read_pair(uint32_t drive, uint32_t other, uint8_t* buffer,
+                                    uint8_t* other_buffer, uint32_t sectors) {
+    struct ata_request req;
+    struct ata_request other_req;
+    
+    ata_request_init(&req, drive, 0, sectors, buffer, false, NULL, NULL);
+    ata_request_init(&other_req, other, 0, sectors, other_buffer, false, NULL, NULL);
+    
+    uint64_t start = clock_ns();
+    if (!ata_submit(&req)) {
+        return 0;
+    }
+    bool ok = ata_submit(&other_req) && ata_request_wait(&other_req);
+    ok = ata_request_wait(&req) && ok;
+    if (!ok) {
+        return 0;
+    }
+    uint32_t elapsed_us = (uint32_t)div_u64(clock_ns() - start, NSEC_PER_USEC);
+    return elapsed_us ? elapsed_us : 1;
+}
+
+// Print one diskbench result row
+static void diskbench_row(const char* mode, uint32_t bytes, uint32_t elapsed_us) {
+    char num[16];
+    
+    print_padded(mode, 6);
+    if (!elapsed_us) {
+        print_string("read failed\n");
+        return;
+    }
+    print_padded(utoa(elapsed_us, num, 10), 10);
+    print_fixed2((uint32_t)div_u64(div_u64((uint64_t)bytes * 100000000ULL, elapsed_us), 1024 * 1024));
+    print_string("\n");
+}
+
+// Compare PIO, bus-master DMA and both channels at once
+void diskbench_command(const char* args) {
+    char num[16];
+    uint64_t total_sectors;
+    int drive = ata_boot_drive();
+    
+    if (args && args[0] >= '0' && args[0] < '0' + ATA_MAX_DRIVES && args[1] == '\0') {
+        drive = args[0] - '0';
+    }
+    
+    if (!clock_highres()) {
+        print_string("diskbench: Needs TSC or HPET for timing\n");
+        return;
+    }
+    if (drive < 0 || !ata_get_drive_info(drive, NULL, NULL, &total_sectors)) {
+        print_string("diskbench: No ATA drive\n");
+        return;
+    }
+    
+    uint32_t sectors = DISKBENCH_SECTORS;
+    if (sectors > total_sectors) sectors = total_sectors;
+    
+    // A drive on the other channel, for the concurrent run
+    int other = -1;
+    uint64_t other_sectors;
+    for (int i = 0; i < ATA_MAX_DRIVES; i++) {
+        if (i / 2 != drive / 2 && ata_get_drive_info(i, NULL, NULL, &other_sectors) &&
+            other_sectors >= sectors) {
+            other = i;
+            break;
+        }
+    }
+    
+    uint32_t pages = DISKBENCH_SECTORS * 512 / PAGE_SIZE;
+    uint8_t* buffer = (uint8_t*)page_alloc(pages * 2);
+    if (!buffer) {
+        print_string("diskbench: Not enough memory\n");
+        return;
+    }
+    
+    bool saved = ata_dma_enabled();
+    uint32_t bytes = sectors * 512;
+    
+    print_string("\nSequential read of ");
+    print_string(utoa(bytes / 1024, num, 10));
+    print_string(" KB from LBA 0 of hd");
+    print_string(utoa(drive, num, 10));
+    print_string(":\n");
+    print_padded("Mode", 6);
+    print_padded("Time us", 10);
+    print_string("MB/s\n");
+    
+    for (int mode = 0; mode < 2; mode++) {
+        bool dma = mode == 1;
+        if (dma && !ata_dma_available()) {
+            print_string("DMA   (not available)\n");
+            break;
+        }
+        ata_set_dma(dma);
+        diskbench_row(dma ? "DMA" : "PIO", bytes, diskbench_read(drive, buffer, sectors));
+    }
+    
+    // Same read on both channels: each has its own queue and IRQ
+    if (other >= 0) {
+        print_string("Both  (hd");
+        print_string(utoa(drive, num, 10));
+        print_string(" + hd");
+        print_string(utoa(other, num, 10));
+        print_string(")\n");
+        diskbench_row("", bytes * 2,
+                      diskbench_read_pair(drive, other, buffer, buffer + pages * PAGE_SIZE, sectors));
+    }
+    
+    ata_set_dma(saved);
+    page_free(buffer, pages * 2);
+}
+
+// Time one way of rewriting the benchmark area, return microseconds (0 on failure)
+static uint32_t writebench_run(struct block_device* dev, int mode, uint64_t start,
+                               uint8_t* buffer, struct bio* bios, uint32_t sectors) {
+    uint64_t begin = clock_ns();
+    bool ok = true;
+    
+    if (mode == 2) {
+        // Everything queued at once: the elevator merges it into few commands
+        uint32_t queued = 0;
+        for (; queued < sectors; queued++) {
+            bio_init(&bios[queued], start + queued, 1, buffer + queued * 512, true, NULL, NULL);
+            if (!block_submit(dev, &bios[queued])) {
+                ok = false;
+                break;
+            }
+        }
+        for (uint32_t i = 0; i < queued; i++) {
+            if (!bio_wait(&bios[i])) {
+                ok = false;
+            }
+        }
+    } else {
+        // One sector at a time, flushed each time (old behaviour) or once
+        for (uint32_t i = 0; ok && i < sectors; i++) {
+            ok = block_write(dev, start + i, 1, buffer + i * 512) &&
+                 (mode == 1 || block_flush(dev));
+        }
+    }
+    if (!ok || !block_flush(dev)) {
+        return 0;
+    }
+    
+    uint32_t elapsed_us = (uint32_t)div_u64(clock_ns() - begin, NSEC_PER_USEC);
+    return elapsed_us ? elapsed_us : 1;
+}
+
+// Sequential write throughput: per-sector flush vs one flush at the end
+void writebench_command(const char* args) {
+    static const char* mode_names[] = { "Flush/sector", "One flush", "Queued+flush" };
+    char num[16];
+    struct block_device* dev = (args && *args) ? block_get(args) : block_first();
+    
+    if (!clock_highres()) {
+        print_string("writebench: Needs TSC or HPET for timing\n");
+        return;
+    }
+    if (!dev || dev->sectors < WRITEBENCH_SECTORS) {
+        print_string("writebench: No such block device\n");
+        return;
+    }
+    
+    // Rewrite the last sectors of the disk with their own contents
+    uint32_t sectors = WRITEBENCH_SECTORS;
+    uint64_t start = dev->sectors - sectors;
+    uint32_t data_pages = sectors * 512 / PAGE_SIZE;
+    uint32_t bio_pages = (sectors * sizeof(struct bio) + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint8_t* buffer = (uint8_t*)page_alloc(data_pages);
+    struct bio* bios = (struct bio*)page_alloc(bio_pages);
+    
+    if (!buffer || !bios) {
+        print_string("writebench: Not enough memory\n");
+        if (buffer) page_free(buffer, data_pages);
+        if (bios) page_free(bios, bio_pages);
+        return;
+    }
+    if (!block_read(dev, start, sectors, buffer)) {
+        print_string("writebench: Read failed\n");
+        page_free(buffer, data_pages);
+        page_free(bios, bio_pages);
+        return;
+    }
+    
+    uint32_t bytes = sectors * 512;
+    print_string("\nSequential 512-byte writes, ");
+    print_string(utoa(bytes / 1024, num, 10));
+    print_string(" KB at the end of ");
+    print_string(dev->name);
+    print_string(":\n");
+    print_padded("Mode", 14);
+    print_padded("Time us", 10);
+    print_string("MB/s\n");
+    
+    for (int mode = 0; mode < 3; mode++) {
+        uint32_t elapsed_us = writebench_run(dev, mode, start, buffer, bios, sectors);
+        
+        print_padded(mode_names[mode], 14);
+        if (!elapsed_us) {
+            print_string("write failed\n");
+            continue;
+        }
+        print_padded(utoa(elapsed_us, num, 10), 10);
+        print_fixed2((uint32_t)div_u64(div_u64((uint64_t)bytes * 100000000ULL, elapsed_us), 1024 * 1024));
+        print_string("\n");
+    }
+    
+    page_free(bios, bio_pages);
+    page_free(buffer, data_pages);
+}
+
+// List detected ATA drives
+void disks_command(void) {
+    static const char* positions[] = { "pri master", "pri slave", "sec master", "sec slave" };
+    char num[16];
+    char model[41];
+    uint64_t total_sectors;
+    bool found = false;
+    
+    print_string("\n");
+    print_padded("Drive", 7);
+    print_padded("Position", 12);
+    print_padded("Size MB", 10);
+    print_string("Model\n");
+    
+    for (int drive = 0; drive < ATA_MAX_DRIVES; drive++) {
+        if (!ata_get_drive_info(drive, model, NULL, &total_sectors)) {
+            continue;
+        }
+        found = true;
+        
+        print_padded(ata_drive_name(drive), 7);
+        print_padded(positions[drive], 12);
+        print_padded(utoa((uint32_t)(total_sectors >> 11), num, 10), 10);
+        print_string(model);
+        print_string(drive == ata_boot_drive() ? " (boot)\n" : "\n");
+    }
+    
+    if (!found) {
+        print_string("No ATA drives\n");
+    }
+}
+
+// FAT chain consistency check
+void fsck_command(void) {
+    char num[16];
+    fat12_check_t check;
+    
+    if (!filesystem_ready) {
+        print_string("Filesystem not ready. Use 'ls' first.\n");
+        return;
+    }
+    
+    bool ok = fat12_verify_chains(&check);
+    
+    print_string("\nClusters:     ");
+    print_string(utoa(check.clusters, num, 10));
+    print_string("\nFree:         ");
+    print_string(utoa(check.free, num, 10));
+    print_string("\nChains:       ");
+    print_string(utoa(check.chains, num, 10));
+    print_string("\nBad:          ");
+    print_string(utoa(check.bad, num, 10));
+    print_string("\nInvalid:      ");
+    print_string(utoa(check.invalid, num, 10));
+    print_string("\nCross-linked: ");
+    print_string(utoa(check.crosslinked, num, 10));
+    print_string(ok ? "\nFAT is consistent\n" : "\nFAT has errors\n");
+}
+
+// Block layer queue depth and merge ratio per device
+void blkstat_command(const char* args) {
+    char num[16];
+    
+    if (args && strcmp(args, "reset") == 0) {
+        for (struct block_device* dev = block_first(); dev; dev = dev->next) {
+            block_reset_stats(dev);
+        }
+        print_string("Block statistics reset\n");
+        return;
+    }
+    
+    if (!block_first()) {
+        print_string("No block devices\n");
+        return;
+    }
+    
+    print_string("\nBlock Queues (merge = bios per command, tags = most commands in flight):\n");
+    print_padded("Dev", 6);
+    print_padded("Bios", 8);
+    print_padded("Cmds", 8);
+    print_padded("Merge", 7);
+    print_padded("Avg q", 7);
+    print_padded("Max q", 7);
+    print_padded("Bounced", 9);
+    print_padded("Flushes", 9);
+    print_padded("Tags", 6);
+    print_padded("Errors", 8);
+    print_string("KB\n");
+    
+    for (struct block_device* dev = block_first(); dev; dev = dev->next) {
+        struct block_stats stats = block_get_stats(dev);
+        
+        print_padded(dev->name, 6);
+        print_padded(utoa(stats.bios, num, 10), 8);
+        print_padded(utoa(stats.requests, num, 10), 8);
+        print_fixed2(stats.requests ? stats.bios * 100 / stats.requests : 0);
+        print_string("   ");
+        print_fixed2(stats.bios ? (uint32_t)div_u64(stats.depth_sum * 100, stats.bios) : 0);
+        print_string("   ");
+        print_padded(utoa(stats.max_depth, num, 10), 7);
+        print_padded(utoa(stats.bounced, num, 10), 9);
+        print_padded(utoa(stats.flushes, num, 10), 9);
+        print_padded(utoa(stats.max_in_flight, num, 10), 6);
+        print_padded(utoa(stats.errors + stats.aborted, num, 10), 8);
+        print_string(utoa((uint32_t)(stats.sectors / 2), num, 10));
+        print_string("\n");
+    }
+    
+    uint32_t submitted, kicks, interrupts;
+    virtio_blk_get_stats(&submitted, &kicks, &interrupts);
+    if (submitted) {
+        print_string("\nVirtio: ");
+        print_string(utoa(submitted, num, 10));
+        print_string(" requests, ");
+        print_string(utoa(kicks, num, 10));
+        print_string(" notifications, ");
+        print_string(utoa(interrupts, num, 10));
+        print_string(" interrupts\n");
+    }
+}
+
+// Per-lock acquisition and contention counters
+void lockstat_command(const char* args) {
+    static const char* type_names[] = { "spin", "rw", "seq" };
+    char num[16];
+    
+    if (args && strcmp(args, "reset") == 0) {
+        lockstat_reset();
+        print_string("Lock statistics reset\n");
+        return;
+    }
+    
+    print_string("\nLock Statistics (reads: RW read holds; seqlock readers only count retries):\n");
+    print_padded("Name", 10);
+    print_padded("Type", 6);
+    print_padded("Acquired", 10);
+    print_padded("Contended", 11);
+    print_padded("Avg spin", 10);
+    print_padded("Reads", 9);
+    print_string("Retried\n");
+    
+    for (struct lock_stats* stats = lockstat_first(); stats; stats = stats->next) {
+        uint32_t avg = stats->contended ? (uint32_t)div_u64(stats->spins, stats->contended) : 0;
+        
+        print_padded(stats->name, 10);
+        print_padded(type_names[stats->type], 6);
+        print_padded(utoa(stats->acquisitions, num, 10), 10);
+        print_padded(utoa(stats->contended, num, 10), 11);
+        print_padded(utoa(avg, num, 10), 10);
+        print_padded(stats->type == LOCK_SEQ ? "-" : utoa(stats->reads, num, 10), 9);
+        print_string(utoa(stats->read_retries, num, 10));
+        print_string("\n");
+    }
+}
+
+// Work queue latency statistics
+void workq_command(const char* args) {
+    char num[16];
+    bool reset = args && strcmp(args, "reset") == 0;
+    
+    if (!reset) {
+        print_string("\nWork Queues (latency = queued to started, in us):\n");
+        print_padded("Name", 12);
+        print_padded("Queued", 8);
+        print_padded("Run", 8);
+        print_padded("Merged", 8);
+        print_padded("Peak", 6);
+        print_padded("Min", 7);
+        print_padded("Avg", 7);
+        print_padded("Max", 8);
+        print_string("Run max\n");
+    }
+    
+    for (int i = 0; i < WORKQUEUE_MAX; i++) {
+        struct work_queue* wq = work_queue_get(i);
+        if (!wq) continue;
+        
+        if (reset) {
+            work_queue_reset_stats(wq);
+            continue;
+        }
+        
+        struct work_queue_stats stats = work_queue_get_stats(wq);
+        uint64_t avg = stats.completed ? div_u64(stats.total_wait_ns, stats.completed) : 0;
+        uint64_t min = stats.completed ? stats.min_wait_ns : 0;
+        
+        print_padded(wq->name, 12);
+        print_padded(utoa(stats.queued, num, 10), 8);
+        print_padded(utoa(stats.completed, num, 10), 8);
+        print_padded(utoa(stats.coalesced, num, 10), 8);
+        print_padded(utoa(stats.max_depth, num, 10), 6);
+        print_padded(utoa((uint32_t)div_u64(min, NSEC_PER_USEC), num, 10), 7);
+        print_padded(utoa((uint32_t)div_u64(avg, NSEC_PER_USEC), num, 10), 7);
+        print_padded(utoa((uint32_t)div_u64(stats.max_wait_ns, NSEC_PER_USEC), num, 10), 8);
+        print_string(utoa((uint32_t)div_u64(stats.max_run_ns, NSEC_PER_USEC), num, 10));
+        print_string("\n");
+    }
+    
+    if (reset) {
+        print_string("Work queue statistics reset\n");
+    }
+}
+
+// Keyboard handling: IRQ1 only queues the scancode
+static void keyboard_irq(struct interrupt_frame* frame) {
+    (void)frame;
+    
+    uint8_t scancode = inb(0x60);
+    uint8_t next = (scancode_head + 1) % SCANCODE_QUEUE_SIZE;
+    
+    // Drop key if queue is full
+    if (next != scancode_tail) {
+        scancode_queue[scancode_head] = scancode;
+        scancode_head = next;
+        schedule_work(&keyboard_work);
+    }
+}
+
+// Decoding and command dispatch run in the events worker
+static void keyboard_work_run(void* arg) {
+    (void)arg;
+    keyboard_handler();
+}
+
 void keyboard_init(void) {
     outb(0x64, 0xAE);  // Enable keyboard
+    irq_register_handler(IRQ_KEYBOARD, keyboard_irq);
 }
 
+// Drain scancodes queued by IRQ1
 void keyboard_handler(void) {
-    if (inb(0x64) & 0x01) {
-        uint8_t scancode = inb(0x60);
-        
-        if (scancode == 0x1C) {  // Enter
-            if (buffer_index > 0) {
-                input_buffer[buffer_index] = '\0';
-                print_string("\n");
-                process_command(input_buffer);
-                buffer_index = 0;
-            }
-            print_string("bloodg> ");
-        } else if (scancode == 0x0E) {  // Backspace
-            if (buffer_index > 0) {
-                buffer_index--;
-                input_buffer[buffer_index] = '\0';
-                terminal_putchar('\b');
+    while (scancode_tail != scancode_head) {
+        uint8_t scancode = scancode_queue[scancode_tail];
+        scancode_tail = (scancode_tail + 1) % SCANCODE_QUEUE_SIZE;
+        keyboard_process_scancode(scancode);
+    }
+}
+
+void keyboard_process_scancode(uint8_t scancode) {
+    if (scancode == 0x1C) {  // Enter
+        if (buffer_index > 0) {
+            input_buffer[buffer_index] = '\0';
+            print_string("\n");
+            process_command(input_buffer);
+            buffer_index = 0;
+        }
+        print_string("bloodg> ");
+    } else if (scancode == 0x0E) {  // Backspace
+        if (buffer_index > 0) {
+            buffer_index--;
+            input_buffer[buffer_index] = '\0';
+            terminal_putchar('\b');
+        }
+    } else if (scancode < 0x80) {
+        // Simple scancode to ASCII
+        char* keymap = "1234567890-=qwertyuiop[]asdfghjkl;'`\\zxcvbnm,./";
+        if (scancode >= 0x02 && scancode < 0x36) {
+            char c = keymap[scancode - 0x02];
+            if (buffer_index < INPUT_BUFFER_SIZE - 1) {
+                input_buffer[buffer_index++] = c;
+                terminal_putchar(c);
             }
-        } else if (scancode < 0x80) {
-            // Simple scancode to ASCII
-            char* keymap = "1234567890-=qwertyuiop[]asdfghjkl;'`\\zxcvbnm,./";
-            if (scancode >= 0x02 && scancode < 0x36) {
-                char c = keymap[scancode - 0x02];
-                if (buffer_index < INPUT_BUFFER_SIZE - 1) {
-                    input_buffer[buffer_index++] = c;
-                    terminal_putchar(c);
-                }
-            } else if (scancode == 0x39) {  // Space
-                if (buffer_index < INPUT_BUFFER_SIZE - 1) {
-                    input_buffer[buffer_index++] = ' ';
-                    terminal_putchar(' ');
-                }
+        } else if (scancode == 0x39) {  // Space
+            if (buffer_index < INPUT_BUFFER_SIZE - 1) {
+                input_buffer[buffer_index++] = ' ';
+                terminal_putchar(' ');
             }
         }
     }
@@ -396,8 +1244,38 @@ int kmain(void) {
     // Show loading screen
     loading_show();
     
+    // Per-CPU GDT and GS for the boot CPU
+    smp_early_init();
+    
+    // Initialize interrupts
+    idt_init();
+    pic_init();
+    pic_mask_all();
+    page_init();
+    acpi_init();
+    hpet_init();
+    clock_init();
+    
+    // Move to LAPIC/IOAPIC before any IRQ is unmasked
+    apic_init();
+    timer_init(TIMER_DEFAULT_HZ);
+    
+    // Stop the 1kHz tick when the TSC/HPET can keep time
+    if (timer_set_tickless(true)) {
+        print_string("Timer: Tickless mode\n");
+    }
+    
+    // Wake the other cores (they idle until given work)
+    smp_init();
+    taskpool_init();
+    
+    // Boot stack becomes thread 0; the shell runs from the events worker
+    thread_init();
+    workqueue_init();
+    
     // Initialize hardware
     keyboard_init();
+    sti();
     
     // Show welcome message
     print_string("\n\n");
@@ -409,22 +1287,26 @@ int kmain(void) {
     print_string("Filesystem: ");
     
     // Try to initialize filesystem
-    if (ata_init() && fat12_init()) {
+    if (storage_init() && fat12_init()) {
         filesystem_ready = true;
         print_string("FAT12 (Ready)\n");
     } else {
         print_string("Not available\n");
     }
     
+    // Data files shipped on the boot CD
+    if (iso9660_init()) {
+        print_string("CD-ROM: ISO9660 (");
+        print_string(iso9660_volume_label());
+        print_string(")\n");
+    }
+    
     print_string("Type 'help' for commands\n\n");
     print_string("bloodg> ");
     
-    // Main loop
+    // Main loop: input is handled by keyboard_work, so just idle
     while (1) {
-        keyboard_handler();
-        
-        // Simple delay
-        for (volatile int i = 0; i < 10000; i++);
+        idle_wait();
     }
     
     return 0;
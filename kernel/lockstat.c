@@ -0,0 +1,43 @@
+/**************************************************************
+ * Lock Statistics - BloodG OS
+ * Registry of every spinlock, RW lock and seqlock in use
+ **************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "io.h"
+#include "spinlock.h"
+
+// Registered locks (pushed lock-free, never removed)
+static struct lock_stats* volatile lock_list = NULL;
+
+// Add lock to list
+void lockstat_register(struct lock_stats* stats) {
+    // First caller wins; everyone else sees it already registered
+    if (!__sync_bool_compare_and_swap(&stats->registered, 0, 1)) {
+        return;
+    }
+
+    struct lock_stats* head;
+    do {
+        head = lock_list;
+        stats->next = head;
+    } while (!__sync_bool_compare_and_swap(&lock_list, head, stats));
+}
+
+// Get first lock
+struct lock_stats* lockstat_first(void) {
+    return lock_list;
+}
+
+// Zero all counters
+void lockstat_reset(void) {
+    for (struct lock_stats* stats = lock_list; stats; stats = stats->next) {
+        stats->acquisitions = 0;
+        stats->contended = 0;
+        stats->spins = 0;
+        stats->reads = 0;
+        stats->read_retries = 0;
+    }
+}
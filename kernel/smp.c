@@ -0,0 +1,237 @@
+/**************************************************************
+ * SMP Bring-up - BloodG OS
+ * INIT-SIPI-SIPI startup of application processors
+ **************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "io.h"
+#include "idt.h"
+#include "acpi.h"
+#include "apic.h"
+#include "clock.h"
+#include "page.h"
+#include "timer.h"
+#include "taskpool.h"
+#include "smp.h"
+
+// Trampoline image and its parameter slots (boot/trampoline.asm)
+extern uint8_t smp_trampoline_start[];
+extern uint8_t smp_trampoline_end[];
+extern uint8_t smp_trampoline_stack[];
+extern uint8_t smp_trampoline_entry[];
+extern uint8_t smp_trampoline_cpu[];
+
+// Segment descriptor bits
+#define GDT_ACCESS_CODE     0x9A    // Present, ring 0, execute/read
+#define GDT_ACCESS_DATA     0x92    // Present, ring 0, read/write
+#define GDT_FLAGS_4K        0xC     // 4KB granularity, 32-bit
+#define GDT_FLAGS_BYTE      0x4     // Byte granularity, 32-bit
+
+// SIPI vector is the trampoline's page number
+#define SIPI_VECTOR         (SMP_TRAMPOLINE_ADDR >> 12)
+
+// CPU state
+static struct cpu cpus[SMP_MAX_CPUS] __attribute__((aligned(64)));
+static volatile uint32_t online_mask = 0;
+static uint32_t cpu_total = 1;
+
+void print_string(const char* str);
+char* utoa(uint32_t value, char* str, int base);
+
+// Build segment descriptor
+static uint64_t gdt_entry(uint32_t base, uint32_t limit, uint8_t access, uint8_t flags) {
+    uint64_t entry = limit & 0xFFFF;
+    entry |= (uint64_t)(base & 0xFFFFFF) << 16;
+    entry |= (uint64_t)access << 40;
+    entry |= (uint64_t)((limit >> 16) & 0xF) << 48;
+    entry |= (uint64_t)(flags & 0xF) << 52;
+    entry |= (uint64_t)(base >> 24) << 56;
+    return entry;
+}
+
+// Fill CPU's GDT: flat code/data plus a GS segment over its struct cpu
+static void gdt_build(struct cpu* cpu) {
+    cpu->gdt[0] = 0;
+    cpu->gdt[GDT_KERNEL_CS / 8] = gdt_entry(0, 0xFFFFF, GDT_ACCESS_CODE, GDT_FLAGS_4K);
+    cpu->gdt[GDT_KERNEL_DS / 8] = gdt_entry(0, 0xFFFFF, GDT_ACCESS_DATA, GDT_FLAGS_4K);
+    cpu->gdt[GDT_PERCPU / 8] = gdt_entry((uint32_t)cpu, sizeof(struct cpu) - 1,
+                                         GDT_ACCESS_DATA, GDT_FLAGS_BYTE);
+}
+
+// Load CPU's GDT and reload every segment register
+static void gdt_load(struct cpu* cpu) {
+    struct {
+        uint16_t limit;
+        uint32_t base;
+    } __attribute__((packed)) gdtr = { sizeof(cpu->gdt) - 1, (uint32_t)cpu->gdt };
+
+    asm volatile ("lgdt %0\n\t"
+                  "ljmp %1, $1f\n"
+                  "1:\n\t"
+                  "movw %w2, %%ds\n\t"
+                  "movw %w2, %%es\n\t"
+                  "movw %w2, %%fs\n\t"
+                  "movw %w2, %%ss\n\t"
+                  "movw %w3, %%gs"
+                  : : "m"(gdtr), "i"(GDT_KERNEL_CS), "r"(GDT_KERNEL_DS), "r"(GDT_PERCPU)
+                  : "memory");
+}
+
+// Mark CPU online (other CPUs update the mask concurrently)
+static void smp_set_online(struct cpu* cpu) {
+    asm volatile ("lock orl %1, %0" : "+m"(online_mask) : "r"(1U << cpu->index) : "memory");
+    cpu->online = true;
+}
+
+// Busy-wait (interrupts are still off during bring-up)
+static void smp_delay_us(uint32_t microseconds) {
+    if (!clock_highres()) {
+        delay_io(microseconds);     // ~1us per port 0x80 write
+        return;
+    }
+
+    uint64_t deadline = clock_ns() + (uint64_t)microseconds * NSEC_PER_USEC;
+    while (clock_ns() < deadline) {
+        asm volatile ("pause");
+    }
+}
+
+// Wakeup IPI: returning from the handler is all it takes
+static void smp_wakeup_irq(struct interrupt_frame* frame) {
+    (void)frame;
+    smp_this_cpu()->wakeups++;
+}
+
+// First C code on an AP (called by the trampoline on its own stack)
+static void smp_ap_entry(struct cpu* cpu) {
+    gdt_load(cpu);
+    idt_load();
+    lapic_init_ap();
+
+    smp_set_online(cpu);
+
+    // APs only run parallel_for tasks; halt between jobs
+    taskpool_worker();
+}
+
+// Set up BSP per-CPU data
+void smp_early_init(void) {
+    struct cpu* bsp = &cpus[0];
+
+    bsp->self = bsp;
+    bsp->index = 0;
+    bsp->apic_id = 0;
+    bsp->stack = NULL;
+    bsp->wakeups = 0;
+
+    gdt_build(bsp);
+    gdt_load(bsp);
+    smp_set_online(bsp);
+}
+
+// Start one AP
+static bool smp_boot_ap(struct cpu* cpu) {
+    cpu->stack = page_alloc(SMP_AP_STACK_PAGES);
+    if (!cpu->stack) {
+        return false;
+    }
+
+    // Parameters live inside the copied trampoline
+    uint8_t* tramp = (uint8_t*)SMP_TRAMPOLINE_ADDR;
+    *(uint32_t*)(tramp + (smp_trampoline_stack - smp_trampoline_start)) =
+        (uint32_t)cpu->stack + SMP_AP_STACK_PAGES * PAGE_SIZE;
+    *(uint32_t*)(tramp + (smp_trampoline_entry - smp_trampoline_start)) = (uint32_t)smp_ap_entry;
+    *(uint32_t*)(tramp + (smp_trampoline_cpu - smp_trampoline_start)) = (uint32_t)cpu;
+
+    // INIT, wait 10ms, then up to two SIPIs (Intel MP spec sequence)
+    lapic_send_ipi(cpu->apic_id, LAPIC_ICR_INIT | LAPIC_ICR_ASSERT);
+    smp_delay_us(10000);
+
+    for (int attempt = 0; attempt < 2 && !cpu->online; attempt++) {
+        lapic_send_ipi(cpu->apic_id, LAPIC_ICR_STARTUP | SIPI_VECTOR);
+        smp_delay_us(200);
+    }
+
+    for (uint32_t ms = 0; ms < SMP_STARTUP_TIMEOUT_MS && !cpu->online; ms++) {
+        smp_delay_us(1000);
+    }
+
+    // On failure the stack stays allocated: a late AP may still be using it
+    return cpu->online;
+}
+
+// Start application processors
+uint32_t smp_init(void) {
+    const struct acpi_info* info = acpi_get_info();
+    char num[16];
+
+    if (!apic_enabled()) {
+        print_string("SMP: No APIC, running on 1 CPU\n");
+        return 1;
+    }
+
+    cpus[0].apic_id = lapic_id();
+    interrupt_register_handler(APIC_WAKEUP_VECTOR, smp_wakeup_irq);
+
+    // Trampoline must sit in conventional memory at a page boundary
+    uint8_t* tramp = (uint8_t*)SMP_TRAMPOLINE_ADDR;
+    for (uint8_t* src = smp_trampoline_start; src < smp_trampoline_end; src++) {
+        *tramp++ = *src;
+    }
+
+    for (int i = 0; i < info->cpu_count && cpu_total < SMP_MAX_CPUS; i++) {
+        if (info->cpu_apic_ids[i] == cpus[0].apic_id) {
+            continue;
+        }
+
+        struct cpu* cpu = &cpus[cpu_total];
+        cpu->self = cpu;
+        cpu->index = cpu_total;
+        cpu->apic_id = info->cpu_apic_ids[i];
+        cpu->online = false;
+        cpu->wakeups = 0;
+        gdt_build(cpu);
+
+        if (smp_boot_ap(cpu)) {
+            cpu_total++;
+        } else {
+            print_string("SMP: CPU with APIC ID ");
+            print_string(utoa(cpu->apic_id, num, 10));
+            print_string(" did not start\n");
+        }
+    }
+
+    print_string("SMP: ");
+    print_string(utoa(cpu_total, num, 10));
+    print_string(" CPU(s) online\n");
+
+    return cpu_total;
+}
+
+// Get online CPU count
+uint32_t smp_cpu_count(void) {
+    return cpu_total;
+}
+
+// Get online mask
+uint32_t smp_online_mask(void) {
+    return online_mask;
+}
+
+// Get CPU by index
+struct cpu* smp_get_cpu(uint32_t index) {
+    if (index >= SMP_MAX_CPUS || !cpus[index].online) {
+        return NULL;
+    }
+    return &cpus[index];
+}
+
+// Send IPI to CPU
+void smp_send_ipi(uint32_t index, uint8_t vector) {
+    struct cpu* cpu = smp_get_cpu(index);
+    if (cpu && apic_enabled()) {
+        lapic_send_ipi(cpu->apic_id, LAPIC_ICR_FIXED | vector);
+    }
+}
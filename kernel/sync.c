@@ -0,0 +1,310 @@
+/**************************************************************
+ * Synchronization - BloodG OS
+ * Blocking primitives built on thread_block/thread_wake
+ **************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "io.h"
+#include "clock.h"
+#include "idle.h"
+#include "timer.h"
+#include "thread.h"
+#include "sync.h"
+
+/* ==================== WAIT QUEUES ==================== */
+
+// Append waiter
+static void wait_queue_push(struct wait_queue* wq, struct thread* t) {
+    t->next = NULL;
+    if (wq->tail) {
+        wq->tail->next = t;
+    } else {
+        wq->head = t;
+    }
+    wq->tail = t;
+    t->wait_queue = wq;
+}
+
+// Remove first waiter
+static struct thread* wait_queue_pop(struct wait_queue* wq) {
+    struct thread* t = wq->head;
+    if (t) {
+        wq->head = t->next;
+        if (!wq->head) {
+            wq->tail = NULL;
+        }
+        t->next = NULL;
+        t->wait_queue = NULL;
+    }
+    return t;
+}
+
+// Remove specific waiter (timeout)
+static void wait_queue_remove(struct wait_queue* wq, struct thread* t) {
+    struct thread* prev = NULL;
+
+    for (struct thread* cur = wq->head; cur; prev = cur, cur = cur->next) {
+        if (cur != t) {
+            continue;
+        }
+        if (prev) {
+            prev->next = cur->next;
+        } else {
+            wq->head = cur->next;
+        }
+        if (wq->tail == cur) {
+            wq->tail = prev;
+        }
+        t->next = NULL;
+        t->wait_queue = NULL;
+        return;
+    }
+}
+
+// Initialize wait queue
+void wait_queue_init(struct wait_queue* wq) {
+    wq->head = NULL;
+    wq->tail = NULL;
+}
+
+// Block on wait queue
+void wait_queue_sleep(struct wait_queue* wq) {
+    struct thread* self = thread_current();
+
+    // No scheduler yet: the next interrupt is our only chance of progress
+    if (!self) {
+        idle_halt();
+        return;
+    }
+
+    wait_queue_push(wq, self);
+    thread_block(THREAD_BLOCKED);
+}
+
+// Wait timed out: pull thread off its queue (interrupt context)
+static void wait_queue_timeout(void* arg) {
+    struct thread* t = (struct thread*)arg;
+
+    t->wait_timer = -1;
+    if (t->wait_queue) {
+        wait_queue_remove(t->wait_queue, t);
+        t->timed_out = true;
+        thread_wake(t);
+    }
+}
+
+// Block on wait queue with timeout
+bool wait_queue_sleep_timeout(struct wait_queue* wq, uint64_t timeout_ns) {
+    struct thread* self = thread_current();
+
+    // The tick or one-shot wakes hlt within a second even with no timers
+    if (!self) {
+        idle_halt();
+        return true;
+    }
+
+    self->timed_out = false;
+    self->wait_timer = timer_add(timeout_ns, wait_queue_timeout, self);
+
+    // Timer pool full: nothing would wake us, so poll instead of blocking
+    if (self->wait_timer < 0) {
+        thread_yield();
+        return false;
+    }
+
+    wait_queue_push(wq, self);
+    thread_block(THREAD_BLOCKED);
+
+    // Woken normally: the timer id is only ours while it has not fired
+    if (self->wait_timer >= 0) {
+        timer_cancel(self->wait_timer);
+        self->wait_timer = -1;
+    }
+
+    return !self->timed_out;
+}
+
+// Wake first waiter
+bool wait_queue_wake_one(struct wait_queue* wq) {
+    uint32_t flags = irq_save();
+
+    struct thread* t = wait_queue_pop(wq);
+    if (t) {
+        thread_wake(t);
+    }
+
+    irq_restore(flags);
+    return t != NULL;
+}
+
+// Wake all waiters
+uint32_t wait_queue_wake_all(struct wait_queue* wq) {
+    uint32_t flags = irq_save();
+    uint32_t woken = 0;
+
+    struct thread* t;
+    while ((t = wait_queue_pop(wq)) != NULL) {
+        thread_wake(t);
+        woken++;
+    }
+
+    irq_restore(flags);
+    return woken;
+}
+
+/* ==================== MUTEX ==================== */
+
+// Initialize mutex
+void mutex_init(struct mutex* m) {
+    m->locked = false;
+    m->owner = NULL;
+    wait_queue_init(&m->waiters);
+}
+
+// Acquire mutex
+void mutex_lock(struct mutex* m) {
+    uint32_t flags = irq_save();
+
+    while (m->locked) {
+        wait_queue_sleep(&m->waiters);
+    }
+    m->locked = true;
+    m->owner = thread_current();
+
+    irq_restore(flags);
+}
+
+// Try to acquire mutex
+bool mutex_trylock(struct mutex* m) {
+    uint32_t flags = irq_save();
+    bool acquired = !m->locked;
+
+    if (acquired) {
+        m->locked = true;
+        m->owner = thread_current();
+    }
+
+    irq_restore(flags);
+    return acquired;
+}
+
+// Release mutex
+void mutex_unlock(struct mutex* m) {
+    uint32_t flags = irq_save();
+
+    m->locked = false;
+    m->owner = NULL;
+    wait_queue_wake_one(&m->waiters);
+
+    irq_restore(flags);
+}
+
+/* ==================== SEMAPHORE ==================== */
+
+// Initialize semaphore
+void sem_init(struct semaphore* sem, uint32_t count) {
+    sem->count = count;
+    wait_queue_init(&sem->waiters);
+}
+
+// Take one unit
+void sem_wait(struct semaphore* sem) {
+    uint32_t flags = irq_save();
+
+    while (sem->count == 0) {
+        wait_queue_sleep(&sem->waiters);
+    }
+    sem->count--;
+
+    irq_restore(flags);
+}
+
+// Take one unit if available
+bool sem_trywait(struct semaphore* sem) {
+    uint32_t flags = irq_save();
+    bool taken = sem->count > 0;
+
+    if (taken) {
+        sem->count--;
+    }
+
+    irq_restore(flags);
+    return taken;
+}
+
+// Return one unit
+void sem_post(struct semaphore* sem) {
+    uint32_t flags = irq_save();
+
+    sem->count++;
+    wait_queue_wake_one(&sem->waiters);
+
+    irq_restore(flags);
+}
+
+/* ==================== COMPLETION ==================== */
+
+// Initialize completion
+void completion_init(struct completion* c) {
+    c->done = 0;
+    wait_queue_init(&c->waiters);
+}
+
+// Wait for completion
+void wait_for_completion(struct completion* c) {
+    uint32_t flags = irq_save();
+
+    while (c->done == 0) {
+        wait_queue_sleep(&c->waiters);
+    }
+    if (c->done != COMPLETION_ALL) {
+        c->done--;
+    }
+
+    irq_restore(flags);
+}
+
+// Wait for completion with timeout
+bool wait_for_completion_timeout(struct completion* c, uint64_t timeout_ns) {
+    uint64_t deadline = clock_ns() + timeout_ns;
+    uint32_t flags = irq_save();
+
+    while (c->done == 0) {
+        uint64_t now = clock_ns();
+        if (now >= deadline) {
+            irq_restore(flags);
+            return false;
+        }
+        wait_queue_sleep_timeout(&c->waiters, deadline - now);
+    }
+    if (c->done != COMPLETION_ALL) {
+        c->done--;
+    }
+
+    irq_restore(flags);
+    return true;
+}
+
+// Signal one waiter
+void complete(struct completion* c) {
+    uint32_t flags = irq_save();
+
+    if (c->done != COMPLETION_ALL) {
+        c->done++;
+    }
+    wait_queue_wake_one(&c->waiters);
+
+    irq_restore(flags);
+}
+
+// Signal all waiters
+void complete_all(struct completion* c) {
+    uint32_t flags = irq_save();
+
+    c->done = COMPLETION_ALL;
+    wait_queue_wake_all(&c->waiters);
+
+    irq_restore(flags);
+}
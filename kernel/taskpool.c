@@ -0,0 +1,295 @@
+/**************************************************************
+ * Task Pool - BloodG OS
+ * Per-CPU Chase-Lev deques with random-victim work stealing
+ **************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "io.h"
+#include "smp.h"
+#include "sync.h"
+#include "taskpool.h"
+
+#define DEQUE_MASK          (TASKPOOL_DEQUE_SIZE - 1)
+#define DEFAULT_CHUNKS      (TASKPOOL_MAX_TASKS / 4)   // Leaves when grain is 0
+
+/**
+ * One subrange of a parallel_for
+ */
+struct task {
+    uint32_t start;
+    uint32_t end;
+};
+
+/**
+ * Chase-Lev deque: owner pushes/pops at bottom, thieves take from top
+ * (fixed size, indices only grow so a stale top can never match again)
+ */
+struct task_deque {
+    volatile int32_t top;
+    volatile int32_t bottom;
+    struct task* volatile tasks[TASKPOOL_DEQUE_SIZE];
+} __attribute__((aligned(64)));
+
+/**
+ * Running parallel_for
+ */
+struct pfor_job {
+    parallel_for_fn fn;
+    void* arg;
+    uint32_t grain;
+    volatile uint32_t remaining;    // Indices not yet processed
+    volatile uint32_t next_task;    // Next free slot in tasks[]
+    struct task tasks[TASKPOOL_MAX_TASKS];
+};
+
+// Pool state
+static struct task_deque deques[SMP_MAX_CPUS];
+static struct taskpool_stats stats[SMP_MAX_CPUS];
+static uint32_t seeds[SMP_MAX_CPUS];
+static struct pfor_job job;
+static struct pfor_job* volatile active_job = NULL;
+static volatile uint32_t worker_limit = 1;
+static struct mutex pfor_lock = MUTEX_INIT;
+
+// Order our earlier stores before later loads (the one reordering x86 does)
+static inline void memory_fence(void) {
+    asm volatile ("mfence" ::: "memory");
+}
+
+// Owner: add task at bottom
+static bool deque_push(struct task_deque* d, struct task* t) {
+    int32_t b = d->bottom;
+    if (b - d->top >= TASKPOOL_DEQUE_SIZE) {
+        return false;
+    }
+
+    d->tasks[b & DEQUE_MASK] = t;
+    asm volatile ("" ::: "memory");     // Slot before bottom (stores stay ordered)
+    d->bottom = b + 1;
+    return true;
+}
+
+// Owner: take newest task
+static struct task* deque_pop(struct task_deque* d) {
+    int32_t b = d->bottom - 1;
+    d->bottom = b;
+    memory_fence();
+    int32_t t = d->top;
+
+    if (t > b) {
+        d->bottom = b + 1;      // Empty
+        return NULL;
+    }
+
+    struct task* task = d->tasks[b & DEQUE_MASK];
+    if (t == b) {
+        // Last task: race thieves for it
+        if (!__sync_bool_compare_and_swap(&d->top, t, t + 1)) {
+            task = NULL;
+        }
+        d->bottom = b + 1;
+    }
+    return task;
+}
+
+// Thief: take oldest task
+static struct task* deque_steal(struct task_deque* d) {
+    int32_t t = d->top;
+    asm volatile ("" ::: "memory");     // top before bottom (loads stay ordered)
+    int32_t b = d->bottom;
+
+    if (t >= b) {
+        return NULL;
+    }
+
+    struct task* task = d->tasks[t & DEQUE_MASK];
+    if (!__sync_bool_compare_and_swap(&d->top, t, t + 1)) {
+        return NULL;            // Owner or another thief won
+    }
+    return task;
+}
+
+// Per-CPU xorshift for victim selection
+static uint32_t taskpool_random(uint32_t cpu) {
+    uint32_t x = seeds[cpu];
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    seeds[cpu] = x;
+    return x;
+}
+
+// Own deque first, then one random victim
+static struct task* taskpool_find(uint32_t cpu) {
+    struct task* task = deque_pop(&deques[cpu]);
+    if (task) {
+        return task;
+    }
+
+    uint32_t workers = worker_limit;
+    if (workers < 2) {
+        return NULL;
+    }
+
+    uint32_t victim = taskpool_random(cpu) % (workers - 1);
+    if (victim >= cpu) {
+        victim++;               // Never ourselves
+    }
+
+    task = deque_steal(&deques[victim]);
+    if (task) {
+        stats[cpu].steals++;
+    } else {
+        stats[cpu].steal_failures++;
+    }
+    return task;
+}
+
+// Run task, splitting off right halves for thieves
+static void taskpool_run(struct pfor_job* j, struct task* task, uint32_t cpu) {
+    uint32_t start = task->start;
+    uint32_t end = task->end;
+
+    while (end - start > j->grain) {
+        uint32_t slot = __sync_fetch_and_add(&j->next_task, 1);
+        if (slot >= TASKPOOL_MAX_TASKS) {
+            break;              // Out of slots: finish the rest here
+        }
+
+        uint32_t mid = start + (end - start) / 2;
+        struct task* right = &j->tasks[slot];
+        right->start = mid;
+        right->end = end;
+        if (!deque_push(&deques[cpu], right)) {
+            break;
+        }
+        end = mid;
+    }
+
+    j->fn(start, end, j->arg);
+    stats[cpu].executed++;
+
+    // Last processed index ends the job
+    __sync_fetch_and_sub(&j->remaining, end - start);
+}
+
+// Enable all online CPUs
+void taskpool_init(void) {
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        seeds[i] = 0x9E3779B9u * (i + 1);
+    }
+    worker_limit = smp_cpu_count();
+}
+
+// Parallel loop
+void parallel_for(uint32_t start, uint32_t end, uint32_t grain, parallel_for_fn fn, void* arg) {
+    if (end <= start) {
+        return;
+    }
+
+    uint32_t count = end - start;
+    if (grain == 0) {
+        grain = count / DEFAULT_CHUNKS;
+    }
+    // Splitting stops at the grain, so this bounds the task count
+    if (grain < count / (TASKPOOL_MAX_TASKS / 2)) {
+        grain = count / (TASKPOOL_MAX_TASKS / 2);
+    }
+    if (grain == 0) {
+        grain = 1;
+    }
+
+    // Single CPU: no point queueing anything
+    if (worker_limit < 2 || count <= grain) {
+        fn(start, end, arg);
+        return;
+    }
+
+    mutex_lock(&pfor_lock);
+
+    uint32_t cpu = smp_cpu_index();
+    job.fn = fn;
+    job.arg = arg;
+    job.grain = grain;
+    job.remaining = count;
+    job.next_task = 1;
+    job.tasks[0].start = start;
+    job.tasks[0].end = end;
+
+    // Publish, then kick halted workers
+    active_job = &job;
+    for (uint32_t i = 0; i < worker_limit; i++) {
+        if (i != cpu) {
+            smp_send_ipi(i, APIC_WAKEUP_VECTOR);
+        }
+    }
+
+    taskpool_run(&job, &job.tasks[0], cpu);
+
+    // Help until every index is done
+    while (job.remaining) {
+        struct task* task = taskpool_find(cpu);
+        if (task) {
+            taskpool_run(&job, task, cpu);
+        } else {
+            asm volatile ("pause");
+        }
+    }
+
+    active_job = NULL;
+    mutex_unlock(&pfor_lock);
+}
+
+// Set worker count
+void taskpool_set_workers(uint32_t count) {
+    uint32_t online = smp_cpu_count();
+    if (count < 1) count = 1;
+    if (count > online) count = online;
+
+    mutex_lock(&pfor_lock);
+    worker_limit = count;
+    mutex_unlock(&pfor_lock);
+}
+
+// Get worker count
+uint32_t taskpool_workers(void) {
+    return worker_limit;
+}
+
+// Get per-CPU counters
+struct taskpool_stats taskpool_get_stats(uint32_t cpu) {
+    struct taskpool_stats empty = {0};
+    if (cpu >= SMP_MAX_CPUS) {
+        return empty;
+    }
+    return stats[cpu];
+}
+
+// AP main loop
+void taskpool_worker(void) {
+    uint32_t cpu = smp_cpu_index();
+
+    while (1) {
+        struct pfor_job* j = active_job;
+
+        if (j && cpu < worker_limit) {
+            struct task* task = taskpool_find(cpu);
+            if (task) {
+                taskpool_run(j, task, cpu);
+            } else {
+                asm volatile ("pause");
+            }
+            continue;
+        }
+
+        // Re-check with interrupts off so the wakeup IPI cannot slip past hlt
+        cli();
+        if (!active_job || cpu >= worker_limit) {
+            asm volatile ("sti; hlt");
+        } else {
+            sti();
+        }
+    }
+}
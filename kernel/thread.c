@@ -0,0 +1,335 @@
+/**************************************************************
+ * Kernel Threads - BloodG OS
+ * Round-robin scheduler preempted from the timer interrupt
+ **************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "io.h"
+#include "page.h"
+#include "clock.h"
+#include "idle.h"
+#include "timer.h"
+#include "thread.h"
+#include "smp.h"
+
+// Save callee-saved registers on old stack, resume new one (boot/switch.asm)
+extern void context_switch(uint32_t* old_esp, uint32_t new_esp);
+
+// Scheduler state
+static struct thread threads[THREAD_MAX];
+static struct thread* current = NULL;
+static struct thread* run_head = NULL;
+static struct thread* run_tail = NULL;
+static uint32_t ready_count = 0;
+static int next_tid = 1;
+static volatile bool need_resched = false;
+static int slice_timer = -1;
+static struct thread* reap_thread = NULL;     // Exited thread whose stack we still stand on
+
+static const char* state_names[] = {
+    "unused", "ready", "running", "sleeping", "blocked", "zombie",
+};
+
+// Append to run queue
+static void runqueue_push(struct thread* t) {
+    t->next = NULL;
+    if (run_tail) {
+        run_tail->next = t;
+    } else {
+        run_head = t;
+    }
+    run_tail = t;
+    ready_count++;
+}
+
+// Take first ready thread
+static struct thread* runqueue_pop(void) {
+    struct thread* t = run_head;
+    if (t) {
+        run_head = t->next;
+        if (!run_head) {
+            run_tail = NULL;
+        }
+        t->next = NULL;
+        ready_count--;
+    }
+    return t;
+}
+
+// Round-robin slice ran out
+static void thread_slice_expired(void* arg) {
+    (void)arg;
+    slice_timer = -1;
+    need_resched = true;
+}
+
+// Start a slice if someone is waiting for the CPU
+static void thread_arm_slice(void) {
+    if (slice_timer < 0 && ready_count) {
+        slice_timer = timer_add(THREAD_SLICE_NS, thread_slice_expired, NULL);
+    }
+}
+
+// Runs on the new thread's stack right after every switch
+static void thread_finish_switch(void) {
+    if (reap_thread) {
+        page_free(reap_thread->stack, THREAD_STACK_PAGES);
+        reap_thread->state = THREAD_UNUSED;
+        reap_thread = NULL;
+    }
+
+    current->last_run_ns = clock_ns();
+    current->switches++;
+
+    // Fresh slice for the incoming thread
+    if (slice_timer >= 0) {
+        timer_cancel(slice_timer);
+        slice_timer = -1;
+    }
+    thread_arm_slice();
+}
+
+// Pick next thread and switch to it (interrupts must be off)
+static void schedule(void) {
+    struct thread* prev = current;
+    struct thread* next;
+
+    need_resched = false;
+
+    while (!(next = runqueue_pop())) {
+        if (prev->state == THREAD_RUNNING) {
+            return;     // Nobody else wants the CPU
+        }
+        // Everyone is asleep: wait for an interrupt to wake someone
+        idle_halt();
+    }
+
+    // Woken again before anyone else got to run
+    if (next == prev) {
+        prev->state = THREAD_RUNNING;
+        return;
+    }
+
+    if (prev->state == THREAD_RUNNING) {
+        prev->state = THREAD_READY;
+        runqueue_push(prev);
+    }
+    prev->runtime_ns += clock_ns() - prev->last_run_ns;
+
+    next->state = THREAD_RUNNING;
+    current = next;
+    context_switch(&prev->esp, next->esp);
+
+    // Back on prev's stack, some time later
+    thread_finish_switch();
+}
+
+// Copy name, truncating to THREAD_NAME_LEN
+static void thread_set_name(struct thread* t, const char* name) {
+    int i = 0;
+    if (name) {
+        for (; name[i] && i < THREAD_NAME_LEN - 1; i++) {
+            t->name[i] = name[i];
+        }
+    }
+    t->name[i] = '\0';
+}
+
+// First code a new thread runs (context_switch "returns" here)
+static void thread_start(void) {
+    thread_finish_switch();
+    sti();
+
+    current->entry(current->arg);
+    thread_exit();
+}
+
+// Adopt boot stack as thread 0
+void thread_init(void) {
+    for (int i = 0; i < THREAD_MAX; i++) {
+        threads[i].state = THREAD_UNUSED;
+    }
+
+    struct thread* main = &threads[0];
+    main->tid = 0;
+    thread_set_name(main, "main");
+    main->state = THREAD_RUNNING;
+    main->stack = NULL;
+    main->runtime_ns = 0;
+    main->last_run_ns = clock_ns();
+    main->switches = 1;
+    main->wait_queue = NULL;
+    main->wait_timer = -1;
+
+    current = main;
+}
+
+// Create thread
+int thread_create(const char* name, thread_entry_t entry, void* arg) {
+    if (!entry || !current) {
+        return -1;
+    }
+
+    uint32_t flags = irq_save();
+
+    struct thread* t = NULL;
+    for (int i = 0; i < THREAD_MAX; i++) {
+        if (threads[i].state == THREAD_UNUSED) {
+            t = &threads[i];
+            break;
+        }
+    }
+
+    void* stack = t ? page_alloc(THREAD_STACK_PAGES) : NULL;
+    if (!stack) {
+        irq_restore(flags);
+        return -1;
+    }
+
+    thread_set_name(t, name);
+    t->tid = next_tid++;
+    t->entry = entry;
+    t->arg = arg;
+    t->stack = stack;
+    t->runtime_ns = 0;
+    t->last_run_ns = 0;
+    t->switches = 0;
+    t->wait_queue = NULL;
+    t->wait_timer = -1;
+
+    // Frame context_switch pops: edi, esi, ebx, ebp, return address
+    uint32_t* sp = (uint32_t*)((uint8_t*)stack + THREAD_STACK_PAGES * PAGE_SIZE);
+    *--sp = 0;                      // thread_start never returns
+    *--sp = (uint32_t)thread_start;
+    *--sp = 0;                      // ebp
+    *--sp = 0;                      // ebx
+    *--sp = 0;                      // esi
+    *--sp = 0;                      // edi
+    t->esp = (uint32_t)sp;
+
+    t->state = THREAD_READY;
+    runqueue_push(t);
+    thread_arm_slice();
+
+    int tid = t->tid;
+    irq_restore(flags);
+    return tid;
+}
+
+// Terminate calling thread
+void thread_exit(void) {
+    cli();
+
+    // Boot thread owns the shell; never let it go away
+    if (current == &threads[0]) {
+        while (1) {
+            thread_block(THREAD_BLOCKED);
+        }
+    }
+
+    current->state = THREAD_ZOMBIE;
+    reap_thread = current;
+    schedule();
+
+    // Not reached
+    while (1) {
+        halt();
+    }
+}
+
+// Give up CPU
+void thread_yield(void) {
+    if (!current) {
+        return;
+    }
+
+    uint32_t flags = irq_save();
+    schedule();
+    irq_restore(flags);
+}
+
+// Block calling thread (interrupts off)
+void thread_block(enum thread_state state) {
+    current->state = state;
+    schedule();
+}
+
+// Make thread ready
+void thread_wake(struct thread* thread) {
+    uint32_t flags = irq_save();
+
+    if (thread->state == THREAD_SLEEPING || thread->state == THREAD_BLOCKED) {
+        thread->state = THREAD_READY;
+        runqueue_push(thread);
+        need_resched = true;
+        thread_arm_slice();
+    }
+
+    irq_restore(flags);
+}
+
+// Sleep timer fired
+static void thread_sleep_wakeup(void* arg) {
+    thread_wake((struct thread*)arg);
+}
+
+// Sleep calling thread
+void thread_sleep_ms(uint32_t milliseconds) {
+    if (!current) {
+        timer_sleep_ms(milliseconds);
+        return;
+    }
+
+    uint32_t flags = irq_save();
+
+    if (timer_add((uint64_t)milliseconds * NSEC_PER_MSEC, thread_sleep_wakeup, current) < 0) {
+        // Timer pool exhausted: fall back to waiting in place
+        irq_restore(flags);
+        timer_sleep_ms(milliseconds);
+        return;
+    }
+
+    thread_block(THREAD_SLEEPING);
+    irq_restore(flags);
+}
+
+// Preempt from interrupt_dispatch
+void thread_preempt(void) {
+    // idle_wait yields by itself once its hlt returns
+    if (!need_resched || !current || current->state != THREAD_RUNNING || idle_is_idle()) {
+        return;
+    }
+    // Threads only run on the BSP
+    if (smp_cpu_index() != 0) {
+        return;
+    }
+    schedule();
+}
+
+// Get calling thread
+struct thread* thread_current(void) {
+    return current;
+}
+
+// Get thread by slot
+const struct thread* thread_get(int slot) {
+    if (slot < 0 || slot >= THREAD_MAX || threads[slot].state == THREAD_UNUSED) {
+        return NULL;
+    }
+    return &threads[slot];
+}
+
+// Get ready thread count
+uint32_t thread_ready_count(void) {
+    return ready_count;
+}
+
+// Get state name
+const char* thread_state_name(enum thread_state state) {
+    if ((unsigned)state >= sizeof(state_names) / sizeof(state_names[0])) {
+        return "?";
+    }
+    return state_names[state];
+}
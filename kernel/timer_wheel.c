@@ -0,0 +1,268 @@
+/**************************************************************
+ * Hierarchical Timer Wheel - BloodG OS
+ * O(1) insert/cancel software timers driven by timer_handler
+ **************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "io.h"
+#include "clock.h"
+#include "timer.h"
+#include "timer_wheel.h"
+
+#define WHEEL_SIZE      (1 << TIMER_WHEEL_BITS)
+#define WHEEL_MASK      (WHEEL_SIZE - 1)
+#define WHEEL_RANGE     (1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+
+// Timer id: generation above the pool index, so a stale id never matches
+#define ID_SLOT_BITS    8               // Covers TIMER_MAX_EVENTS
+#define ID_SLOT_MASK    ((1 << ID_SLOT_BITS) - 1)
+#define ID_GEN_MASK     0x7FFFFF        // Keeps ids positive
+
+// Timer slot (doubly linked so cancel is O(1))
+struct wheel_timer {
+    uint64_t expires;               // Jiffy the timer is due
+    timer_callback_t callback;
+    void* arg;
+    bool active;
+    uint32_t generation;            // Bumped on every timer_add
+    uint8_t level;
+    uint8_t slot;
+    struct wheel_timer* prev;
+    struct wheel_timer* next;
+};
+
+// Wheel state
+static struct wheel_timer timer_pool[TIMER_MAX_EVENTS];
+static struct wheel_timer* free_list = NULL;
+static struct wheel_timer* wheel[TIMER_WHEEL_LEVELS][WHEEL_SIZE];
+static uint32_t level_count[TIMER_WHEEL_LEVELS];
+static uint32_t pending = 0;
+static uint64_t wheel_clock = 0;   // Next jiffy to process
+
+// Unlink timer from its slot
+static void wheel_unlink(struct wheel_timer* t) {
+    if (t->prev) {
+        t->prev->next = t->next;
+    } else {
+        wheel[t->level][t->slot] = t->next;
+    }
+    if (t->next) {
+        t->next->prev = t->prev;
+    }
+    level_count[t->level]--;
+}
+
+// Place timer on the level that covers its distance from wheel_clock
+static void wheel_insert(struct wheel_timer* t) {
+    uint64_t expires = t->expires;
+    int level;
+
+    if (expires < wheel_clock) {
+        expires = wheel_clock;
+    }
+    if (expires - wheel_clock >= WHEEL_RANGE) {
+        // Park at the far end, re-cascades closer later
+        expires = wheel_clock + WHEEL_RANGE - 1;
+    }
+
+    uint64_t delta = expires - wheel_clock;
+    for (level = 0; level < TIMER_WHEEL_LEVELS - 1; level++) {
+        if (delta < (1ULL << (TIMER_WHEEL_BITS * (level + 1)))) {
+            break;
+        }
+    }
+
+    t->level = level;
+    t->slot = (expires >> (TIMER_WHEEL_BITS * level)) & WHEEL_MASK;
+    t->prev = NULL;
+    t->next = wheel[level][t->slot];
+    if (t->next) {
+        t->next->prev = t;
+    }
+    wheel[level][t->slot] = t;
+    level_count[level]++;
+}
+
+// Move every timer in a higher-level slot down to where it now belongs
+static void wheel_cascade(int level, uint32_t index) {
+    struct wheel_timer* t = wheel[level][index];
+    wheel[level][index] = NULL;
+
+    while (t) {
+        struct wheel_timer* next = t->next;
+        level_count[level]--;
+        wheel_insert(t);
+        t = next;
+    }
+}
+
+// Process one jiffy
+static void wheel_advance(void) {
+    uint32_t index = wheel_clock & WHEEL_MASK;
+
+    // Level 0 wrapped: pull the next batch down from above
+    if (index == 0) {
+        for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+            uint32_t idx = (wheel_clock >> (TIMER_WHEEL_BITS * level)) & WHEEL_MASK;
+            wheel_cascade(level, idx);
+            if (idx != 0) {
+                break;
+            }
+        }
+    }
+
+    wheel_clock++;
+
+    // Pop one at a time: callbacks may add or cancel timers
+    struct wheel_timer* t;
+    while ((t = wheel[0][index]) != NULL) {
+        timer_callback_t callback = t->callback;
+        void* arg = t->arg;
+
+        wheel_unlink(t);
+        t->active = false;
+        t->next = free_list;
+        free_list = t;
+        pending--;
+
+        callback(arg);
+    }
+}
+
+// Reset wheel
+void timer_wheel_init(uint64_t now_ns) {
+    uint32_t flags = irq_save();
+
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < WHEEL_SIZE; slot++) {
+            wheel[level][slot] = NULL;
+        }
+        level_count[level] = 0;
+    }
+
+    free_list = NULL;
+    for (int i = TIMER_MAX_EVENTS - 1; i >= 0; i--) {
+        timer_pool[i].active = false;
+        timer_pool[i].generation = 0;
+        timer_pool[i].next = free_list;
+        free_list = &timer_pool[i];
+    }
+
+    pending = 0;
+    wheel_clock = now_ns >> TIMER_WHEEL_SHIFT;
+
+    irq_restore(flags);
+}
+
+// Run all due timers
+void timer_wheel_run(uint64_t now_ns) {
+    uint64_t now = now_ns >> TIMER_WHEEL_SHIFT;
+
+    while (wheel_clock <= now) {
+        if (pending == 0) {
+            wheel_clock = now + 1;
+            break;
+        }
+        wheel_advance();
+    }
+}
+
+// Next time the wheel needs to run
+uint64_t timer_wheel_next_expiry(void) {
+    uint64_t next = TIMER_NO_EXPIRY;
+
+    if (pending == 0) {
+        return TIMER_NO_EXPIRY;
+    }
+
+    // Level 0 slots hold exactly one jiffy each
+    if (level_count[0]) {
+        for (uint32_t i = 0; i < WHEEL_SIZE; i++) {
+            if (wheel[0][(wheel_clock + i) & WHEEL_MASK]) {
+                next = wheel_clock + i;
+                break;
+            }
+        }
+    }
+
+    // Higher levels only need attention at the next cascade (which is
+    // wheel_clock itself when it sits on a level 0 wrap)
+    if (pending > level_count[0]) {
+        uint64_t cascade = (wheel_clock + WHEEL_MASK) & ~(uint64_t)WHEEL_MASK;
+        if (cascade < next) {
+            next = cascade;
+        }
+    }
+
+    return next << TIMER_WHEEL_SHIFT;
+}
+
+// Queue callback
+int timer_add(uint64_t delay_ns, timer_callback_t callback, void* arg) {
+    if (!callback) {
+        return -1;
+    }
+
+    uint32_t flags = irq_save();
+
+    struct wheel_timer* t = free_list;
+    if (!t) {
+        irq_restore(flags);
+        return -1;
+    }
+    free_list = t->next;
+
+    // Empty wheel is not run by the periodic tick: catch its clock up first,
+    // or the next run would step through every jiffy it sat idle
+    uint64_t now_ns = clock_ns();
+    if (pending == 0 && (now_ns >> TIMER_WHEEL_SHIFT) > wheel_clock) {
+        wheel_clock = now_ns >> TIMER_WHEEL_SHIFT;
+    }
+
+    // Round up so a timer never fires early
+    uint64_t expires_ns = now_ns + delay_ns;
+    t->expires = (expires_ns + (1ULL << TIMER_WHEEL_SHIFT) - 1) >> TIMER_WHEEL_SHIFT;
+    t->callback = callback;
+    t->arg = arg;
+    t->active = true;
+    t->generation = (t->generation + 1) & ID_GEN_MASK;
+
+    wheel_insert(t);
+    pending++;
+
+    // Tickless: make sure the one-shot fires in time
+    timer_clockevent_update(t->expires << TIMER_WHEEL_SHIFT);
+
+    int id = (int)((t->generation << ID_SLOT_BITS) | (uint32_t)(t - timer_pool));
+    irq_restore(flags);
+    return id;
+}
+
+// Cancel callback
+bool timer_cancel(int id) {
+    if (id < 0 || (id & ID_SLOT_MASK) >= TIMER_MAX_EVENTS) {
+        return false;
+    }
+
+    uint32_t flags = irq_save();
+    struct wheel_timer* t = &timer_pool[id & ID_SLOT_MASK];
+    bool was_pending = t->active && t->generation == ((uint32_t)id >> ID_SLOT_BITS);
+
+    if (was_pending) {
+        wheel_unlink(t);
+        t->active = false;
+        t->next = free_list;
+        free_list = t;
+        pending--;
+    }
+
+    irq_restore(flags);
+    return was_pending;
+}
+
+// Pending timer count
+uint32_t timer_pending(void) {
+    return pending;
+}
@@ -0,0 +1,196 @@
+/**************************************************************
+ * Work Queues - BloodG OS
+ * Interrupt handlers queue work, worker threads run it
+ **************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "io.h"
+#include "clock.h"
+#include "thread.h"
+#include "sync.h"
+#include "workqueue.h"
+
+// Registered queues
+static struct work_queue* queues[WORKQUEUE_MAX];
+static struct work_queue system_queue;
+static bool system_ready = false;
+
+void print_string(const char* str);
+
+// Worker: run items in FIFO order, sleep when empty
+static void work_queue_worker(void* arg) {
+    struct work_queue* wq = (struct work_queue*)arg;
+
+    while (1) {
+        uint32_t flags = irq_save();
+
+        while (!wq->head) {
+            wait_queue_sleep(&wq->idle);
+        }
+
+        struct work* work = wq->head;
+        wq->head = work->next;
+        if (!wq->head) {
+            wq->tail = NULL;
+        }
+        work->next = NULL;
+        wq->stats.depth--;
+
+        // Cleared before running so the item can requeue itself
+        work->pending = false;
+        work_func_t func = work->func;
+        void* func_arg = work->arg;
+
+        uint64_t start = clock_ns();
+        uint64_t wait = start - work->queued_ns;
+        wq->stats.total_wait_ns += wait;
+        if (wait < wq->stats.min_wait_ns) {
+            wq->stats.min_wait_ns = wait;
+        }
+        if (wait > wq->stats.max_wait_ns) {
+            wq->stats.max_wait_ns = wait;
+        }
+
+        irq_restore(flags);
+
+        func(func_arg);
+
+        uint64_t run = clock_ns() - start;
+
+        flags = irq_save();
+        wq->stats.completed++;
+        wq->stats.total_run_ns += run;
+        if (run > wq->stats.max_run_ns) {
+            wq->stats.max_run_ns = run;
+        }
+        irq_restore(flags);
+    }
+}
+
+// Create system queue
+void workqueue_init(void) {
+    // One CPU for now, so one system queue
+    if (work_queue_init(&system_queue, "events/0")) {
+        system_ready = true;
+    } else {
+        print_string("Workqueue: Cannot start events/0\n");
+    }
+}
+
+// Initialize work item
+void work_init(struct work* work, work_func_t func, void* arg) {
+    work->func = func;
+    work->arg = arg;
+    work->pending = false;
+    work->queued_ns = 0;
+    work->next = NULL;
+}
+
+// Initialize queue and start worker
+bool work_queue_init(struct work_queue* wq, const char* name) {
+    int i = 0;
+    for (; name[i] && i < WORKQUEUE_NAME_LEN - 1; i++) {
+        wq->name[i] = name[i];
+    }
+    wq->name[i] = '\0';
+
+    wq->head = NULL;
+    wq->tail = NULL;
+    wait_queue_init(&wq->idle);
+    work_queue_reset_stats(wq);
+
+    uint32_t flags = irq_save();
+
+    int slot = -1;
+    for (i = 0; i < WORKQUEUE_MAX; i++) {
+        if (!queues[i]) {
+            slot = i;
+            break;
+        }
+    }
+
+    wq->worker = slot >= 0 ? thread_create(wq->name, work_queue_worker, wq) : -1;
+    if (wq->worker >= 0) {
+        queues[slot] = wq;
+    }
+
+    irq_restore(flags);
+    return wq->worker >= 0;
+}
+
+// Queue work
+bool queue_work(struct work_queue* wq, struct work* work) {
+    uint32_t flags = irq_save();
+
+    // Already waiting: the pending run will see the new state too
+    if (work->pending) {
+        wq->stats.coalesced++;
+        irq_restore(flags);
+        return false;
+    }
+
+    work->pending = true;
+    work->queued_ns = clock_ns();
+    work->next = NULL;
+    if (wq->tail) {
+        wq->tail->next = work;
+    } else {
+        wq->head = work;
+    }
+    wq->tail = work;
+
+    wq->stats.queued++;
+    if (++wq->stats.depth > wq->stats.max_depth) {
+        wq->stats.max_depth = wq->stats.depth;
+    }
+
+    wait_queue_wake_one(&wq->idle);
+
+    irq_restore(flags);
+    return true;
+}
+
+// Queue on system queue
+bool schedule_work(struct work* work) {
+    if (!system_ready) {
+        return false;
+    }
+    return queue_work(&system_queue, work);
+}
+
+// Get queue by index
+struct work_queue* work_queue_get(int index) {
+    if (index < 0 || index >= WORKQUEUE_MAX) {
+        return NULL;
+    }
+    return queues[index];
+}
+
+// Get statistics
+struct work_queue_stats work_queue_get_stats(struct work_queue* wq) {
+    uint32_t flags = irq_save();
+    struct work_queue_stats copy = wq->stats;
+    irq_restore(flags);
+    return copy;
+}
+
+// Reset statistics (depth is live state, not a counter)
+void work_queue_reset_stats(struct work_queue* wq) {
+    uint32_t flags = irq_save();
+    uint32_t depth = wq->head ? wq->stats.depth : 0;
+
+    wq->stats.queued = 0;
+    wq->stats.coalesced = 0;
+    wq->stats.completed = 0;
+    wq->stats.depth = depth;
+    wq->stats.max_depth = depth;
+    wq->stats.total_wait_ns = 0;
+    wq->stats.min_wait_ns = ~0ULL;
+    wq->stats.max_wait_ns = 0;
+    wq->stats.total_run_ns = 0;
+    wq->stats.max_run_ns = 0;
+
+    irq_restore(flags);
+}
@@ -26,6 +26,21 @@ void serial_puts(const char* str) {
     }
 }
 
+// String port I/O
+void insw(uint16_t port, void* buffer, uint32_t count) {
+    asm volatile ("cld; rep insw"
+                  : "+D"(buffer), "+c"(count)
+                  : "d"(port)
+                  : "memory");
+}
+
+void outsw(uint16_t port, const void* buffer, uint32_t count) {
+    asm volatile ("cld; rep outsw"
+                  : "+S"(buffer), "+c"(count)
+                  : "d"(port)
+                  : "memory");
+}
+
 // Memory I/O
 uint32_t read_cr0(void) {
     uint32_t val;
@@ -57,3 +72,43 @@ void cli(void) {
 void sti(void) {
     asm volatile ("sti");
 }
+
+// Disable interrupts, returning previous EFLAGS
+uint32_t irq_save(void) {
+    uint32_t flags;
+    asm volatile ("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+// Re-enable interrupts only if they were enabled in flags
+void irq_restore(uint32_t flags) {
+    if (flags & 0x200) {
+        asm volatile ("sti" : : : "memory");
+    }
+}
+
+void halt(void) {
+    asm volatile ("hlt");
+}
+
+uint32_t read_eflags(void) {
+    uint32_t flags;
+    asm volatile ("pushfl; popl %0" : "=r"(flags));
+    return flags;
+}
+
+void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx) {
+    asm volatile ("cpuid"
+                  : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                  : "a"(leaf), "c"(0));
+}
+
+uint64_t read_msr(uint32_t msr) {
+    uint32_t low, high;
+    asm volatile ("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
+    return ((uint64_t)high << 32) | low;
+}
+
+void write_msr(uint32_t msr, uint64_t value) {
+    asm volatile ("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
@@ -7,10 +7,12 @@
 #include <stddef.h>
 #include <stdbool.h>
 #include <string.h>  // Menggunakan memcpy/memset dari string.c
+#include "taskpool.h"
 
 // Memory Manager Configuration
 #define MEMORY_POOL_SIZE (1 * 1024 * 1024)  // 1MB untuk kernel + filesystem
 #define ALIGNMENT 16  // Align memory to 16 bytes for performance
+#define CHECKSUM_PARALLEL_MIN (64 * 1024)  // Smaller blocks are not worth splitting
 
 // Memory block header (untuk implementasi malloc/free di masa depan)
 struct mem_block {
@@ -122,9 +124,8 @@ void memory_fill_pattern(void* ptr, size_t size, uint8_t pattern) {
     memset(ptr, pattern, size);
 }
 
-// Check memory integrity (simple checksum)
-uint8_t memory_checksum(void* ptr, size_t size) {
-    uint8_t* p = (uint8_t*)ptr;
+// XOR of a byte range
+static uint8_t checksum_bytes(const uint8_t* p, size_t size) {
     uint8_t checksum = 0;
     
     for (size_t i = 0; i < size; i++) {
@@ -134,6 +135,30 @@ uint8_t memory_checksum(void* ptr, size_t size) {
     return checksum;
 }
 
+// Shared state for a parallel checksum
+struct checksum_job {
+    const uint8_t* data;
+    volatile uint32_t result;
+};
+
+// parallel_for body: XOR is associative, so partial sums combine in any order
+static void checksum_range(uint32_t start, uint32_t end, void* arg) {
+    struct checksum_job* job = (struct checksum_job*)arg;
+    uint8_t partial = checksum_bytes(job->data + start, end - start);
+    __sync_fetch_and_xor(&job->result, partial);
+}
+
+// Check memory integrity (simple checksum)
+uint8_t memory_checksum(void* ptr, size_t size) {
+    if (size < CHECKSUM_PARALLEL_MIN) {
+        return checksum_bytes((uint8_t*)ptr, size);
+    }
+    
+    struct checksum_job job = { (const uint8_t*)ptr, 0 };
+    parallel_for(0, size, 0, checksum_range, &job);
+    return (uint8_t)job.result;
+}
+
 // Memory detection - lebih akurat
 struct memory_info {
     uint32_t total;
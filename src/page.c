@@ -0,0 +1,176 @@
+/**************************************************************
+ * Page Allocator - BloodG OS
+ * One bit per 4KB page, first-fit contiguous allocation
+ **************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "io.h"
+#include "page.h"
+#include "spinlock.h"
+
+// CMOS memory size registers
+#define CMOS_ADDRESS        0x70
+#define CMOS_DATA           0x71
+#define CMOS_EXT_MEM_LOW    0x30    // KB above 1MB (max 64MB)
+#define CMOS_EXT_MEM_HIGH   0x31
+#define CMOS_HIGH_MEM_LOW   0x34    // 64KB blocks above 16MB
+#define CMOS_HIGH_MEM_HIGH  0x35
+
+#define MAX_PAGES           (PAGE_MAX_MEMORY / PAGE_SIZE)
+
+// End of kernel image (linker.ld)
+extern uint8_t __kernel_end[];
+
+// Allocator state
+static uint32_t page_bitmap[MAX_PAGES / 32];
+static uint32_t total_pages = 0;
+static uint32_t free_pages = 0;
+static uint32_t search_hint = 0;    // First page that may be free
+static spinlock_t page_lock = SPINLOCK_INIT("page");
+
+void print_string(const char* str);
+char* utoa(uint32_t value, char* str, int base);
+
+static inline bool page_used(uint32_t page) {
+    return page_bitmap[page / 32] & (1U << (page % 32));
+}
+
+static inline void page_set(uint32_t page) {
+    page_bitmap[page / 32] |= 1U << (page % 32);
+}
+
+static inline void page_clear(uint32_t page) {
+    page_bitmap[page / 32] &= ~(1U << (page % 32));
+}
+
+// Read CMOS register
+static uint8_t cmos_read(uint8_t reg) {
+    outb(CMOS_ADDRESS, reg);
+    return inb(CMOS_DATA);
+}
+
+// Size memory from CMOS
+static uint32_t page_detect_memory(void) {
+    uint32_t high_blocks = cmos_read(CMOS_HIGH_MEM_LOW) | (cmos_read(CMOS_HIGH_MEM_HIGH) << 8);
+    if (high_blocks) {
+        return 16 * 1024 * 1024 + high_blocks * 64 * 1024;
+    }
+
+    uint32_t ext_kb = cmos_read(CMOS_EXT_MEM_LOW) | (cmos_read(CMOS_EXT_MEM_HIGH) << 8);
+    return 1024 * 1024 + ext_kb * 1024;
+}
+
+// Initialize page allocator
+void page_init(void) {
+    uint32_t memory_end = page_detect_memory();
+    if (memory_end > PAGE_MAX_MEMORY) {
+        memory_end = PAGE_MAX_MEMORY;
+    }
+
+    total_pages = memory_end / PAGE_SIZE;
+    free_pages = 0;
+
+    // Low memory, kernel image, BSS and boot stack are off limits
+    uint32_t first_free = ((uint32_t)__kernel_end + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    for (uint32_t page = 0; page < MAX_PAGES; page++) {
+        if (page >= first_free && page < total_pages) {
+            page_clear(page);
+            free_pages++;
+        } else {
+            page_set(page);
+        }
+    }
+    search_hint = first_free;
+
+    char num[16];
+    print_string("Pages: ");
+    print_string(utoa(free_pages * (PAGE_SIZE / 1024), num, 10));
+    print_string(" KB free of ");
+    print_string(utoa(memory_end / 1024, num, 10));
+    print_string(" KB\n");
+}
+
+// Allocate contiguous pages
+void* page_alloc(uint32_t count) {
+    if (count == 0) {
+        return NULL;
+    }
+
+    uint32_t flags = spin_lock_irqsave(&page_lock);
+    uint32_t run = 0;
+
+    for (uint32_t page = search_hint; page < total_pages; page++) {
+        if (page_used(page)) {
+            run = 0;
+            continue;
+        }
+
+        if (++run == count) {
+            uint32_t start = page + 1 - count;
+            for (uint32_t i = start; i <= page; i++) {
+                page_set(i);
+            }
+            free_pages -= count;
+            if (start == search_hint) {
+                search_hint = page + 1;
+            }
+            spin_unlock_irqrestore(&page_lock, flags);
+            return (void*)(start * PAGE_SIZE);
+        }
+    }
+
+    spin_unlock_irqrestore(&page_lock, flags);
+    return NULL;
+}
+
+// Free pages
+void page_free(void* addr, uint32_t count) {
+    uint32_t start = (uint32_t)addr / PAGE_SIZE;
+    if (!addr || start + count > total_pages) {
+        return;
+    }
+
+    uint32_t flags = spin_lock_irqsave(&page_lock);
+
+    for (uint32_t page = start; page < start + count; page++) {
+        if (page_used(page)) {
+            page_clear(page);
+            free_pages++;
+        }
+    }
+    if (start < search_hint) {
+        search_hint = start;
+    }
+
+    spin_unlock_irqrestore(&page_lock, flags);
+}
+
+// Mark range as used
+void page_reserve(uint32_t addr, uint32_t size) {
+    uint32_t start = addr / PAGE_SIZE;
+    uint32_t end = (addr + size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    uint32_t flags = spin_lock_irqsave(&page_lock);
+
+    for (uint32_t page = start; page < end && page < total_pages; page++) {
+        if (!page_used(page)) {
+            page_set(page);
+            free_pages--;
+        }
+    }
+
+    spin_unlock_irqrestore(&page_lock, flags);
+}
+
+// Get free page count
+uint32_t page_free_count(void) {
+    return free_pages;
+}
+
+// Get total page count
+uint32_t page_total_count(void) {
+    return total_pages;
+}
@@ -61,3 +61,39 @@ int memcmp(const void* ptr1, const void* ptr2, size_t n) {
     }
     return 0;
 }
+
+char* utoa(uint32_t value, char* str, int base) {
+    const char* digits = "0123456789abcdefghijklmnopqrstuvwxyz";
+    char temp[33];
+    int i = 0;
+    
+    if (base < 2 || base > 36) {
+        str[0] = '\0';
+        return str;
+    }
+    
+    do {
+        temp[i++] = digits[value % base];
+        value /= base;
+    } while (value);
+    
+    int j = 0;
+    while (i > 0) {
+        str[j++] = temp[--i];
+    }
+    str[j] = '\0';
+    return str;
+}
+
+char* itoa(int value, char* str, int base) {
+    if (value < 0 && base == 10) {
+        str[0] = '-';
+        utoa((uint32_t)(-(int64_t)value), str + 1, base);
+        return str;
+    }
+    return utoa((uint32_t)value, str, base);
+}
+
+char* itox(uint32_t value, char* str) {
+    return utoa(value, str, 16);
+}